@@ -1,4 +1,4 @@
-#include "ma.h"
+#include "ma_internal.h"
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
@@ -8,41 +8,6 @@
 
 #define INIT_MEM_SIZE 10
 
-typedef uint64_t bits_t;
-
-typedef struct {
-  moore_t* automaton; // Pointer to the connected automaton.
-  size_t  bit_idx;    // Index of the bit within the connected automaton (either input or output).
-} connection_t;
-
-typedef struct {
-  connection_t args;
-  size_t output_connection_idx;
-} input_connection_t;
-
-typedef struct {
-  size_t sz;
-  size_t capacity;
-  connection_t* connections;  // Dynamic array of connections.
-} output_connection_t;
-
-struct moore {
-  size_t state_bit_count;    // Number of bits representing a state.
-  size_t num_input_bits;     // Number of bit signals for `input`.
-  size_t num_output_bits;    // Number of bit signals for `output`.
-
-  bits_t* next_state;        // Used for performance: avoids repeated allocations of next state bits.
-  bits_t* state;             // Current state.
-  bits_t* output;
-  bits_t* input;
-
-  input_connection_t* input_connections;     // Array of size `num_input_bits`.
-  output_connection_t* output_connections;   // Array of size `num_output_bits`.
-
-  transition_function_t trans_func;
-  output_function_t out_func;
-};
-
 // Initializes a dynamic array `output_connection_t` with `0` capacity.
 static int lazy_init_output_connection(output_connection_t* conn) {
   conn->sz = 0;
@@ -53,9 +18,9 @@ static int lazy_init_output_connection(output_connection_t* conn) {
 }
 
 // Initializes a dynamic array `output_connection_t` with default (`INIT_MEM_SIZE`) capacity.
-static int init_output_connection(output_connection_t* conn) {
+static int init_output_connection(output_connection_t* conn, const ma_allocator_t* alloc) {
   conn->sz = 0;
-  conn->connections = malloc(INIT_MEM_SIZE * sizeof(*conn->connections));
+  conn->connections = mem_alloc(alloc, INIT_MEM_SIZE * sizeof(*conn->connections));
   
   if (!conn->connections)  {
     errno = ENOMEM;
@@ -67,16 +32,18 @@ static int init_output_connection(output_connection_t* conn) {
   return 0;
 }
 
-static int add_output_connection(output_connection_t* conns, connection_t conn) {
+static int add_output_connection(output_connection_t* conns, connection_t conn,
+                                 const ma_allocator_t* alloc) {
   if (conns->capacity == 0) {
     // The connection array was lazily initialized. Perform a proper intialization.
-    if (init_output_connection(conns) == -1) {
+    if (init_output_connection(conns, alloc) == -1) {
       return -1;
     }
   }
   if (conns->sz == conns->capacity) {
     size_t new_capacity = 2 * conns->capacity;
-    connection_t* tmp = realloc(conns->connections, new_capacity * sizeof(*tmp));
+    connection_t* tmp = mem_realloc(alloc, conns->connections, conns->capacity * sizeof(*tmp),
+                                    new_capacity * sizeof(*tmp));
 
     if (!tmp) {
       errno = ENOMEM;
@@ -92,55 +59,35 @@ static int add_output_connection(output_connection_t* conns, connection_t conn)
   return 0;
 }
 
-static void pop_back(output_connection_t* conns) {
-  if (conns->sz == 0) {
-    return;
+// Grows the capacity of `conns` to at least `capacity` connections.
+static int reserve_output_connection(output_connection_t* conns, size_t capacity,
+                                     const ma_allocator_t* alloc) {
+  if (capacity <= conns->capacity) {
+    return 0;
   }
-  --conns->sz;
-}
-
-// Converts the `s` bits to `ceil(s/word_len)` where 
-// the `word_len` is given by number of bits in `bits_t`.
-static size_t bits_to_words(size_t s) {
-  size_t bits_per_word = CHAR_BIT * sizeof(bits_t);
-  return (s + bits_per_word - 1) / bits_per_word;
-}
-
-static void id_output(bits_t* output, const bits_t* state, size_t, size_t s) {
-  memcpy(output, state, sizeof(bits_t) * bits_to_words(s)); 
-}
-
-// Retrieves the `n`-th bit from `bits`. Indexing is 0-based.
-static int get_bit(const bits_t* bits, size_t n) {
-  size_t idx = n / (CHAR_BIT * sizeof(bits_t));
-  size_t bit_idx = n % (CHAR_BIT * sizeof(bits_t));
 
-  return (bits[idx] >> bit_idx) & ((bits_t) 1);
-}
+  connection_t* tmp = mem_realloc(alloc, conns->connections, conns->capacity * sizeof(*tmp),
+                                  capacity * sizeof(*tmp));
+  if (!tmp) {
+    errno = ENOMEM;
+    return -1;
+  }
 
-// Sets the `n`-th bit of `bits`. Indexing is 0-based.
-static void set_bit(bits_t* bits, size_t n) {
-  size_t idx = n / (CHAR_BIT * sizeof(bits_t));
-  size_t bit_idx = n % (CHAR_BIT * sizeof(bits_t));
+  conns->connections = tmp;
+  conns->capacity = capacity;
 
-  bits[idx] |= ((bits_t) 1) << bit_idx;
+  return 0;
 }
 
-// Unsets the `n`-th bit of `bits`. Indexing is 0-based.
-static void unset_bit(bits_t* bits, size_t n) {
-  size_t idx = n / (CHAR_BIT * sizeof(bits_t));
-  size_t bit_idx = n % (CHAR_BIT * sizeof(bits_t));
-
-  bits[idx] &= ~(((bits_t) 1) << bit_idx);
+static void pop_back(output_connection_t* conns) {
+  if (conns->sz == 0) {
+    return;
+  }
+  --conns->sz;
 }
 
-// Sets n-th bit of `bits` to `bit`. Indexing is 0-based.
-static void copy_bit(bits_t* bits, int bit, size_t n) {
-  if (bit) {
-    set_bit(bits, n);
-  } else {
-    unset_bit(bits, n);
-  }
+void id_output(bits_t* output, const bits_t* state, size_t, size_t s) {
+  memcpy(output, state, sizeof(bits_t) * bits_to_words(s)); 
 }
 
 // Returns true if the range [`start`, `start + num`) is within total_bits, safely handling overflow.
@@ -149,21 +96,26 @@ static bool is_valid_range(size_t start, size_t total_bits, size_t num) {
 }
 
 // Removes the connection between `aut_idx` automaton in output connections `conn`
-// on both sides - input and output.
+// on both sides - input and output. Automata reading their inputs from a
+// frozen schedule have no input records to update.
 static void disconnect_output(output_connection_t* conn, size_t aut_idx) {
   if (!conn) {
     return;
   }
-  
+
   connection_t tmp = conn->connections[aut_idx];
   conn->connections[aut_idx] = conn->connections[conn->sz - 1];
   pop_back(conn);
 
   moore_t* swapped = conn->connections[aut_idx].automaton;
   size_t bit = conn->connections[aut_idx].bit_idx;
-  swapped->input_connections[bit].output_connection_idx = aut_idx;
+  if (swapped->input_connections) {
+    swapped->input_connections[bit].output_connection_idx = aut_idx;
+  }
 
-  tmp.automaton->input_connections[tmp.bit_idx].args.automaton = NULL;
+  if (tmp.automaton->input_connections) {
+    tmp.automaton->input_connections[tmp.bit_idx].args.automaton = NULL;
+  }
 }
 
 // Removes the connection on both sides given the input connection.
@@ -178,36 +130,85 @@ static void disconnect_input(input_connection_t* conn) {
   disconnect_output(&output_aut->output_connections[output_bit], conn->output_connection_idx);
 }
 
+void detach_inputs(moore_t* a) {
+  for (size_t j = 0; j < a->num_input_bits; ++j) {
+    if (a->input_connections) {
+      disconnect_input(&a->input_connections[j]);
+      continue;
+    }
+
+    // Without a record, the entry is found in the fan-out of the driver.
+    connection_t src = input_source(a, j);
+    if (!src.automaton) {
+      continue;
+    }
+    output_connection_t* conns = &src.automaton->output_connections[src.bit_idx];
+    for (size_t k = 0; k < conns->sz; ++k) {
+      if (conns->connections[k].automaton == a && conns->connections[k].bit_idx == j) {
+        disconnect_output(conns, k);
+        break;
+      }
+    }
+  }
+}
+
 moore_t* ma_create_full(size_t n, size_t m, size_t s, transition_function_t t,
                         output_function_t y, const uint64_t* q) {
+  return create_automaton(n, m, s, t, y, q, &default_allocator, false);
+}
+
+moore_t* ma_create_padded(size_t n, size_t m, size_t s, transition_function_t t,
+                          output_function_t y, const bits_t* q) {
+  return create_automaton(n, m, s, t, y, q, &default_allocator, true);
+}
+
+moore_t* create_automaton(size_t n, size_t m, size_t s, transition_function_t t,
+                          output_function_t y, const bits_t* q, const ma_allocator_t* alloc,
+                          bool padded) {
 
   if (m == 0 || s == 0 || !t || !y || !q) {
     errno = EINVAL;
     return NULL;
   }
 
-  moore_t* aut = malloc(sizeof(*aut));
+  moore_t* aut = mem_alloc(alloc, sizeof(*aut));
   
   if (!aut) {
     errno = ENOMEM;
     return NULL;
   }
   
+  aut->alloc = *alloc;
   aut->state_bit_count = s;
   aut->num_input_bits = n;
   aut->num_output_bits = m;
 
   aut->trans_func = t;
   aut->out_func = y;
+  aut->padded = padded;
+  aut->slab_group = NULL;
+  aut->cloned = false;
+  aut->frozen_group = NULL;
+  aut->frozen_pos = 0;
+  aut->topology_version = 0;
+  aut->clock_version = 0;
+  aut->cycle = 0;
+  aut->port = NULL;
+  aut->period = 1;
+  aut->phase = 0;
+  aut->table = NULL;
+  aut->memo = NULL;
+  aut->stim = NULL;
+  aut->settle = false;
+  aut->frozen = false;
+#ifdef MA_STATS
+  memset(&aut->stats, 0, sizeof(aut->stats));
+#endif
   
-  aut->state = calloc(bits_to_words(s), sizeof(*aut->state));
-  aut->next_state = calloc(bits_to_words(s), sizeof(*aut->next_state));
-
-  aut->input = n == 0 ? NULL : calloc(bits_to_words(n), sizeof(*aut->input));
-  aut->input_connections = n == 0 ? NULL : malloc(n * sizeof(*aut->input_connections));
-
-  aut->output = calloc(bits_to_words(m), sizeof(*aut->output));
-  aut->output_connections = malloc(m * sizeof(*aut->output_connections));
+  alloc_buffers(aut);
+  aut->input_connections =
+      n == 0 ? NULL : mem_alloc(alloc, n * sizeof(*aut->input_connections));
+  aut->output_connections = mem_alloc(alloc, m * sizeof(*aut->output_connections));
 
   if (aut->output_connections) {
     for (size_t i = 0; i < m; ++i) {
@@ -232,7 +233,9 @@ moore_t* ma_create_full(size_t n, size_t m, size_t s, transition_function_t t,
   }
   
   memcpy(aut->state, q, sizeof(bits_t) * bits_to_words(s));
-  aut->out_func(aut->output, q, aut->num_output_bits, aut->state_bit_count);
+  clear_state_pad(aut);
+  aut->out_func(aut->output, aut->state, aut->num_output_bits, aut->state_bit_count);
+  clear_state_pad(aut);
 
   return aut;
 }
@@ -258,32 +261,41 @@ moore_t* ma_create_simple(size_t n, size_t m, transition_function_t t) {
 
 void ma_delete(moore_t* a) {
   if (!a) return;
+
+  ma_port_close(a->port);
+  while (a->stim) {
+    ma_stim_close(a->stim);
+  }
+  free(a->table);
+  memo_free(a->memo);
   
-  free(a->state);
-  free(a->next_state);
-  free(a->output);
-  free(a->input);
-
-  if (a->input_connections) {
-    for (size_t bit = 0; bit < a->num_input_bits; ++bit) {
-      input_connection_t* in_conn = &a->input_connections[bit];
-      disconnect_input(in_conn);
-    }
+  const ma_allocator_t* alloc = &a->alloc;
+  if (!a->slab_group) {
+    free_buffers(a);
+  }
+
+  if (a->input_connections || a->frozen_group) {
+    detach_inputs(a);
   }
   
   if (a->output_connections) {
     for (size_t bit = 0; bit < a->num_output_bits; ++bit) {
-      size_t sz = a->output_connections[bit].sz;
-      for (size_t i = 0; i < sz; ++i) {
-        disconnect_output(&a->output_connections[bit], a->output_connections[bit].sz - 1);
+      output_connection_t* conns = &a->output_connections[bit];
+      while (conns->sz != 0) {
+        ++conns->connections[conns->sz - 1].automaton->topology_version;
+        disconnect_output(conns, conns->sz - 1);
       }
-      free(a->output_connections[bit].connections);
+      mem_free(alloc, a->output_connections[bit].connections,
+               a->output_connections[bit].capacity * sizeof(connection_t));
     }
   }
 
-  free(a->input_connections);
-  free(a->output_connections);
-  free(a);
+  mem_free(alloc, a->input_connections, a->num_input_bits * sizeof(*a->input_connections));
+  mem_free(alloc, a->output_connections, a->num_output_bits * sizeof(*a->output_connections));
+
+  // The allocator lives in the automaton.
+  ma_allocator_t copy = *alloc;
+  mem_free(&copy, a, sizeof(*a));
 }
 
 int ma_set_state(moore_t* a, const uint64_t* state) {
@@ -292,8 +304,14 @@ int ma_set_state(moore_t* a, const uint64_t* state) {
     return -1;
   }
   
+  if (a->slab_group) {
+    slab_written(a->slab_group);
+  }
   memcpy(a->state, state, sizeof(bits_t) * bits_to_words(a->state_bit_count));
+  clear_state_pad(a);
   a->out_func(a->output, a->state, a->num_output_bits, a->state_bit_count);
+  clear_state_pad(a);
+  a->frozen = false;
 
   return 0;
 }
@@ -304,13 +322,17 @@ int ma_set_input(moore_t* a, const uint64_t* input) {
     return -1;
   }
   
+  if (a->slab_group) {
+    slab_written(a->slab_group);
+  }
   for (size_t i = 0; i < a->num_input_bits; ++i) {
-    if (a->input_connections[i].args.automaton) {
+    if (input_source(a, i).automaton) {
       // The signal is connected.
       continue;
     }
     copy_bit(a->input, get_bit(input, i), i);
   }
+  unfold(a);
 
   return 0;
 }
@@ -324,50 +346,291 @@ const uint64_t* ma_get_output(const moore_t* a) {
   return a->output;
 }
 
-int ma_connect(moore_t* a_in, size_t in, moore_t* a_out, size_t out, size_t num) {
-  if (!a_in || !a_out || num == 0 ||
-      !is_valid_range(in, a_in->num_input_bits, num) || 
-      !is_valid_range(out, a_out->num_output_bits, num)) {
-    errno = EINVAL;
+static bool is_valid_spec(const ma_conn_spec_t* spec) {
+  return spec->a_in && spec->a_out && spec->num != 0 &&
+         is_valid_range(spec->in, spec->a_in->num_input_bits, spec->num) &&
+         is_valid_range(spec->out, spec->a_out->num_output_bits, spec->num);
+}
+
+bool is_valid_edit(const ma_conn_spec_t* spec) {
+  if (spec->a_out) {
+    return is_valid_spec(spec);
+  }
+  return spec->a_in && spec->num != 0 &&
+         is_valid_range(spec->in, spec->a_in->num_input_bits, spec->num);
+}
+
+// Grows `conns` so that `extra` more connections fit without a reallocation.
+// An empty array gets exactly that many, so that bulk loads allocate no
+// spare room. Otherwise the capacity at least doubles so that repeated calls
+// stay amortized.
+static int reserve_extra(output_connection_t* conns, size_t extra, const ma_allocator_t* alloc) {
+  size_t need = conns->sz + extra;
+  if (need <= conns->capacity) {
+    return 0;
+  }
+
+  size_t grown = conns->capacity == 0 ? need : 2 * conns->capacity;
+  return reserve_output_connection(conns, need > grown ? need : grown, alloc);
+}
+
+// A driving output bit and the allocator of its automaton.
+typedef struct {
+  output_connection_t* conns;
+  const ma_allocator_t* alloc;
+} driver_t;
+
+static int cmp_driver(const void* a, const void* b) {
+  uintptr_t x = (uintptr_t) ((const driver_t*) a)->conns;
+  uintptr_t y = (uintptr_t) ((const driver_t*) b)->conns;
+  return (x > y) - (x < y);
+}
+
+// Reserves room for every connection of `specs` in the fan-out arrays of the
+// driving output bits, with one allocation per driver bit. Specs without
+// `a_out` disconnect and need no room.
+static int reserve_specs(const ma_conn_spec_t* specs, size_t k) {
+  if (k == 1) {
+    // The driver bits of a single range are distinct.
+    for (size_t i = 0; specs->a_out && i < specs->num; ++i) {
+      if (reserve_extra(&specs->a_out->output_connections[specs->out + i], 1,
+                        &specs->a_out->alloc) == -1) {
+        return -1;
+      }
+    }
+    return 0;
+  }
+
+  size_t total = 0;
+  for (size_t r = 0; r < k; ++r) {
+    if (!specs[r].a_out) {
+      continue;
+    }
+    if (specs[r].num > SIZE_MAX / sizeof(driver_t) - total) {
+      errno = ENOMEM;
+      return -1;
+    }
+    total += specs[r].num;
+  }
+  if (total == 0) {
+    return 0;
+  }
+
+  driver_t* drivers = malloc(total * sizeof(*drivers));
+  if (!drivers) {
+    errno = ENOMEM;
     return -1;
   }
 
-  for (size_t i = 0; i < num; ++i) {
-    input_connection_t* in_conn = &a_in->input_connections[in + i];
+  size_t pos = 0;
+  for (size_t r = 0; r < k; ++r) {
+    for (size_t i = 0; specs[r].a_out && i < specs[r].num; ++i) {
+      drivers[pos++] = (driver_t) {
+          .conns = &specs[r].a_out->output_connections[specs[r].out + i],
+          .alloc = &specs[r].a_out->alloc};
+    }
+  }
+  qsort(drivers, total, sizeof(*drivers), cmp_driver);
+
+  int ret = 0;
+  for (size_t i = 0; i < total && ret == 0;) {
+    size_t j = i + 1;
+    while (j < total && drivers[j].conns == drivers[i].conns) {
+      ++j;
+    }
+    ret = reserve_extra(drivers[i].conns, j - i, drivers[i].alloc);
+    i = j;
+  }
+
+  free(drivers);
+  return ret;
+}
+
+// Connects the inputs of `spec`, whose fan-out arrays have room for them.
+static void connect_range(const ma_conn_spec_t* spec) {
+  unfold(spec->a_in);
+  spec->a_in->settle = false;
+  ++spec->a_in->topology_version;
+  for (size_t i = 0; i < spec->num; ++i) {
+    input_connection_t* in_conn = &spec->a_in->input_connections[spec->in + i];
+    output_connection_t* out_conns = &spec->a_out->output_connections[spec->out + i];
     disconnect_input(in_conn);
 
-    // Try to add the connection.
-    if (add_output_connection(&a_out->output_connections[out + i],
-                              (connection_t) {.automaton = a_in, .bit_idx = in + i}) == -1) {
-      errno = ENOMEM;
+    // The capacity was reserved, so this cannot fail.
+    add_output_connection(out_conns,
+                          (connection_t) {.automaton = spec->a_in, .bit_idx = spec->in + i},
+                          &spec->a_out->alloc);
+
+    in_conn->args.bit_idx = spec->out + i;
+    in_conn->args.automaton = spec->a_out;
+    in_conn->output_connection_idx = out_conns->sz - 1;
+  }
+}
+
+// Disconnects inputs [`in`, `in + num`) of `a_in`.
+static void disconnect_range(moore_t* a_in, size_t in, size_t num) {
+  ++a_in->topology_version;
+  for (size_t i = 0; i < num; ++i) {
+    moore_t* a_out = a_in->input_connections[in + i].args.automaton;
+    size_t bit_idx = a_in->input_connections[in + i].args.bit_idx;
+    size_t a_in_idx = a_in->input_connections[in + i].output_connection_idx;
+
+    if (a_out) {
+      disconnect_output(&a_out->output_connections[bit_idx], a_in_idx);
+    }
+  }
+}
+
+int apply_edits(const ma_conn_spec_t* specs, size_t k) {
+  // Only the capacities and the form of the input records may change before
+  // this point, so a failure leaves every connection as it was.
+  for (size_t r = 0; r < k; ++r) {
+    if (specs[r].a_in->frozen_group && thaw_schedule(specs[r].a_in->frozen_group) == -1) {
       return -1;
     }
+  }
+  if (reserve_specs(specs, k) == -1) {
+    return -1;
+  }
 
-    in_conn->args.bit_idx = out + i;
-    in_conn->args.automaton = a_out;
-    in_conn->output_connection_idx = a_out->output_connections[out + i].sz - 1;
+  for (size_t r = 0; r < k; ++r) {
+    if (specs[r].a_out) {
+      connect_range(&specs[r]);
+    } else {
+      disconnect_range(specs[r].a_in, specs[r].in, specs[r].num);
+    }
   }
 
   return 0;
 }
 
+int ma_connect_many(const ma_conn_spec_t* specs, size_t k) {
+  if (k != 0 && !specs) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (size_t r = 0; r < k; ++r) {
+    if (!is_valid_spec(&specs[r])) {
+      errno = EINVAL;
+      return -1;
+    }
+  }
+
+  // The topology of a clone is shared with the group it was cloned from.
+  for (size_t r = 0; r < k; ++r) {
+    if (specs[r].a_in->cloned || specs[r].a_out->cloned) {
+      errno = EPERM;
+      return -1;
+    }
+  }
+
+  return apply_edits(specs, k);
+}
+
+int ma_connect(moore_t* a_in, size_t in, moore_t* a_out, size_t out, size_t num) {
+  ma_conn_spec_t spec = {.a_in = a_in, .in = in, .a_out = a_out, .out = out, .num = num};
+  return ma_connect_many(&spec, 1);
+}
+
 int ma_disconnect(moore_t* a_in, size_t in, size_t num) {
   if (!a_in || num == 0 || !is_valid_range(in, a_in->num_input_bits, num)) {
     errno = EINVAL;
     return -1;
   }
 
+  if (a_in->cloned) {
+    errno = EPERM;
+    return -1;
+  }
+
+  if (a_in->frozen_group && thaw_schedule(a_in->frozen_group) == -1) {
+    return -1;
+  }
+
+  disconnect_range(a_in, in, num);
+  return 0;
+}
+
+void gather_inputs(moore_t* const at[], size_t num) {
   for (size_t i = 0; i < num; ++i) {
-    moore_t* a_out = a_in->input_connections[in + i].args.automaton;
-    size_t bit_idx = a_in->input_connections[in + i].args.bit_idx;
-    size_t a_in_idx = a_in->input_connections[in + i].output_connection_idx;
+    for (size_t j = 0; j < at[i]->num_input_bits; ++j) {
+      connection_t src = input_source(at[i], j);
+      if (!src.automaton) {
+        continue;
+      }
+      copy_bit(at[i]->input, get_bit(src.automaton->output, src.bit_idx), j);
+#ifdef MA_STATS
+      ++at[i]->stats.gathered_bits;
+#endif
+    }
+  }
+}
 
-    if (a_out) {
-      disconnect_output(&a_out->output_connections[bit_idx], a_in_idx);
+void transition_automata(moore_t* const at[], size_t num) {
+  for (size_t i = 0; i < num; ++i) {
+    if (at[i]->frozen) {
+      ++at[i]->cycle;
+      continue;
+    }
+#ifdef MA_STATS
+    uint64_t start = stats_ticks();
+#endif
+    const bits_t* cached = NULL;
+    if (at[i]->table) {
+      table_transition(at[i]);
+    } else if (at[i]->memo && (cached = memo_lookup(at[i]))) {
+      // The next state is cached along with its output.
+    } else {
+      at[i]->trans_func(at[i]->next_state, at[i]->input, at[i]->state,
+                        at[i]->num_input_bits, at[i]->state_bit_count);
+#ifdef MA_STATS
+      ++at[i]->stats.trans_calls;
+#endif
+    }
+#ifdef MA_STATS
+    uint64_t mid = stats_ticks();
+#endif
+
+    size_t state_bytes = sizeof(bits_t) * bits_to_words(at[i]->state_bit_count);
+    if (at[i]->padded) {
+      clear_pad(at[i]->next_state, at[i]->state_bit_count,
+                buffer_words(at[i], at[i]->state_bit_count));
     }
+    if (at[i]->settle && memcmp(at[i]->state, at[i]->next_state, state_bytes) == 0) {
+      // With constant inputs the state can no longer change.
+      at[i]->frozen = true;
+    }
+    memcpy(at[i]->state, at[i]->next_state, state_bytes);
+    if (cached) {
+      memcpy(at[i]->output, cached, sizeof(bits_t) * bits_to_words(at[i]->num_output_bits));
+    } else {
+      at[i]->out_func(at[i]->output, at[i]->state, at[i]->num_output_bits,
+                      at[i]->state_bit_count);
+#ifdef MA_STATS
+      ++at[i]->stats.out_calls;
+#endif
+      if (at[i]->padded) {
+        clear_pad(at[i]->output, at[i]->num_output_bits,
+                  buffer_words(at[i], at[i]->num_output_bits));
+      }
+      if (at[i]->memo && !at[i]->table) {
+        memo_store(at[i]);
+      }
+    }
+    ++at[i]->cycle;
+#ifdef MA_STATS
+    uint64_t end = stats_ticks();
+    at[i]->stats.trans_cycles += mid - start;
+    at[i]->stats.out_cycles += end - mid;
+#endif
   }
+}
 
-  return 0;  
+void step_automata(moore_t* const at[], size_t num) {
+  drain_ports(at, num);
+  gather_inputs(at, num);
+  transition_automata(at, num);
 }
 
 int ma_step(moore_t* at[], size_t num) {
@@ -381,25 +644,21 @@ int ma_step(moore_t* at[], size_t num) {
     return -1;
   }
 
-  // Update the inputs.
   for (size_t i = 0; i < num; ++i) {
-    for (size_t j = 0; j < at[i]->num_input_bits; ++j) {
-      if (!at[i]->input_connections[j].args.automaton) {
-        continue;
-      }
-      int bit = get_bit(at[i]->input_connections[j].args.automaton->output,
-                        at[i]->input_connections[j].args.bit_idx);
-      copy_bit(at[i]->input, bit, j);
+    if (at[i]->slab_group) {
+      slab_written(at[i]->slab_group);
     }
   }
+  step_automata(at, num);
 
-  for (size_t i = 0; i < num; ++i) {
-    at[i]->trans_func(at[i]->next_state, at[i]->input, at[i]->state,
-                      at[i]->num_input_bits, at[i]->state_bit_count);
+  return 0;
+}
 
-    memcpy(at[i]->state, at[i]->next_state, sizeof(bits_t) * bits_to_words(at[i]->state_bit_count));
-    at[i]->out_func(at[i]->output, at[i]->state, at[i]->num_output_bits, at[i]->state_bit_count);
+uint64_t ma_cycle(const moore_t* a) {
+  if (!a) {
+    errno = EINVAL;
+    return 0;
   }
 
-  return 0;
-}
\ No newline at end of file
+  return a->cycle;
+}
@@ -3,6 +3,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 typedef uint64_t bits_t;
 
@@ -13,10 +14,33 @@ typedef void (*transition_function_t)(bits_t *next_state, const bits_t* input,
 typedef void (*output_function_t)(bits_t *output, const bits_t* state,
                                   size_t m, size_t s);
 
+// Allocator of the structures, buffers and connection arrays of automata.
+// `realloc` and `free` receive the current size of the block, which is never NULL.
+typedef struct {
+  void* (*alloc)(size_t size, void* ctx);
+  void* (*realloc)(void* ptr, size_t old_size, size_t size, void* ctx);
+  void (*free)(void* ptr, size_t size, void* ctx);
+  void* ctx;
+} ma_allocator_t;
+
+int ma_set_allocator(const ma_allocator_t* alloc);
+
 moore_t* ma_create_full(size_t n, size_t m, size_t s, transition_function_t t,
                         output_function_t y, const bits_t* q);
 moore_t* ma_create_simple(size_t n, size_t m, transition_function_t t);
 void ma_delete(moore_t* a);
+
+// Automata created by `ma_create_padded`, or by `ma_group_add` after
+// `ma_group_set_padded`, have state, input and output buffers aligned to
+// `MA_BUFFER_ALIGN` bytes and a whole number of `MA_BUFFER_PAD` bytes long,
+// so that transition and output functions may load and store whole vectors.
+// The bits past the last valid one are zero whenever a function is called.
+#define MA_BUFFER_ALIGN 64
+#define MA_BUFFER_PAD 64
+
+moore_t* ma_create_padded(size_t n, size_t m, size_t s, transition_function_t t,
+                          output_function_t y, const bits_t* q);
+
 int ma_connect(moore_t* a_in, size_t in, moore_t* a_out, size_t out, size_t num);
 int ma_disconnect(moore_t* a_in, size_t in, size_t num);
 int ma_set_input(moore_t* a, const bits_t* input);
@@ -24,4 +48,379 @@ int ma_set_state(moore_t* a, const bits_t* state);
 const bits_t* ma_get_output(const moore_t* a);
 int ma_step(moore_t* at[], size_t num);
 
+// Bulk connections applied all at once or not at all.
+
+// Connects inputs [`in`, `in + num`) of `a_in` to outputs [`out`, `out + num`) of `a_out`.
+typedef struct {
+  moore_t* a_in;
+  size_t in;
+  moore_t* a_out;
+  size_t out;
+  size_t num;
+} ma_conn_spec_t;
+
+int ma_connect_many(const ma_conn_spec_t* specs, size_t k);
+
+// Number of steps taken by `a`.
+uint64_t ma_cycle(const moore_t* a);
+
+// Input ports: lock-free queues through which other threads supply inputs.
+
+typedef struct ma_port ma_port_t;
+
+typedef enum {
+  MA_PORT_LATEST,            // A step applies the newest due vector, dropping older ones.
+  MA_PORT_QUEUED,            // A step applies the oldest due vector.
+} ma_port_mode_t;
+
+ma_port_t* ma_port_open(moore_t* a, ma_port_mode_t mode, size_t capacity);
+int ma_port_push(ma_port_t* p, const bits_t* input, uint64_t cycle);
+void ma_port_close(ma_port_t* p);
+
+// Stimulus generators: drive ranges of unconnected inputs at every step.
+
+typedef struct ma_stim ma_stim_t;
+
+typedef enum {
+  MA_STIM_RANDOM,            // Uniform random bits from xoshiro256**.
+  MA_STIM_LFSR,              // A Galois LFSR shifted once per step, at most 64 bits.
+  MA_STIM_COUNTER,           // A counter incremented once per step, at most 64 bits.
+  MA_STIM_REPLAY,            // Recorded vectors, replayed in a loop.
+} ma_stim_kind_t;
+
+typedef struct {
+  ma_stim_kind_t kind;
+  size_t in;                 // First input bit driven.
+  size_t num;                // Number of input bits driven.
+  uint64_t seed;             // Seed, initial LFSR register or initial counter value.
+  uint64_t stream;           // Independent random stream, e.g. one per thread.
+  uint64_t param;            // LFSR taps (`0` for the default) or counter increment.
+  const bits_t* vectors;     // `len` vectors of `ceil(num / 64)` words to replay.
+  size_t len;
+} ma_stim_spec_t;
+
+ma_stim_t* ma_stim_open(moore_t* a, const ma_stim_spec_t* spec);
+void ma_stim_close(ma_stim_t* s);
+
+// Groups of automata stepped together.
+
+typedef struct ma_group ma_group_t;
+
+ma_group_t* ma_group_create(moore_t* at[], size_t num);
+void ma_group_delete(ma_group_t* g);
+int ma_group_step(ma_group_t* g, size_t k);
+uint64_t ma_group_cycle(const ma_group_t* g);
+
+// Asynchronous steps on a worker thread owned by the group. Inputs for later
+// cycles are supplied through ports and outputs are read through a view.
+typedef struct ma_completion ma_completion_t;
+
+ma_completion_t* ma_step_async(ma_group_t* g, size_t k);
+int ma_completion_poll(const ma_completion_t* c);
+int ma_completion_wait(ma_completion_t* c);
+int ma_completion_fd(const ma_completion_t* c);
+void ma_completion_delete(ma_completion_t* c);
+
+// Clock domains: in a group, `a` steps only on ticks `t` of the group with
+// `t % period == phase`. `ma_step` ignores clocks.
+int ma_set_clock(moore_t* a, uint32_t period, uint32_t phase);
+
+// Handles of automata owned by a group.
+
+typedef uint64_t ma_id_t;
+
+#define MA_ID_INVALID ((ma_id_t) 0)
+
+ma_group_t* ma_group_new(void);
+int ma_group_set_allocator(ma_group_t* g, const ma_allocator_t* alloc);
+int ma_group_set_padded(ma_group_t* g, int padded);
+ma_id_t ma_group_add(ma_group_t* g, size_t n, size_t m, size_t s, transition_function_t t,
+                     output_function_t y, const bits_t* q);
+int ma_group_remove(ma_group_t* g, ma_id_t id);
+moore_t* ma_group_get(const ma_group_t* g, ma_id_t id);
+int ma_group_compact(ma_group_t* g);
+
+int ma_id_connect(ma_group_t* g, ma_id_t in_id, size_t in, ma_id_t out_id, size_t out, size_t num);
+int ma_id_disconnect(ma_group_t* g, ma_id_t in_id, size_t in, size_t num);
+int ma_id_set_input(ma_group_t* g, ma_id_t id, const bits_t* input);
+int ma_id_set_state(ma_group_t* g, ma_id_t id, const bits_t* state);
+const bits_t* ma_id_get_output(const ma_group_t* g, ma_id_t id);
+
+// Copy-on-write clones: the clone shares the topology of `g` and copies the
+// buffers page by page as they are written. Handles of `g` stay valid in it.
+// The member structures are copied, so a clone costs time and memory linear
+// in the number of members even if no buffer is ever written.
+ma_group_t* ma_group_clone(ma_group_t* g);
+
+// Module templates: a sub-network defined once and instantiated many times.
+// Automata of a module are referred to by the indices returned by `ma_module_add`.
+
+typedef struct ma_module ma_module_t;
+typedef struct ma_instances ma_instances_t;
+
+ma_module_t* ma_module_new(void);
+void ma_module_delete(ma_module_t* mod);
+size_t ma_module_add(ma_module_t* mod, size_t n, size_t m, size_t s, transition_function_t t,
+                     output_function_t y, const bits_t* q);
+int ma_module_connect(ma_module_t* mod, size_t a_in, size_t in, size_t a_out, size_t out,
+                      size_t num);
+int ma_module_input(ma_module_t* mod, size_t port, size_t a, size_t in, size_t num);
+int ma_module_output(ma_module_t* mod, size_t port, size_t a, size_t out, size_t num);
+
+ma_instances_t* ma_module_instantiate(const ma_module_t* mod, size_t count);
+void ma_instances_delete(ma_instances_t* x);
+size_t ma_instances_count(const ma_instances_t* x);
+int ma_instances_step(ma_instances_t* x, size_t k);
+int ma_instances_set_input(ma_instances_t* x, size_t i, const bits_t* input);
+int ma_instances_get_output(const ma_instances_t* x, size_t i, bits_t* output);
+
+// Streaming stimulus and response.
+
+typedef struct {
+  const char* path;          // Backing file.
+  moore_t* const* automata;  // Designated automata, in the order of the layout.
+  size_t num;                // Number of designated automata.
+} ma_stream_map_t;
+
+int ma_run_stream(ma_group_t* g, const ma_stream_map_t* in_map,
+                  const ma_stream_map_t* out_map, size_t cycles);
+
+#define MA_STATS_BUCKETS 32
+
+// Paced stepping at a fixed rate.
+
+typedef enum {
+  MA_PACE_SLEEP,             // Sleep until each release time.
+  MA_PACE_BUSY,              // Poll the clock until each release time.
+  MA_PACE_HYBRID,            // Sleep until `spin_ns` before the release time, then poll.
+} ma_pace_mode_t;
+
+// Called at the start of every tick, before the step. A nonzero return value
+// ends the run.
+typedef int (*ma_pace_hook_t)(ma_group_t* g, uint64_t tick, void* ctx);
+
+typedef struct {
+  uint64_t period_ns;
+  uint64_t ticks;            // Number of ticks, `0` runs until the hook ends the run.
+  ma_pace_mode_t mode;
+  uint64_t spin_ns;
+  int cpu;                   // CPU the calling thread is pinned to during the run, or `-1`.
+  ma_pace_hook_t hook;       // Optional.
+  void* ctx;                 // Passed to `hook`.
+} ma_pace_opts_t;
+
+typedef struct {
+  uint64_t ticks;
+  uint64_t overruns;                         // Ticks that completed after the next release time.
+  uint64_t max_jitter_ns;                    // Latest start of a tick after its release time.
+  uint64_t max_latency_ns;
+  uint64_t latency_hist[MA_STATS_BUCKETS];   // Bucket `i` counts ticks completed within
+                                             // [2^i, 2^(i+1)) ns of their release time.
+} ma_pace_stats_t;
+
+int ma_run_paced(ma_group_t* g, const ma_pace_opts_t* opts, ma_pace_stats_t* stats);
+
+// Memoisation of expensive transition functions.
+
+typedef struct {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;        // Cached transitions replaced by newer ones.
+} ma_memo_stats_t;
+
+int ma_memo_enable(moore_t* a, size_t sets, size_t ways);
+int ma_memo_disable(moore_t* a);
+int ma_memo_stats(const moore_t* a, ma_memo_stats_t* stats);
+
+// Performance counters, available when the library is built with `MA_STATS`.
+
+typedef struct {
+  uint64_t trans_calls;      // Steps not answered by a transition cache or table.
+  uint64_t out_calls;        // Steps not answered by a transition cache.
+  uint64_t trans_cycles;     // Time spent computing next states (TSC ticks).
+  uint64_t out_cycles;       // Time spent computing outputs (TSC ticks).
+  uint64_t gathered_bits;    // Input bits copied from connected outputs.
+} ma_automaton_stats_t;
+
+typedef struct {
+  uint64_t steps;
+  uint64_t step_ns_total;
+  uint64_t step_ns_hist[MA_STATS_BUCKETS];   // Bucket `i` counts steps of [2^i, 2^(i+1)) ns.
+  size_t connections;                        // Connected input bits of the members.
+  size_t max_fan_out;
+  size_t fan_out_hist[MA_STATS_BUCKETS];     // Output bits by fan-out: bucket `0` counts
+                                             // unconnected ones, bucket `i` [2^(i-1), 2^i).
+} ma_stats_t;
+
+int ma_stats_get(const ma_group_t* g, ma_stats_t* stats);
+int ma_stats_automaton(const moore_t* a, ma_automaton_stats_t* stats);
+int ma_stats_reset(ma_group_t* g);
+int ma_stats_dump_json(const ma_group_t* g, FILE* out);
+
+// Memory accounting.
+
+typedef struct {
+  size_t buffers;              // Automaton structures and their state, input and output words.
+  size_t input_connections;
+  size_t output_connections;   // Including the unused capacity of fan-out arrays.
+  size_t schedule;             // Frozen gather schedule of a group.
+  size_t group;                // Other bookkeeping of a group.
+  size_t total;
+} ma_memory_usage_t;
+
+int ma_memory_usage(const moore_t* a, ma_memory_usage_t* usage);
+int ma_group_memory_usage(const ma_group_t* g, ma_memory_usage_t* usage);
+int ma_group_freeze(ma_group_t* g);
+
+// Topology edits queued from any thread and applied by the group at the start
+// of its next step, all at once or not at all. An edit without `a_out`
+// disconnects inputs [`in`, `in + num`) of `a_in`.
+int ma_group_queue_edits(ma_group_t* g, const ma_conn_spec_t* edits, size_t k);
+int ma_group_apply_edits(ma_group_t* g);
+
+// Network optimisation.
+
+typedef struct {
+  size_t num_removed;          // Members that cannot influence an observed automaton.
+  size_t num_folded;           // Members stepped from a table with their free inputs folded in.
+  size_t num_settling;         // Members without connected inputs, skipped once they settle.
+} ma_optimize_result_t;
+
+int ma_group_optimize(ma_group_t* g, moore_t* const observed[], size_t num_observed,
+                      ma_optimize_result_t* result);
+
+// Bit-sliced kernels synthesised from the transition and output functions of
+// an automaton. Bit `j` of a vector is plane `j`, words [j * words, (j + 1) * words),
+// and lane `l` of the kernel is bit `l % 64` of word `l / 64` of every plane.
+
+typedef struct ma_kernel ma_kernel_t;
+
+ma_kernel_t* ma_kernel_synthesize(size_t n, size_t m, size_t s, transition_function_t t,
+                                  output_function_t y);
+void ma_kernel_delete(ma_kernel_t* k);
+size_t ma_kernel_terms(const ma_kernel_t* k);
+int ma_kernel_step(const ma_kernel_t* k, bits_t* state, const bits_t* input, bits_t* output,
+                   size_t words);
+int ma_kernel_emit_c(const ma_kernel_t* k, FILE* out, const char* name);
+
+// Binary netlists.
+
+typedef struct {
+  uint32_t id;               // Identifier stored in the netlist.
+  transition_function_t t;
+  output_function_t y;       // `NULL` selects the identity output of `ma_create_simple`.
+} ma_func_entry_t;
+
+typedef struct {
+  const ma_func_entry_t* entries;
+  size_t num;
+} ma_func_registry_t;
+
+ma_group_t* ma_load_netlist(const char* path, const ma_func_registry_t* reg);
+int ma_save_netlist(const ma_group_t* g, const char* path, const ma_func_registry_t* reg);
+
+// Multi-process sharding: member `i` of `g` is stepped by process `shard_of[i]`.
+
+int ma_run_sharded(ma_group_t* g, const size_t shard_of[], size_t num_shards, size_t cycles);
+
+// Snapshots and rewinding.
+
+typedef struct ma_rewind ma_rewind_t;
+
+size_t ma_snapshot_size(const ma_group_t* g);
+int ma_snapshot(const ma_group_t* g, bits_t* buf);
+int ma_restore(ma_group_t* g, const bits_t* buf);
+
+ma_rewind_t* ma_rewind_start(ma_group_t* g, size_t keyframe_interval);
+int ma_rewind_to(ma_rewind_t* r, uint64_t cycle);
+void ma_rewind_stop(ma_rewind_t* r);
+
+// Tracing.
+
+typedef enum {
+  MA_TRACE_OUTPUT,
+  MA_TRACE_STATE,
+} ma_trace_kind_t;
+
+typedef struct {
+  moore_t* automaton;
+  ma_trace_kind_t kind;      // Which words of the automaton are recorded.
+} ma_trace_probe_t;
+
+typedef struct ma_trace ma_trace_t;
+
+ma_trace_t* ma_trace_start(ma_group_t* g, const char* path,
+                           const ma_trace_probe_t* probes, size_t num);
+int ma_trace_stop(ma_trace_t* t);
+int ma_trace_to_vcd(const char* trace_path, const char* vcd_path);
+
+// Consistent output views for reader threads.
+
+typedef struct ma_view ma_view_t;
+
+ma_view_t* ma_view_create(ma_group_t* g, moore_t* const at[], size_t num);
+size_t ma_view_size(const ma_view_t* v);
+int ma_view_read(const ma_view_t* v, bits_t* outputs, uint64_t* cycle);
+void ma_view_delete(ma_view_t* v);
+
+// Reachability analysis.
+
+// Returns nonzero if the global state whose outputs are given is a target
+// (e.g. violates a property). `outputs[i]` is the output of the i-th automaton.
+typedef int (*ma_predicate_t)(const bits_t* const outputs[], size_t num, void* ctx);
+
+typedef struct {
+  size_t num_threads;       // Number of worker threads, `0` means one.
+  size_t max_states;        // Capacity of the visited set, `0` selects a default.
+  size_t memory_budget;     // Bytes of frontier kept in memory before spilling
+                            // to disk, `0` means no limit. The visited set is
+                            // not included; it holds `max_states` states.
+  ma_predicate_t predicate; // Optional target predicate.
+  void* ctx;                // Passed to `predicate`.
+} ma_reach_opts_t;
+
+typedef struct {
+  size_t num_states;        // Number of reachable global states.
+  size_t depth;             // Number of explored BFS levels.
+  int found;                // Nonzero if a state satisfying the predicate was reached.
+  size_t state_words;       // Length in words of a packed global state.
+  size_t trace_len;         // Number of states in the counterexample trace.
+  bits_t* trace_states;     // `trace_len` packed global states, starting at the initial one.
+  bits_t* trace_inputs;     // `trace_len - 1` free input vectors leading between them.
+} ma_reach_result_t;
+
+int ma_reach(moore_t* at[], size_t num, const ma_reach_opts_t* opts,
+             ma_reach_result_t* result);
+void ma_reach_result_free(ma_reach_result_t* result);
+
+// Random-simulation equivalence checking of two groups.
+
+typedef struct {
+  moore_t* a;               // Member of the first group.
+  moore_t* b;               // Corresponding member of the second group.
+} ma_equiv_pair_t;
+
+typedef struct {
+  const ma_equiv_pair_t* inputs;   // Members whose free inputs receive the same random bits.
+  size_t num_inputs;
+  const ma_equiv_pair_t* outputs;  // Members whose outputs must agree after every step.
+  size_t num_outputs;
+  size_t runs;              // Number of runs, with seeds `seed`, `seed + 1`, ...; `0` means one.
+  size_t num_threads;       // Number of threads, `0` means one.
+} ma_equiv_map_t;
+
+typedef struct {
+  int equivalent;           // Nonzero if no run diverged.
+  uint64_t seed;            // Seed of the diverging run with the lowest index.
+  uint64_t cycle;           // Number of steps after which its outputs differed.
+  size_t output;            // Index in `outputs` of the first differing pair.
+  size_t input_words;       // Length in words of the stimulus of a cycle.
+  size_t trace_len;         // Number of stimuli in the trace, equal to `cycle`.
+  bits_t* trace_inputs;     // The stimuli applied before each step, `input_words` apart.
+} ma_equiv_result_t;
+
+int ma_equiv_check(ma_group_t* a, ma_group_t* b, const ma_equiv_map_t* map, uint64_t cycles,
+                   uint64_t seed, ma_equiv_result_t* result);
+void ma_equiv_result_free(ma_equiv_result_t* result);
+
 #endif
@@ -0,0 +1,110 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <stdlib.h>
+
+static void* std_alloc(size_t size, void*) {
+  return malloc(size);
+}
+
+static void* std_realloc(void* ptr, size_t, size_t size, void*) {
+  return realloc(ptr, size);
+}
+
+static void std_free(void* ptr, size_t, void*) {
+  free(ptr);
+}
+
+static const ma_allocator_t std_allocator = {
+    .alloc = std_alloc, .realloc = std_realloc, .free = std_free, .ctx = NULL};
+
+ma_allocator_t default_allocator = {
+    .alloc = std_alloc, .realloc = std_realloc, .free = std_free, .ctx = NULL};
+
+static bool is_valid_allocator(const ma_allocator_t* alloc) {
+  return !alloc || (alloc->alloc && alloc->realloc && alloc->free);
+}
+
+int ma_set_allocator(const ma_allocator_t* alloc) {
+  if (!is_valid_allocator(alloc)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  default_allocator = alloc ? *alloc : std_allocator;
+  return 0;
+}
+
+int ma_group_set_allocator(ma_group_t* g, const ma_allocator_t* alloc) {
+  if (!g || !is_valid_allocator(alloc)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // The slab is returned to the allocator it came from.
+  if (g->slab) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  g->alloc = alloc ? *alloc : default_allocator;
+  return 0;
+}
+
+int ma_group_set_padded(ma_group_t* g, int padded) {
+  if (!g) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  g->padded = padded != 0;
+  return 0;
+}
+
+// A padded automaton keeps its buffers in one block, each starting at a
+// multiple of `MA_BUFFER_ALIGN` bytes since the lengths are multiples of it.
+static size_t block_size(const moore_t* a) {
+  return total_buffer_words(a) * sizeof(bits_t) + MA_BUFFER_ALIGN;
+}
+
+void alloc_buffers(moore_t* a) {
+  size_t n = a->num_input_bits;
+  size_t s = a->state_bit_count;
+  size_t m = a->num_output_bits;
+
+  if (!a->padded) {
+    a->buffer_block = NULL;
+    a->state = mem_zalloc(&a->alloc, bits_to_words(s) * sizeof(*a->state));
+    a->next_state = mem_zalloc(&a->alloc, bits_to_words(s) * sizeof(*a->next_state));
+    a->input = n == 0 ? NULL : mem_zalloc(&a->alloc, bits_to_words(n) * sizeof(*a->input));
+    a->output = mem_zalloc(&a->alloc, bits_to_words(m) * sizeof(*a->output));
+    return;
+  }
+
+  a->buffer_block = mem_zalloc(&a->alloc, block_size(a));
+  if (!a->buffer_block) {
+    a->state = a->next_state = a->input = a->output = NULL;
+    return;
+  }
+
+  bits_t* pos = align_buffer(a->buffer_block);
+  a->state = pos;
+  pos += buffer_words(a, s);
+  a->next_state = pos;
+  pos += buffer_words(a, s);
+  a->input = n == 0 ? NULL : pos;
+  pos += buffer_words(a, n);
+  a->output = pos;
+}
+
+void free_buffers(moore_t* a) {
+  if (a->padded) {
+    mem_free(&a->alloc, a->buffer_block, block_size(a));
+    a->buffer_block = NULL;
+    return;
+  }
+
+  mem_free(&a->alloc, a->state, bits_to_words(a->state_bit_count) * sizeof(bits_t));
+  mem_free(&a->alloc, a->next_state, bits_to_words(a->state_bit_count) * sizeof(bits_t));
+  mem_free(&a->alloc, a->input, bits_to_words(a->num_input_bits) * sizeof(bits_t));
+  mem_free(&a->alloc, a->output, bits_to_words(a->num_output_bits) * sizeof(bits_t));
+}
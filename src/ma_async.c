@@ -0,0 +1,196 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// Every group stepped asynchronously owns a worker thread, started by the
+// first `ma_step_async`, which runs the requests in the order they were
+// submitted. A request signals its completion through `done` and an eventfd.
+
+struct ma_completion {
+  ma_group_t* group;
+  size_t k;
+  int result;
+  int err;
+  int fd;
+  atomic_bool done;
+  ma_completion_t* next;     // Next request in the queue of the worker.
+};
+
+struct ma_worker {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  ma_completion_t* head;     // Queue of pending requests, guarded by `lock`.
+  ma_completion_t* tail;
+  bool stop;
+};
+
+static void run_request(ma_completion_t* c) {
+  ma_group_t* g = c->group;
+  c->result = group_prepare(g);
+  c->err = c->result == -1 ? errno : 0;
+  for (size_t i = 0; i < c->k && c->result == 0; ++i) {
+    group_step_once(g);
+  }
+
+  atomic_fetch_sub_explicit(&g->async_pending, 1, memory_order_release);
+  uint64_t one = 1;
+  while (write(c->fd, &one, sizeof(one)) == -1 && errno == EINTR) {
+  }
+  // The request may be deleted as soon as it is done.
+  atomic_store_explicit(&c->done, true, memory_order_release);
+}
+
+static void* work(void* arg) {
+  ma_worker_t* w = arg;
+  for (;;) {
+    pthread_mutex_lock(&w->lock);
+    while (!w->head && !w->stop) {
+      pthread_cond_wait(&w->wake, &w->lock);
+    }
+    ma_completion_t* c = w->head;
+    if (c) {
+      w->head = c->next;
+      if (!w->head) {
+        w->tail = NULL;
+      }
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    if (!c) {
+      // Stopped with an empty queue.
+      return NULL;
+    }
+    run_request(c);
+  }
+}
+
+static ma_worker_t* start_worker(void) {
+  ma_worker_t* w = calloc(1, sizeof(*w));
+  if (!w) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  pthread_mutex_init(&w->lock, NULL);
+  pthread_cond_init(&w->wake, NULL);
+  int err = pthread_create(&w->thread, NULL, work, w);
+  if (err != 0) {
+    pthread_cond_destroy(&w->wake);
+    pthread_mutex_destroy(&w->lock);
+    free(w);
+    errno = err;
+    return NULL;
+  }
+
+  return w;
+}
+
+void stop_worker(ma_worker_t* w) {
+  if (!w) {
+    return;
+  }
+
+  // The queued requests are run before the thread exits.
+  pthread_mutex_lock(&w->lock);
+  w->stop = true;
+  pthread_cond_signal(&w->wake);
+  pthread_mutex_unlock(&w->lock);
+
+  pthread_join(w->thread, NULL);
+  pthread_cond_destroy(&w->wake);
+  pthread_mutex_destroy(&w->lock);
+  free(w);
+}
+
+ma_completion_t* ma_step_async(ma_group_t* g, size_t k) {
+  if (!g) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (!g->worker && !(g->worker = start_worker())) {
+    return NULL;
+  }
+
+  ma_completion_t* c = calloc(1, sizeof(*c));
+  if (!c) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  if ((c->fd = eventfd(0, EFD_CLOEXEC)) == -1) {
+    free(c);
+    return NULL;
+  }
+  c->group = g;
+  c->k = k;
+  atomic_init(&c->done, false);
+
+  ma_worker_t* w = g->worker;
+  atomic_fetch_add_explicit(&g->async_pending, 1, memory_order_relaxed);
+  pthread_mutex_lock(&w->lock);
+  if (w->tail) {
+    w->tail->next = c;
+  } else {
+    w->head = c;
+  }
+  w->tail = c;
+  pthread_cond_signal(&w->wake);
+  pthread_mutex_unlock(&w->lock);
+
+  return c;
+}
+
+int ma_completion_poll(const ma_completion_t* c) {
+  if (!c) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  return atomic_load_explicit(&c->done, memory_order_acquire);
+}
+
+int ma_completion_wait(ma_completion_t* c) {
+  if (!c) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Polling leaves the eventfd readable for other waiters.
+  struct pollfd pfd = {.fd = c->fd, .events = POLLIN};
+  while (!atomic_load_explicit(&c->done, memory_order_acquire)) {
+    if (poll(&pfd, 1, -1) == -1 && errno != EINTR) {
+      return -1;
+    }
+  }
+
+  if (c->result == -1) {
+    errno = c->err;
+  }
+  return c->result;
+}
+
+int ma_completion_fd(const ma_completion_t* c) {
+  if (!c) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  return c->fd;
+}
+
+void ma_completion_delete(ma_completion_t* c) {
+  if (!c) {
+    return;
+  }
+
+  int err = errno;
+  ma_completion_wait(c);
+  close(c->fd);
+  free(c);
+  errno = err;
+}
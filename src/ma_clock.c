@@ -0,0 +1,147 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <stdlib.h>
+
+// Longest supported cycle of phases of a group.
+#define MAX_HYPERPERIOD ((size_t) 1 << 16)
+
+int ma_set_clock(moore_t* a, uint32_t period, uint32_t phase) {
+  if (!a || period == 0 || phase >= period) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (a->period != period || a->phase != phase) {
+    a->period = period;
+    a->phase = phase;
+    ++a->clock_version;
+  }
+
+  return 0;
+}
+
+static size_t gcd(size_t a, size_t b) {
+  while (b != 0) {
+    size_t r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+void drop_ticks(ma_group_t* g) {
+  free(g->domains);
+  free(g->domain_members);
+  g->domains = NULL;
+  g->domain_members = NULL;
+  g->num_domains = 0;
+  g->hyperperiod = 0;
+}
+
+// Clock of a member and its position in the group.
+typedef struct {
+  uint32_t period;
+  uint32_t phase;
+  size_t pos;
+} member_clock_t;
+
+static bool same_clock(const member_clock_t* a, const member_clock_t* b) {
+  return a->period == b->period && a->phase == b->phase;
+}
+
+// Orders members by clock, and by position within a clock.
+static int compare_clocks(const void* x, const void* y) {
+  const member_clock_t* a = x;
+  const member_clock_t* b = y;
+  if (a->period != b->period) {
+    return a->period < b->period ? -1 : 1;
+  }
+  if (a->phase != b->phase) {
+    return a->phase < b->phase ? -1 : 1;
+  }
+  return a->pos < b->pos ? -1 : a->pos > b->pos;
+}
+
+int group_prepare(ma_group_t* g) {
+  uint64_t topology = 0, clocks = 0;
+  for (size_t i = 0; i < g->num; ++i) {
+    topology += g->automata[i]->topology_version;
+    clocks += g->automata[i]->clock_version;
+  }
+
+  // The schedule of a clone is its topology and never goes stale.
+  if (g->schedule && !g->clone && g->schedule_version != topology) {
+    if (thaw_schedule(g) == -1) {
+      return -1;
+    }
+    drop_schedule(g);
+  }
+
+  if (g->hyperperiod != 0 && g->ticks_version == clocks) {
+    return 0;
+  }
+
+  drop_ticks(g);
+
+  size_t hyperperiod = 1;
+  for (size_t i = 0; i < g->num; ++i) {
+    size_t period = g->automata[i]->period;
+    hyperperiod = hyperperiod / gcd(hyperperiod, period) * period;
+    if (hyperperiod > MAX_HYPERPERIOD) {
+      errno = E2BIG;
+      return -1;
+    }
+  }
+
+  if (hyperperiod == 1) {
+    // Every member steps on every tick.
+    g->hyperperiod = 1;
+    g->ticks_version = clocks;
+    return 0;
+  }
+
+  // Each member is listed once, in the domain of its clock, so the domains
+  // take memory linear in the members whatever the hyperperiod.
+  member_clock_t* keys = malloc(g->num * sizeof(*keys));
+  moore_t** members = malloc(g->num * sizeof(*members));
+  clock_domain_t* domains = NULL;
+  if (!keys || !members) {
+    goto fail;
+  }
+  for (size_t i = 0; i < g->num; ++i) {
+    const moore_t* a = g->automata[i];
+    keys[i] = (member_clock_t) {.period = a->period, .phase = a->phase, .pos = i};
+  }
+  qsort(keys, g->num, sizeof(*keys), compare_clocks);
+
+  size_t num_domains = 0;
+  for (size_t i = 0; i < g->num; ++i) {
+    num_domains += i == 0 || !same_clock(&keys[i], &keys[i - 1]);
+  }
+  if (!(domains = malloc((num_domains + 1) * sizeof(*domains)))) {
+    goto fail;
+  }
+
+  // Members keep their group order within a domain.
+  for (size_t i = 0, d = 0; i < g->num; ++i) {
+    if (i == 0 || !same_clock(&keys[i], &keys[i - 1])) {
+      domains[d++] = (clock_domain_t) {.period = keys[i].period, .phase = keys[i].phase, .first = i};
+    }
+    members[i] = g->automata[keys[i].pos];
+  }
+  domains[num_domains].first = g->num;
+
+  free(keys);
+  g->domains = domains;
+  g->num_domains = num_domains;
+  g->domain_members = members;
+  g->hyperperiod = hyperperiod;
+  g->ticks_version = clocks;
+  return 0;
+
+fail:
+  free(keys);
+  free(members);
+  errno = ENOMEM;
+  return -1;
+}
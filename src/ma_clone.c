@@ -0,0 +1,233 @@
+#define _GNU_SOURCE
+#include "ma_internal.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// A clone maps the memory file of its origin's slab privately, so the kernel
+// copies a page of buffers only when either group writes to it. The origin
+// maps the same file privately as well, and the file keeps the contents at
+// the time of the clone until the last mapping is gone.
+
+void release_slab(ma_group_t* g) {
+  if (g->slab_clean) {
+    close(g->slab_fd);
+    g->slab_clean = false;
+  }
+  if (g->slab_mapped) {
+    munmap(g->slab, g->slab_len);
+  } else {
+    mem_free(&g->alloc, g->slab_block, g->slab_len + MA_BUFFER_ALIGN);
+  }
+  g->slab = NULL;
+  g->slab_block = NULL;
+  g->slab_len = 0;
+  g->slab_mapped = false;
+}
+
+void slab_written(ma_group_t* g) {
+  if (g->slab_clean) {
+    close(g->slab_fd);
+    g->slab_clean = false;
+  }
+}
+
+// Moves the buffer pointers of `a` from the slab at `from` to the one at `to`.
+static void rebase(moore_t* a, const bits_t* from, bits_t* to) {
+  bits_t** bufs[4] = {&a->state, &a->next_state, &a->input, &a->output};
+  for (size_t j = 0; j < 4; ++j) {
+    if (*bufs[j]) {
+      *bufs[j] = to + (*bufs[j] - from);
+    }
+  }
+}
+
+// Makes the slab of `g` a private mapping of a memory file with the same
+// contents, unless it already is one and has not been written since.
+static int freeze_slab(ma_group_t* g) {
+  if (g->slab_clean) {
+    return 0;
+  }
+
+  size_t len = g->slab_len;
+  int fd = memfd_create("ma_slab", MFD_CLOEXEC);
+  if (fd == -1) {
+    return -1;
+  }
+
+  void* file = MAP_FAILED;
+  void* base = MAP_FAILED;
+  if (ftruncate(fd, len) == -1 ||
+      (file = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    goto fail;
+  }
+  memcpy(file, g->slab, len);
+  munmap(file, len);
+
+  base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if (base == MAP_FAILED) {
+    goto fail;
+  }
+
+  if (g->slab_mapped) {
+    // Replace the old mapping in place, so that the buffers do not move.
+    if (mremap(base, len, len, MREMAP_MAYMOVE | MREMAP_FIXED, g->slab) == MAP_FAILED) {
+      goto fail;
+    }
+  } else {
+    for (size_t i = 0; i < g->num; ++i) {
+      rebase(g->automata[i], g->slab, base);
+    }
+    mem_free(&g->alloc, g->slab_block, len + MA_BUFFER_ALIGN);
+    g->slab = base;
+    g->slab_block = NULL;
+    g->slab_mapped = true;
+  }
+
+  g->slab_fd = fd;
+  g->slab_clean = true;
+  return 0;
+
+fail:;
+  int err = errno;
+  if (base != MAP_FAILED) {
+    munmap(base, len);
+  }
+  close(fd);
+  errno = err;
+  return -1;
+}
+
+// Brings the buffers and the schedule of `g` into the form clones share.
+static int prepare_origin(ma_group_t* g) {
+  bool compact = g->slab == NULL;
+  for (size_t i = 0; i < g->num && !compact; ++i) {
+    compact = g->automata[i]->slab_group != g;
+  }
+  if (compact && ma_group_compact(g) == -1) {
+    return -1;
+  }
+
+  if ((!g->schedule || (!g->clone && !schedule_current(g))) &&
+      ma_group_freeze(g) == -1) {
+    return -1;
+  }
+
+  if (!g->schedule_refs) {
+    if (!(g->schedule_refs = malloc(sizeof(*g->schedule_refs)))) {
+      errno = ENOMEM;
+      return -1;
+    }
+    atomic_init(g->schedule_refs, 1);
+  }
+
+  return freeze_slab(g);
+}
+
+// Copies the handle table of `g` into `c`.
+static int copy_slots(ma_group_t* c, const ma_group_t* g) {
+  if (!g->slot_of) {
+    return 0;
+  }
+
+  c->slots = malloc((g->num_slots == 0 ? 1 : g->num_slots) * sizeof(*c->slots));
+  c->slot_of = malloc((g->num == 0 ? 1 : g->num) * sizeof(*c->slot_of));
+  if (!c->slots || !c->slot_of) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  memcpy(c->slots, g->slots, g->num_slots * sizeof(*c->slots));
+  memcpy(c->slot_of, g->slot_of, g->num * sizeof(*c->slot_of));
+  c->num_slots = g->num_slots;
+  c->slots_cap = g->num_slots;
+  c->free_slot = g->free_slot;
+  return 0;
+}
+
+ma_group_t* ma_group_clone(ma_group_t* g) {
+  if (!g) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (!g->owner) {
+    errno = EPERM;
+    return NULL;
+  }
+
+  if (async_busy(g)) {
+    errno = EBUSY;
+    return NULL;
+  }
+
+  if (prepare_origin(g) == -1) {
+    return NULL;
+  }
+
+  ma_group_t* c = calloc(1, sizeof(*c));
+  if (!c) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  size_t num = g->num == 0 ? 1 : g->num;
+  c->automata = malloc(num * sizeof(*c->automata));
+  c->clone_members = malloc(num * sizeof(*c->clone_members));
+  if (!c->automata || !c->clone_members) {
+    errno = ENOMEM;
+    goto fail;
+  }
+  if (copy_slots(c, g) == -1) {
+    goto fail;
+  }
+
+  bits_t* base = mmap(NULL, g->slab_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, g->slab_fd, 0);
+  if (base == MAP_FAILED) {
+    goto fail;
+  }
+  c->slab = base;
+  c->slab_len = g->slab_len;
+  c->slab_mapped = true;
+
+  for (size_t i = 0; i < g->num; ++i) {
+    moore_t* a = &c->clone_members[i];
+    *a = *g->automata[i];
+    rebase(a, g->slab, base);
+    a->input_connections = NULL;
+    a->output_connections = NULL;
+    a->slab_group = c;
+    a->cloned = true;
+    a->frozen_group = NULL;
+    a->port = NULL;
+    a->table = NULL;
+    a->memo = NULL;
+    a->stim = NULL;
+#ifdef MA_STATS
+    memset(&a->stats, 0, sizeof(a->stats));
+#endif
+    c->automata[i] = a;
+  }
+
+  c->num = g->num;
+  c->cap = g->num;
+  c->cycle = g->cycle;
+  c->owner = true;
+  c->alloc = g->alloc;
+  c->clone = true;
+  c->schedule = g->schedule;
+  c->schedule_first = g->schedule_first;
+  c->schedule_version = g->schedule_version;
+  c->schedule_refs = g->schedule_refs;
+  atomic_fetch_add(c->schedule_refs, 1);
+
+  return c;
+
+fail:;
+  int err = errno;
+  ma_group_delete(c);
+  errno = err;
+  return NULL;
+}
@@ -0,0 +1,173 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <stdlib.h>
+
+#define INIT_EDITS 16
+
+// Queued edits are applied by the thread stepping the group, so that the
+// connections and the frozen schedule change only between steps. Other
+// threads hold `edits_lock` just long enough to append to the queue.
+
+static void lock_edits(ma_group_t* g) {
+  while (atomic_exchange_explicit(&g->edits_lock, true, memory_order_acquire)) {
+  }
+}
+
+static void unlock_edits(ma_group_t* g) {
+  atomic_store_explicit(&g->edits_lock, false, memory_order_release);
+}
+
+// Makes the schedule of `g` private to it, so that clones keep theirs.
+static int own_schedule(ma_group_t* g) {
+  if (!g->schedule_refs || atomic_load(g->schedule_refs) == 1) {
+    return 0;
+  }
+
+  size_t entries = g->schedule_first[g->num];
+  compact_conn_t* schedule = malloc((entries + 1) * sizeof(*schedule));
+  size_t* first = malloc((g->num + 1) * sizeof(*first));
+  if (!schedule || !first) {
+    free(schedule);
+    free(first);
+    errno = ENOMEM;
+    return -1;
+  }
+  memcpy(schedule, g->schedule, entries * sizeof(*schedule));
+  memcpy(first, g->schedule_first, (g->num + 1) * sizeof(*first));
+
+  // The clones may have been deleted in the meantime.
+  if (atomic_fetch_sub(g->schedule_refs, 1) == 1) {
+    free(g->schedule);
+    free(g->schedule_first);
+    free(g->schedule_refs);
+  }
+  g->schedule = schedule;
+  g->schedule_first = first;
+  g->schedule_refs = NULL;
+  return 0;
+}
+
+// Rewrites the schedule entries of the inputs of `spec`, whose `a_in` is
+// the member at `pos`. Returns false if the new connection cannot be encoded.
+static bool patch_entries(ma_group_t* g, const ma_conn_spec_t* spec, size_t pos) {
+  size_t driver = UNCONNECTED;
+  if (spec->a_out) {
+    driver = find_member(g->schedule_index, g->num, spec->a_out);
+    if (driver == SIZE_MAX || spec->out + spec->num - 1 > UINT32_MAX) {
+      return false;
+    }
+  }
+
+  compact_conn_t* c = g->schedule + g->schedule_first[pos] + spec->in;
+  for (size_t i = 0; i < spec->num; ++i) {
+    c[i].driver = driver;
+    c[i].driver_bit = spec->a_out ? spec->out + i : 0;
+  }
+  return true;
+}
+
+void patch_schedule(ma_group_t* g, const ma_conn_spec_t* specs, size_t k) {
+  if (!g->schedule || g->clone) {
+    return;
+  }
+
+  bool ok = true;
+  for (size_t r = 0; r < k && ok; ++r) {
+    size_t pos = find_member(g->schedule_index, g->num, specs[r].a_in);
+    if (pos == SIZE_MAX) {
+      // Only the inputs of members are scheduled.
+      continue;
+    }
+    // Applying the spec incremented the version of `a_in` once.
+    ++g->schedule_version;
+    ok = own_schedule(g) == 0 && patch_entries(g, &specs[r], pos);
+  }
+
+  if (!ok) {
+    // The group falls back to gathering through the connections. Applying
+    // a spec to a member gave a compact group its records back.
+    drop_schedule(g);
+  }
+}
+
+int apply_queued_edits(ma_group_t* g) {
+  lock_edits(g);
+
+  int ret = apply_edits(g->edits, g->num_edits);
+  if (ret == 0) {
+    patch_schedule(g, g->edits, g->num_edits);
+    g->num_edits = 0;
+    atomic_store_explicit(&g->edits_pending, false, memory_order_relaxed);
+  }
+
+  unlock_edits(g);
+  return ret;
+}
+
+int ma_group_queue_edits(ma_group_t* g, const ma_conn_spec_t* edits, size_t k) {
+  if (!g || (k != 0 && !edits)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (size_t r = 0; r < k; ++r) {
+    if (!is_valid_edit(&edits[r])) {
+      errno = EINVAL;
+      return -1;
+    }
+  }
+
+  // The topology of a clone is shared with the group it was cloned from.
+  if (g->clone) {
+    errno = EPERM;
+    return -1;
+  }
+  for (size_t r = 0; r < k; ++r) {
+    if (edits[r].a_in->cloned || (edits[r].a_out && edits[r].a_out->cloned)) {
+      errno = EPERM;
+      return -1;
+    }
+  }
+
+  if (k == 0) {
+    return 0;
+  }
+
+  lock_edits(g);
+
+  int ret = 0;
+  if (k > g->edits_cap - g->num_edits) {
+    size_t cap = g->edits_cap == 0 ? INIT_EDITS : 2 * g->edits_cap;
+    if (cap < g->num_edits + k) {
+      cap = g->num_edits + k;
+    }
+    ma_conn_spec_t* tmp = realloc(g->edits, cap * sizeof(*tmp));
+    if (!tmp) {
+      errno = ENOMEM;
+      ret = -1;
+      goto exit;
+    }
+    g->edits = tmp;
+    g->edits_cap = cap;
+  }
+
+  memcpy(g->edits + g->num_edits, edits, k * sizeof(*edits));
+  g->num_edits += k;
+  atomic_store_explicit(&g->edits_pending, true, memory_order_release);
+
+exit:
+  unlock_edits(g);
+  return ret;
+}
+
+int ma_group_apply_edits(ma_group_t* g) {
+  if (!g) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (!atomic_load_explicit(&g->edits_pending, memory_order_acquire)) {
+    return 0;
+  }
+  return apply_queued_edits(g);
+}
@@ -0,0 +1,425 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_RUN SIZE_MAX
+
+// Every worker simulates both networks on its own copy of their buffers,
+// calling the transition and output functions of the members directly, so
+// that the groups themselves are not changed and any number of runs can
+// proceed at once.
+
+// Source of a connected input bit of a member.
+typedef struct {
+  size_t member;
+  size_t bit;
+  const bits_t* ext;     // Output of a driver outside of the group, or NULL.
+  size_t driver;         // Position of the driving member (when `ext` is NULL).
+  size_t driver_bit;
+} source_t;
+
+// The layout of the buffers of a network in the scratch of a worker.
+typedef struct {
+  const ma_group_t* g;
+  size_t* off;           // Per member: offsets of state, next state, input, output.
+  size_t words;
+  source_t* sources;
+  size_t num_sources;
+  bits_t* image;         // The buffers at the start of every run.
+} net_t;
+
+// A pair of mapped members, by position in their groups.
+typedef struct {
+  size_t pos[2];
+  size_t bits;
+} pair_t;
+
+typedef struct {
+  net_t net[2];
+  pair_t* inputs;
+  size_t num_inputs;
+  pair_t* outputs;
+  size_t num_outputs;
+  size_t input_words;    // Words of the stimulus of a cycle.
+  uint64_t cycles;
+  uint64_t seed;
+  size_t runs;
+  atomic_size_t next_run;
+
+  // The divergence of the run with the lowest index. Runs past it are skipped.
+  pthread_mutex_t lock;
+  atomic_size_t found_run;
+  uint64_t found_cycle;
+  size_t found_output;
+} check_t;
+
+typedef struct {
+  check_t* ck;
+  bits_t* scratch[2];
+  bits_t* stimulus;
+} worker_t;
+
+static bits_t* buf(const net_t* n, bits_t* scratch, size_t i, size_t which) {
+  return scratch + n->off[4 * i + which];
+}
+
+// Lays out the buffers of the members of `g` and records the sources of
+// their connected inputs and their current buffers.
+static int build_net(net_t* n, const ma_group_t* g) {
+  n->g = g;
+  n->off = malloc((4 * g->num + 1) * sizeof(*n->off));
+  member_entry_t* index = build_member_index(g);
+  if (!n->off || !index) {
+    free(index);
+    return -1;
+  }
+
+  size_t off = 0, num_sources = 0;
+  for (size_t i = 0; i < g->num; ++i) {
+    const moore_t* a = g->automata[i];
+    size_t sizes[4] = {buffer_words(a, a->state_bit_count), buffer_words(a, a->state_bit_count),
+                       buffer_words(a, a->num_input_bits), buffer_words(a, a->num_output_bits)};
+    if (a->padded) {
+      off = (off + PAD_WORDS - 1) / PAD_WORDS * PAD_WORDS;
+    }
+    for (size_t j = 0; j < 4; ++j) {
+      n->off[4 * i + j] = off;
+      off += sizes[j];
+    }
+    for (size_t j = 0; j < a->num_input_bits; ++j) {
+      num_sources += input_source(a, j).automaton != NULL;
+    }
+  }
+  n->words = off;
+
+  n->sources = malloc((num_sources + 1) * sizeof(*n->sources));
+  n->image = alloc_scratch(n->words);
+  if (!n->sources || !n->image) {
+    free(index);
+    return -1;
+  }
+
+  for (size_t i = 0; i < g->num; ++i) {
+    const moore_t* a = g->automata[i];
+    const bits_t* src[4] = {a->state, NULL, a->input, a->output};
+    size_t bits[4] = {a->state_bit_count, 0, a->num_input_bits, a->num_output_bits};
+    for (size_t j = 0; j < 4; ++j) {
+      if (src[j] && bits[j] != 0) {
+        memcpy(n->image + n->off[4 * i + j], src[j], bits_to_words(bits[j]) * sizeof(bits_t));
+      }
+    }
+
+    for (size_t j = 0; j < a->num_input_bits; ++j) {
+      connection_t conn = input_source(a, j);
+      if (!conn.automaton) {
+        continue;
+      }
+      size_t driver = find_member(index, g->num, conn.automaton);
+      n->sources[n->num_sources++] = (source_t) {
+          .member = i,
+          .bit = j,
+          .ext = driver == SIZE_MAX ? conn.automaton->output : NULL,
+          .driver = driver,
+          .driver_bit = conn.bit_idx};
+    }
+  }
+
+  free(index);
+  return 0;
+}
+
+static void destroy_net(net_t* n) {
+  free(n->off);
+  free(n->sources);
+  free(n->image);
+}
+
+// Fills the stimulus of a cycle: the input words of every mapped input pair.
+static void make_stimulus(const check_t* ck, rng_t* rng, bits_t* vec) {
+  for (size_t p = 0; p < ck->num_inputs; ++p) {
+    size_t bits = ck->inputs[p].bits;
+    for (size_t w = 0; w < bits_to_words(bits); ++w) {
+      *vec++ = rng_next(rng);
+    }
+    if (bits % BITS_PER_WORD != 0) {
+      vec[-1] &= ((bits_t) 1 << (bits % BITS_PER_WORD)) - 1;
+    }
+  }
+}
+
+// Performs step `tick` of network `side`, driven by `vec`. The connected
+// inputs are gathered over the stimulus.
+static void step_net(const check_t* ck, size_t side, bits_t* scratch, const bits_t* vec,
+                     uint64_t tick) {
+  const net_t* n = &ck->net[side];
+  for (size_t p = 0; p < ck->num_inputs; ++p) {
+    size_t words = bits_to_words(ck->inputs[p].bits);
+    memcpy(buf(n, scratch, ck->inputs[p].pos[side], 2), vec, words * sizeof(bits_t));
+    vec += words;
+  }
+
+  for (size_t k = 0; k < n->num_sources; ++k) {
+    const source_t* s = &n->sources[k];
+    const bits_t* src = s->ext ? s->ext : buf(n, scratch, s->driver, 3);
+    copy_bit(buf(n, scratch, s->member, 2), get_bit(src, s->driver_bit), s->bit);
+  }
+
+  for (size_t i = 0; i < n->g->num; ++i) {
+    const moore_t* a = n->g->automata[i];
+    if (tick % a->period != a->phase) {
+      continue;
+    }
+    bits_t* state = buf(n, scratch, i, 0);
+    bits_t* next = buf(n, scratch, i, 1);
+    bits_t* output = buf(n, scratch, i, 3);
+    a->trans_func(next, buf(n, scratch, i, 2), state, a->num_input_bits, a->state_bit_count);
+    if (a->padded) {
+      clear_pad(next, a->state_bit_count, buffer_words(a, a->state_bit_count));
+    }
+    memcpy(state, next, bits_to_words(a->state_bit_count) * sizeof(bits_t));
+    a->out_func(output, state, a->num_output_bits, a->state_bit_count);
+    if (a->padded) {
+      clear_pad(output, a->num_output_bits, buffer_words(a, a->num_output_bits));
+    }
+  }
+}
+
+// Returns the index of the first mapped output pair that differs, or `SIZE_MAX`.
+static size_t compare_outputs(const check_t* ck, bits_t* const scratch[2]) {
+  for (size_t p = 0; p < ck->num_outputs; ++p) {
+    const pair_t* pair = &ck->outputs[p];
+    const bits_t* x = buf(&ck->net[0], scratch[0], pair->pos[0], 3);
+    const bits_t* y = buf(&ck->net[1], scratch[1], pair->pos[1], 3);
+    for (size_t off = 0; off < pair->bits; off += BITS_PER_WORD) {
+      size_t len = pair->bits - off < BITS_PER_WORD ? pair->bits - off : BITS_PER_WORD;
+      if (read_bits(x, off, len) != read_bits(y, off, len)) {
+        return p;
+      }
+    }
+  }
+  return SIZE_MAX;
+}
+
+static void report(check_t* ck, size_t run, uint64_t cycle, size_t output) {
+  pthread_mutex_lock(&ck->lock);
+  if (run < atomic_load(&ck->found_run)) {
+    ck->found_cycle = cycle;
+    ck->found_output = output;
+    atomic_store(&ck->found_run, run);
+  }
+  pthread_mutex_unlock(&ck->lock);
+}
+
+static void check_run(worker_t* w, size_t run) {
+  check_t* ck = w->ck;
+  for (size_t side = 0; side < 2; ++side) {
+    memcpy(w->scratch[side], ck->net[side].image, ck->net[side].words * sizeof(bits_t));
+  }
+
+  size_t output = compare_outputs(ck, w->scratch);
+  if (output != SIZE_MAX) {
+    report(ck, run, 0, output);
+    return;
+  }
+
+  rng_t rng;
+  rng_seed(&rng, ck->seed + run);
+  for (uint64_t c = 0; c < ck->cycles; ++c) {
+    if (run > atomic_load_explicit(&ck->found_run, memory_order_relaxed)) {
+      return;
+    }
+    make_stimulus(ck, &rng, w->stimulus);
+    step_net(ck, 0, w->scratch[0], w->stimulus, ck->net[0].g->cycle + c);
+    step_net(ck, 1, w->scratch[1], w->stimulus, ck->net[1].g->cycle + c);
+    if ((output = compare_outputs(ck, w->scratch)) != SIZE_MAX) {
+      report(ck, run, c + 1, output);
+      return;
+    }
+  }
+}
+
+static void* check_runs(void* arg) {
+  worker_t* w = arg;
+  check_t* ck = w->ck;
+  size_t run;
+  while ((run = atomic_fetch_add(&ck->next_run, 1)) < ck->runs &&
+         run < atomic_load(&ck->found_run)) {
+    check_run(w, run);
+  }
+  return NULL;
+}
+
+// Resolves `num` member pairs into positions. `inputs` selects whether the
+// input or the output widths must agree.
+static pair_t* resolve_pairs(const ma_equiv_pair_t* pairs, size_t num, const ma_group_t* g[2],
+                             bool inputs) {
+  pair_t* res = malloc((num + 1) * sizeof(*res));
+  member_entry_t* index[2] = {build_member_index(g[0]), build_member_index(g[1])};
+  if (!res || !index[0] || !index[1]) {
+    errno = ENOMEM;
+    goto fail;
+  }
+
+  for (size_t p = 0; p < num; ++p) {
+    const moore_t* at[2] = {pairs[p].a, pairs[p].b};
+    for (size_t side = 0; side < 2; ++side) {
+      res[p].pos[side] = at[side] ? find_member(index[side], g[side]->num, at[side]) : SIZE_MAX;
+      if (res[p].pos[side] == SIZE_MAX) {
+        errno = EINVAL;
+        goto fail;
+      }
+    }
+    res[p].bits = inputs ? at[0]->num_input_bits : at[0]->num_output_bits;
+    if (res[p].bits != (inputs ? at[1]->num_input_bits : at[1]->num_output_bits)) {
+      errno = EINVAL;
+      goto fail;
+    }
+  }
+
+  free(index[0]);
+  free(index[1]);
+  return res;
+
+fail:
+  free(res);
+  free(index[0]);
+  free(index[1]);
+  return NULL;
+}
+
+static int init_worker(worker_t* w, check_t* ck) {
+  w->ck = ck;
+  w->scratch[0] = alloc_scratch(ck->net[0].words);
+  w->scratch[1] = alloc_scratch(ck->net[1].words);
+  w->stimulus = malloc((ck->input_words + 1) * sizeof(bits_t));
+  return w->scratch[0] && w->scratch[1] && w->stimulus ? 0 : -1;
+}
+
+static void destroy_worker(worker_t* w) {
+  free(w->scratch[0]);
+  free(w->scratch[1]);
+  free(w->stimulus);
+}
+
+// Regenerates the stimulus leading to the reported divergence.
+static int build_trace(const check_t* ck, ma_equiv_result_t* result) {
+  result->equivalent = 0;
+  result->seed = ck->seed + atomic_load(&ck->found_run);
+  result->cycle = ck->found_cycle;
+  result->output = ck->found_output;
+  result->trace_len = ck->found_cycle;
+  result->input_words = ck->input_words;
+  if (ck->found_cycle == 0 || ck->input_words == 0) {
+    return 0;
+  }
+
+  if (ck->found_cycle > SIZE_MAX / sizeof(bits_t) / ck->input_words ||
+      !(result->trace_inputs = malloc(ck->found_cycle * ck->input_words * sizeof(bits_t)))) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  rng_t rng;
+  rng_seed(&rng, result->seed);
+  for (uint64_t c = 0; c < ck->found_cycle; ++c) {
+    make_stimulus(ck, &rng, result->trace_inputs + c * ck->input_words);
+  }
+  return 0;
+}
+
+int ma_equiv_check(ma_group_t* a, ma_group_t* b, const ma_equiv_map_t* map, uint64_t cycles,
+                   uint64_t seed, ma_equiv_result_t* result) {
+  if (!a || !b || !map || !result || map->num_outputs == 0 || !map->outputs ||
+      (map->num_inputs != 0 && !map->inputs)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (async_busy(a) || async_busy(b)) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  memset(result, 0, sizeof(*result));
+  result->equivalent = 1;
+
+  size_t num_threads = map->num_threads == 0 ? 1 : map->num_threads;
+  check_t ck = {.cycles = cycles, .seed = seed, .runs = map->runs == 0 ? 1 : map->runs,
+                .num_inputs = map->num_inputs, .num_outputs = map->num_outputs,
+                .found_run = NO_RUN};
+  atomic_init(&ck.next_run, 0);
+  pthread_mutex_init(&ck.lock, NULL);
+
+  const ma_group_t* groups[2] = {a, b};
+  worker_t* workers = NULL;
+  pthread_t* threads = NULL;
+  size_t initialized = 0;
+  int ret = -1;
+
+  if (!(ck.inputs = resolve_pairs(map->inputs, map->num_inputs, groups, true)) ||
+      !(ck.outputs = resolve_pairs(map->outputs, map->num_outputs, groups, false))) {
+    goto out;
+  }
+  for (size_t p = 0; p < ck.num_inputs; ++p) {
+    ck.input_words += bits_to_words(ck.inputs[p].bits);
+  }
+
+  if (build_net(&ck.net[0], a) == -1 || build_net(&ck.net[1], b) == -1 ||
+      !(workers = malloc(num_threads * sizeof(*workers))) ||
+      !(threads = malloc(num_threads * sizeof(*threads)))) {
+    errno = ENOMEM;
+    goto out;
+  }
+
+  for (; initialized < num_threads; ++initialized) {
+    if (init_worker(&workers[initialized], &ck) == -1) {
+      destroy_worker(&workers[initialized]);
+      errno = ENOMEM;
+      goto out;
+    }
+  }
+
+  size_t started = 1;
+  for (; started < num_threads; ++started) {
+    if (pthread_create(&threads[started], NULL, check_runs, &workers[started]) != 0) {
+      break;
+    }
+  }
+  check_runs(&workers[0]);
+  for (size_t t = 1; t < started; ++t) {
+    pthread_join(threads[t], NULL);
+  }
+
+  ret = atomic_load(&ck.found_run) == NO_RUN ? 0 : build_trace(&ck, result);
+
+out:
+  for (size_t t = 0; t < initialized; ++t) {
+    destroy_worker(&workers[t]);
+  }
+  free(workers);
+  free(threads);
+  free(ck.inputs);
+  free(ck.outputs);
+  destroy_net(&ck.net[0]);
+  destroy_net(&ck.net[1]);
+  pthread_mutex_destroy(&ck.lock);
+
+  if (ret == -1) {
+    ma_equiv_result_free(result);
+  }
+
+  return ret;
+}
+
+void ma_equiv_result_free(ma_equiv_result_t* result) {
+  if (!result) {
+    return;
+  }
+
+  free(result->trace_inputs);
+  result->trace_inputs = NULL;
+  result->trace_len = 0;
+}
@@ -14,6 +14,31 @@ static const test_list_t test_list[] = {
   TEST(invalid_data_test),
   TEST(connection_test),
   TEST(memory_test),
+  TEST(reach_test),
+  TEST(stream_test),
+  TEST(trace_test),
+  TEST(snapshot_test),
+  TEST(netlist_test),
+  TEST(stats_test),
+  TEST(memory_usage_test),
+  TEST(handle_test),
+  TEST(connect_many_test),
+  TEST(port_test),
+  TEST(view_test),
+  TEST(clock_test),
+  TEST(module_test),
+  TEST(optimize_test),
+  TEST(shard_test),
+  TEST(kernel_test),
+  TEST(clone_test),
+  TEST(pace_test),
+  TEST(alloc_test),
+  TEST(padded_test),
+  TEST(edit_test),
+  TEST(async_test),
+  TEST(equiv_test),
+  TEST(memo_test),
+  TEST(stim_test),
 };
 
 static int do_test(test_t function) {
@@ -0,0 +1,202 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+ma_group_t* ma_group_create(moore_t* at[], size_t num) {
+  bool ok = num != 0 && at;
+  for (size_t i = 0; i < num && ok; ++i) {
+    ok = at[i] != NULL;
+  }
+
+  if (!ok) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  ma_group_t* g = calloc(1, sizeof(*g));
+  if (!g) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  g->automata = malloc(num * sizeof(*g->automata));
+  if (!g->automata) {
+    free(g);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  memcpy(g->automata, at, num * sizeof(*g->automata));
+  g->num = num;
+  g->cap = num;
+  g->alloc = default_allocator;
+
+  return g;
+}
+
+void ma_group_delete(ma_group_t* g) {
+  if (!g) {
+    return;
+  }
+
+  stop_worker(g->worker);
+  if (g->trace) {
+    ma_trace_stop(g->trace);
+  }
+  ma_rewind_stop(g->rewind);
+  ma_view_delete(g->view);
+
+  if (g->clone) {
+    // The members share one allocation and have no connections.
+    for (size_t i = 0; i < g->num; ++i) {
+      ma_port_close(g->automata[i]->port);
+      free(g->automata[i]->table);
+    }
+  } else if (g->owner) {
+    // Members reading their inputs from the schedule leave the fan-out
+    // arrays before any of them is deleted.
+    if (g->compact) {
+      for (size_t i = 0; i < g->num; ++i) {
+        detach_inputs(g->automata[i]);
+        g->automata[i]->frozen_group = NULL;
+      }
+      g->compact = false;
+    }
+    for (size_t i = 0; i < g->num; ++i) {
+      ma_delete(g->automata[i]);
+    }
+  }
+
+  drop_schedule(g);
+  drop_ticks(g);
+  free(g->automata);
+  free(g->clone_members);
+  free(g->slots);
+  free(g->slot_of);
+  free(g->edits);
+  release_slab(g);
+  free(g);
+}
+
+static int compare_members(const void* lhs, const void* rhs) {
+  uintptr_t a = (uintptr_t) ((const member_entry_t*) lhs)->automaton;
+  uintptr_t b = (uintptr_t) ((const member_entry_t*) rhs)->automaton;
+  return (a > b) - (a < b);
+}
+
+member_entry_t* build_member_index(const ma_group_t* g) {
+  member_entry_t* index = malloc((g->num + 1) * sizeof(*index));
+  if (!index) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  for (size_t i = 0; i < g->num; ++i) {
+    index[i] = (member_entry_t) {.automaton = g->automata[i], .idx = i};
+  }
+  qsort(index, g->num, sizeof(*index), compare_members);
+
+  return index;
+}
+
+size_t find_member(const member_entry_t* index, size_t num, const moore_t* a) {
+  member_entry_t key = {.automaton = a};
+  const member_entry_t* e = bsearch(&key, index, num, sizeof(*index), compare_members);
+  return e ? e->idx : SIZE_MAX;
+}
+
+void group_step_once(ma_group_t* g) {
+#ifdef MA_STATS
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+#endif
+
+  if (atomic_load_explicit(&g->edits_pending, memory_order_acquire)) {
+    // A failed batch stays queued and is retried at the next step.
+    apply_queued_edits(g);
+  }
+
+  slab_written(g);
+
+  if (g->hyperperiod > 1) {
+    // Only the domains clocked on this tick gather and step. All of them
+    // gather before any steps, so that they read the outputs of the last tick.
+    for (size_t d = 0; d < g->num_domains; ++d) {
+      const clock_domain_t* c = &g->domains[d];
+      if (g->cycle % c->period == c->phase) {
+        moore_t** at = g->domain_members + c->first;
+        drain_ports(at, c[1].first - c->first);
+        gather_inputs(at, c[1].first - c->first);
+      }
+    }
+    for (size_t d = 0; d < g->num_domains; ++d) {
+      const clock_domain_t* c = &g->domains[d];
+      if (g->cycle % c->period == c->phase) {
+        transition_automata(g->domain_members + c->first, c[1].first - c->first);
+      }
+    }
+  } else {
+    drain_ports(g->automata, g->num);
+    if (g->schedule) {
+      gather_frozen(g);
+    } else {
+      gather_inputs(g->automata, g->num);
+    }
+    transition_automata(g->automata, g->num);
+  }
+  ++g->cycle;
+
+#ifdef MA_STATS
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  uint64_t ns = (uint64_t) (end.tv_sec - start.tv_sec) * 1000000000u + end.tv_nsec - start.tv_nsec;
+  size_t bucket = 0;
+  while (bucket + 1 < MA_STATS_BUCKETS && (ns >> (bucket + 1)) != 0) {
+    ++bucket;
+  }
+  ++g->steps;
+  g->step_ns_total += ns;
+  ++g->step_ns_hist[bucket];
+#endif
+
+  if (g->trace) {
+    trace_record(g->trace, g->cycle);
+  }
+  if (g->rewind) {
+    rewind_record(g->rewind);
+  }
+  if (g->view) {
+    view_publish(g->view);
+  }
+}
+
+int ma_group_step(ma_group_t* g, size_t k) {
+  if (!g) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (async_busy(g)) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  if (group_prepare(g) == -1) {
+    return -1;
+  }
+
+  for (size_t i = 0; i < k; ++i) {
+    group_step_once(g);
+  }
+
+  return 0;
+}
+
+uint64_t ma_group_cycle(const ma_group_t* g) {
+  if (!g) {
+    errno = EINVAL;
+    return 0;
+  }
+
+  return g->cycle;
+}
@@ -0,0 +1,356 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_SLOT UINT32_MAX
+
+static ma_id_t make_id(uint32_t slot, uint32_t generation) {
+  return ((ma_id_t) generation << 32) | slot;
+}
+
+// Makes room for `need` slots in the handle table.
+static int reserve_slots(ma_group_t* g, size_t need) {
+  if (need <= g->slots_cap) {
+    return 0;
+  }
+
+  size_t new_cap = g->slots_cap == 0 ? 16 : 2 * g->slots_cap;
+  while (new_cap < need) {
+    new_cap *= 2;
+  }
+
+  slot_t* tmp = realloc(g->slots, new_cap * sizeof(*tmp));
+  if (!tmp) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  g->slots = tmp;
+  g->slots_cap = new_cap;
+  return 0;
+}
+
+// Creates the handle table of a group, giving every member the slot equal
+// to its position.
+static int ensure_slots(ma_group_t* g) {
+  if (g->slot_of) {
+    return 0;
+  }
+
+  if (reserve_slots(g, g->num) == -1) {
+    return -1;
+  }
+
+  g->slot_of = malloc((g->cap == 0 ? 1 : g->cap) * sizeof(*g->slot_of));
+  if (!g->slot_of) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  for (size_t i = 0; i < g->num; ++i) {
+    g->slots[i] = (slot_t) {.generation = 1, .position = i, .live = true};
+    g->slot_of[i] = i;
+  }
+  g->num_slots = g->num;
+  g->free_slot = NO_SLOT;
+
+  return 0;
+}
+
+// Grows the member arrays so that one more automaton fits.
+static int reserve_member(ma_group_t* g) {
+  if (g->num < g->cap) {
+    return 0;
+  }
+
+  size_t new_cap = g->cap == 0 ? 16 : 2 * g->cap;
+  moore_t** automata = realloc(g->automata, new_cap * sizeof(*automata));
+  if (!automata) {
+    errno = ENOMEM;
+    return -1;
+  }
+  g->automata = automata;
+
+  uint32_t* slot_of = realloc(g->slot_of, new_cap * sizeof(*slot_of));
+  if (!slot_of) {
+    errno = ENOMEM;
+    return -1;
+  }
+  g->slot_of = slot_of;
+  g->cap = new_cap;
+
+  return 0;
+}
+
+// Returns the position of the member with handle `id`, or `SIZE_MAX`.
+static size_t resolve(const ma_group_t* g, ma_id_t id) {
+  uint32_t slot = id & UINT32_MAX;
+  uint32_t generation = id >> 32;
+
+  if (!g || !g->slot_of || slot >= g->num_slots || !g->slots[slot].live ||
+      g->slots[slot].generation != generation) {
+    return SIZE_MAX;
+  }
+
+  return g->slots[slot].position;
+}
+
+ma_group_t* ma_group_new(void) {
+  ma_group_t* g = calloc(1, sizeof(*g));
+  if (!g) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  g->owner = true;
+  g->alloc = default_allocator;
+  return g;
+}
+
+ma_id_t ma_group_add(ma_group_t* g, size_t n, size_t m, size_t s, transition_function_t t,
+                     output_function_t y, const bits_t* q) {
+  if (!g) {
+    errno = EINVAL;
+    return MA_ID_INVALID;
+  }
+
+  if (!g->owner || g->clone) {
+    errno = EPERM;
+    return MA_ID_INVALID;
+  }
+
+  if (g->trace || g->rewind || g->view || async_busy(g)) {
+    errno = EBUSY;
+    return MA_ID_INVALID;
+  }
+
+  if (g->num >= NO_SLOT) {
+    errno = EOVERFLOW;
+    return MA_ID_INVALID;
+  }
+
+  // The positions of the members are about to change.
+  if (ensure_slots(g) == -1 || reserve_member(g) == -1 || thaw_schedule(g) == -1) {
+    return MA_ID_INVALID;
+  }
+
+  uint32_t slot = g->free_slot;
+  if (slot == NO_SLOT && reserve_slots(g, g->num_slots + 1) == -1) {
+    return MA_ID_INVALID;
+  }
+
+  moore_t* a = create_automaton(n, m, s, t, y, q, &g->alloc, g->padded);
+  if (!a) {
+    return MA_ID_INVALID;
+  }
+
+  if (slot == NO_SLOT) {
+    slot = g->num_slots++;
+    g->slots[slot].generation = 1;
+  } else {
+    g->free_slot = g->slots[slot].position;
+  }
+
+  g->slots[slot].position = g->num;
+  g->slots[slot].live = true;
+  g->slot_of[g->num] = slot;
+  g->automata[g->num++] = a;
+  drop_schedule(g);
+  drop_ticks(g);
+
+  return make_id(slot, g->slots[slot].generation);
+}
+
+int ma_group_remove(ma_group_t* g, ma_id_t id) {
+  size_t pos = resolve(g, id);
+  if (pos == SIZE_MAX) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (!g->owner || g->clone) {
+    errno = EPERM;
+    return -1;
+  }
+
+  if (g->trace || g->rewind || g->view || async_busy(g)) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  if (thaw_schedule(g) == -1) {
+    return -1;
+  }
+
+  remove_member(g, pos);
+  return 0;
+}
+
+void remove_member(ma_group_t* g, size_t pos) {
+  if (g->owner) {
+    ma_delete(g->automata[pos]);
+  }
+
+  // Move the last member into the freed position.
+  g->automata[pos] = g->automata[--g->num];
+
+  if (g->slot_of) {
+    uint32_t slot = g->slot_of[pos];
+    uint32_t last = g->slot_of[g->num];
+    g->slot_of[pos] = last;
+    g->slots[last].position = pos;
+
+    g->slots[slot].live = false;
+    if (++g->slots[slot].generation == 0) {
+      g->slots[slot].generation = 1;
+    }
+    g->slots[slot].position = g->free_slot;
+    g->free_slot = slot;
+  }
+
+  drop_schedule(g);
+  drop_ticks(g);
+}
+
+moore_t* ma_group_get(const ma_group_t* g, ma_id_t id) {
+  size_t pos = resolve(g, id);
+  if (pos == SIZE_MAX) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  return g->automata[pos];
+}
+
+int ma_group_compact(ma_group_t* g) {
+  if (!g) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (!g->owner) {
+    errno = EPERM;
+    return -1;
+  }
+
+  if (async_busy(g)) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  // The buffers of every member are laid out one after another in
+  // stepping order: state, next state, input, output.
+  size_t words = 0;
+  for (size_t i = 0; i < g->num; ++i) {
+    const moore_t* a = g->automata[i];
+    if (a->padded) {
+      words = (words + PAD_WORDS - 1) / PAD_WORDS * PAD_WORDS;
+    }
+    words += total_buffer_words(a);
+  }
+
+  // The slab starts at a multiple of `MA_BUFFER_ALIGN` bytes within the block.
+  size_t len = (words == 0 ? 1 : words) * sizeof(bits_t);
+  void* block = mem_zalloc(&g->alloc, len + MA_BUFFER_ALIGN);
+  if (!block) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  bits_t* slab = align_buffer(block);
+  bits_t* pos = slab;
+  for (size_t i = 0; i < g->num; ++i) {
+    moore_t* a = g->automata[i];
+    size_t sizes[4] = {buffer_words(a, a->state_bit_count), buffer_words(a, a->state_bit_count),
+                       buffer_words(a, a->num_input_bits), buffer_words(a, a->num_output_bits)};
+    bits_t** bufs[4] = {&a->state, &a->next_state, &a->input, &a->output};
+    bits_t* moved[4] = {NULL, NULL, NULL, NULL};
+
+    if (a->padded) {
+      pos = slab + (pos - slab + PAD_WORDS - 1) / PAD_WORDS * PAD_WORDS;
+    }
+    for (size_t j = 0; j < 4; ++j) {
+      if (sizes[j] == 0) {
+        continue;
+      }
+      memcpy(pos, *bufs[j], sizes[j] * sizeof(bits_t));
+      moved[j] = pos;
+      pos += sizes[j];
+    }
+
+    if (!a->slab_group) {
+      free_buffers(a);
+    }
+    for (size_t j = 0; j < 4; ++j) {
+      *bufs[j] = moved[j];
+    }
+    a->slab_group = g;
+  }
+
+  release_slab(g);
+  g->slab = slab;
+  g->slab_len = len;
+  g->slab_block = block;
+
+  return 0;
+}
+
+int ma_id_connect(ma_group_t* g, ma_id_t in_id, size_t in, ma_id_t out_id, size_t out, size_t num) {
+  size_t in_pos = resolve(g, in_id), out_pos = resolve(g, out_id);
+  if (in_pos == SIZE_MAX || out_pos == SIZE_MAX) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (async_busy(g)) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  ma_conn_spec_t spec = {
+      .a_in = g->automata[in_pos], .in = in, .a_out = g->automata[out_pos], .out = out, .num = num};
+  if (ma_connect_many(&spec, 1) == -1) {
+    return -1;
+  }
+  patch_schedule(g, &spec, 1);
+  return 0;
+}
+
+int ma_id_disconnect(ma_group_t* g, ma_id_t in_id, size_t in, size_t num) {
+  moore_t* a = ma_group_get(g, in_id);
+  if (a && async_busy(g)) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  if (ma_disconnect(a, in, num) == -1) {
+    return -1;
+  }
+  patch_schedule(g, &(ma_conn_spec_t) {.a_in = a, .in = in, .num = num}, 1);
+  return 0;
+}
+
+int ma_id_set_input(ma_group_t* g, ma_id_t id, const bits_t* input) {
+  moore_t* a = ma_group_get(g, id);
+  if (a && async_busy(g)) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  return ma_set_input(a, input);
+}
+
+int ma_id_set_state(ma_group_t* g, ma_id_t id, const bits_t* state) {
+  moore_t* a = ma_group_get(g, id);
+  if (a && async_busy(g)) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  return ma_set_state(a, state);
+}
+
+const bits_t* ma_id_get_output(const ma_group_t* g, ma_id_t id) {
+  return ma_get_output(ma_group_get(g, id));
+}
@@ -0,0 +1,553 @@
+#ifndef MA_INTERNAL_H
+#define MA_INTERNAL_H
+
+// Definitions shared between the translation units of the library.
+// This header is not part of the public interface.
+
+#include "ma.h"
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MA_STATS
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+#define BITS_PER_WORD (CHAR_BIT * sizeof(bits_t))
+
+typedef struct {
+  moore_t* automaton; // Pointer to the connected automaton.
+  size_t  bit_idx;    // Index of the bit within the connected automaton (either input or output).
+} connection_t;
+
+typedef struct {
+  connection_t args;
+  size_t output_connection_idx;
+} input_connection_t;
+
+typedef struct {
+  size_t sz;
+  size_t capacity;
+  connection_t* connections;  // Dynamic array of connections.
+} output_connection_t;
+
+// Transition table of an automaton with constant unconnected inputs, built
+// by `ma_group_optimize`.
+typedef struct {
+  size_t num_vars;
+  uint32_t* vars;            // The connected input bits in increasing order.
+  bits_t* next;              // Next state indexed by `state | vars << s`.
+} fold_table_t;
+
+// Cache of transitions, built by `ma_memo_enable`.
+typedef struct memo memo_t;
+
+struct moore {
+  ma_allocator_t alloc;      // Allocates the structure, its buffers and connection arrays.
+  size_t state_bit_count;    // Number of bits representing a state.
+  size_t num_input_bits;     // Number of bit signals for `input`.
+  size_t num_output_bits;    // Number of bit signals for `output`.
+
+  bits_t* next_state;        // Used for performance: avoids repeated allocations of next state bits.
+  bits_t* state;             // Current state.
+  bits_t* output;
+  bits_t* input;
+
+  input_connection_t* input_connections;     // Array of size `num_input_bits`, or NULL.
+  output_connection_t* output_connections;   // Array of size `num_output_bits`.
+
+  transition_function_t trans_func;
+  output_function_t out_func;
+
+  bool padded;               // Buffers laid out as described at `MA_BUFFER_ALIGN`.
+  void* buffer_block;        // Allocation holding the buffers of a padded automaton.
+  ma_group_t* slab_group;    // Group whose slab holds the buffers, or NULL.
+  bool cloned;               // A member of a clone, without connection arrays.
+  ma_group_t* frozen_group;  // Frozen group whose schedule replaces `input_connections`, or NULL.
+  size_t frozen_pos;         // Position in `frozen_group`.
+  uint64_t topology_version; // Incremented on every change of the input connections.
+  uint64_t clock_version;    // Incremented on every change of the clock.
+  uint64_t cycle;            // Number of steps taken.
+  ma_port_t* port;           // Input port, or `NULL`.
+  uint32_t period;           // In a group, steps on ticks `t` with `t % period == phase`.
+  uint32_t phase;
+
+  fold_table_t* table;       // Replaces `trans_func` while the free inputs are unchanged.
+  bool settle;               // No input is connected: freeze once a step changes nothing.
+  bool frozen;               // The state is a fixed point and steps are skipped.
+  memo_t* memo;              // Cache of transitions, or NULL.
+  ma_stim_t* stim;           // Stimulus generators on free inputs, or NULL.
+
+#ifdef MA_STATS
+  ma_automaton_stats_t stats;
+#endif
+};
+
+// A frozen input connection: the driving group member and its output bit.
+typedef struct {
+  uint32_t driver;           // `UNCONNECTED` if the input bit is not connected.
+  uint32_t driver_bit;
+} compact_conn_t;
+
+#define UNCONNECTED UINT32_MAX
+
+// An entry of the handle table of a group.
+typedef struct {
+  uint32_t generation;       // Incremented whenever the slot is freed.
+  uint32_t position;         // Index in `automata` if live, next free slot otherwise.
+  bool live;
+} slot_t;
+
+// Lookup table from member pointers to their positions in a group.
+typedef struct {
+  const moore_t* automaton;
+  size_t idx;
+} member_entry_t;
+
+// The members of a group sharing a clock: they step on ticks `t` with
+// `t % period == phase`.
+typedef struct {
+  uint32_t period;
+  uint32_t phase;
+  size_t first;              // Members are domain_members[first..first of the next domain).
+} clock_domain_t;
+
+typedef struct ma_worker ma_worker_t;
+
+// A set of automata stepped together.
+struct ma_group {
+  moore_t** automata;
+  size_t num;
+  size_t cap;                // Capacity of `automata` and `slot_of`.
+  uint64_t cycle;            // Number of steps taken by the group.
+  ma_trace_t* trace;         // Active trace recorder, or NULL.
+  ma_rewind_t* rewind;       // Active rewind history, or NULL.
+  ma_view_t* view;           // Published output view, or NULL.
+  bool owner;                // The group deletes its automata.
+  ma_allocator_t alloc;      // Allocates the members created by `ma_group_add` and the slab.
+  bool padded;               // `ma_group_add` creates padded members.
+
+  // Handle table, created on the first use of the handle API.
+  slot_t* slots;
+  uint32_t* slot_of;         // Slot of every member.
+  size_t num_slots;
+  size_t slots_cap;
+  uint32_t free_slot;        // Head of the list of free slots, `UINT32_MAX` if empty.
+
+  bits_t* slab;              // Buffers of the members after `ma_group_compact`.
+  size_t slab_len;           // Length of the slab in bytes.
+  void* slab_block;          // Allocation holding an unmapped slab, `MA_BUFFER_ALIGN` bytes longer.
+  bool slab_mapped;          // The slab is a private mapping of a memory file.
+  int slab_fd;               // The memory file, open while `slab_clean`.
+  bool slab_clean;           // The slab has not been written since it was mapped.
+
+  // Members of a group created by `ma_group_clone`, in group order. They
+  // gather their inputs through the shared schedule.
+  bool clone;
+  moore_t* clone_members;
+
+  // Gather schedule built by `ma_group_freeze`: one entry per input bit,
+  // member `i` owns entries [schedule_first[i], schedule_first[i + 1]).
+  compact_conn_t* schedule;
+  size_t* schedule_first;
+  uint64_t schedule_version; // Sum of the `topology_version` of the members it reflects.
+  bool compact;              // The members read their inputs from the schedule.
+  atomic_size_t* schedule_refs;  // Groups sharing the schedule, NULL if not shared.
+  member_entry_t* schedule_index;  // Positions of the members, for patching the schedule.
+
+  // Topology edits queued by `ma_group_queue_edits`, guarded by `edits_lock`.
+  ma_conn_spec_t* edits;
+  size_t num_edits;
+  size_t edits_cap;
+  atomic_bool edits_lock;
+  atomic_bool edits_pending; // Set while `edits` is not empty.
+
+  // Clock domains when clocks differ, followed by an entry whose `first` is
+  // `num`. `hyperperiod` is the least common multiple of the periods, 1 if
+  // every member steps on every tick and 0 if the domains must be rebuilt.
+  clock_domain_t* domains;
+  size_t num_domains;
+  moore_t** domain_members;
+  size_t hyperperiod;
+  uint64_t ticks_version;    // Sum of the `clock_version` of the members they reflect.
+
+  // Worker thread of `ma_step_async`, or NULL, and the number of requests
+  // it has not finished.
+  ma_worker_t* worker;
+  atomic_size_t async_pending;
+
+#ifdef MA_STATS
+  uint64_t steps;
+  uint64_t step_ns_total;
+  uint64_t step_ns_hist[MA_STATS_BUCKETS];
+#endif
+};
+
+// Returns the output bit driving input `j` of `a`, with a NULL automaton if
+// the input is not connected. Members of a clone or of a compact frozen group
+// read the frozen schedule.
+static inline connection_t input_source(const moore_t* a, size_t j) {
+  if (a->input_connections) {
+    return a->input_connections[j].args;
+  }
+
+  const ma_group_t* g = a->cloned ? a->slab_group : a->frozen_group;
+  size_t pos = a->cloned ? (size_t) (a - g->clone_members) : a->frozen_pos;
+  const compact_conn_t* c = &g->schedule[g->schedule_first[pos] + j];
+  return (connection_t) {
+      .automaton = c->driver == UNCONNECTED ? NULL : g->automata[c->driver],
+      .bit_idx = c->driver_bit};
+}
+
+// The allocator used outside of groups, set by `ma_set_allocator`.
+extern ma_allocator_t default_allocator;
+
+static inline void* mem_alloc(const ma_allocator_t* alloc, size_t size) {
+  return alloc->alloc(size, alloc->ctx);
+}
+
+static inline void* mem_zalloc(const ma_allocator_t* alloc, size_t size) {
+  void* p = alloc->alloc(size, alloc->ctx);
+  if (p) {
+    memset(p, 0, size);
+  }
+  return p;
+}
+
+// Resizes `p`, which may be NULL, from `old_size` to `size` bytes.
+static inline void* mem_realloc(const ma_allocator_t* alloc, void* p, size_t old_size,
+                                size_t size) {
+  return p ? alloc->realloc(p, old_size, size, alloc->ctx) : alloc->alloc(size, alloc->ctx);
+}
+
+static inline void mem_free(const ma_allocator_t* alloc, void* p, size_t size) {
+  if (p) {
+    alloc->free(p, size, alloc->ctx);
+  }
+}
+
+// `ma_create_full` with the structure and buffers allocated by `alloc`.
+moore_t* create_automaton(size_t n, size_t m, size_t s, transition_function_t t,
+                          output_function_t y, const bits_t* q, const ma_allocator_t* alloc,
+                          bool padded);
+
+// Allocates the zeroed state, input and output buffers of `a`. The pointers
+// of the buffers that could not be allocated are NULL.
+void alloc_buffers(moore_t* a);
+
+// Frees the state, input and output buffers of an automaton outside a slab.
+void free_buffers(moore_t* a);
+
+// The output function of automata created with `ma_create_simple`.
+void id_output(bits_t* output, const bits_t* state, size_t m, size_t s);
+
+// Copies connected outputs into the inputs of `at`.
+void gather_inputs(moore_t* const at[], size_t num);
+
+// Computes the next states and outputs of `at` from their inputs.
+void transition_automata(moore_t* const at[], size_t num);
+
+// Applies the pending vectors of the input ports of `at`, then the vectors
+// of their stimulus generators. Called at the start of every step, before
+// the inputs are gathered.
+void drain_ports(moore_t* const at[], size_t num);
+
+// Writes the next vector of every stimulus generator of `a` into its inputs.
+void apply_stimuli(moore_t* a);
+
+// Performs one synchronous step of `at` without validating the arguments.
+void step_automata(moore_t* const at[], size_t num);
+
+// Copies connected outputs into the inputs of the members using the frozen schedule.
+void gather_frozen(ma_group_t* g);
+
+// Releases the frozen schedule of the group. The group must not be compact.
+void drop_schedule(ma_group_t* g);
+
+// Returns the sum of the `topology_version` of the members of `g`.
+uint64_t topology_version(const ma_group_t* g);
+
+// Returns whether the frozen schedule of `g` reflects the current topology.
+static inline bool schedule_current(const ma_group_t* g) {
+  return g->schedule && !g->clone && g->schedule_version == topology_version(g);
+}
+
+// Gives the members of a compact group their input connection records back,
+// leaving the schedule in place.
+int thaw_schedule(ma_group_t* g);
+
+// Removes `a` from the fan-out arrays of the outputs driving its inputs.
+void detach_inputs(moore_t* a);
+
+// Returns whether `spec` is a valid connection or, without `a_out`, a valid
+// disconnection of inputs [`in`, `in + num`) of `a_in`.
+bool is_valid_edit(const ma_conn_spec_t* spec);
+
+// Applies connections and disconnections in order, all at once or not at
+// all. The specs must be valid.
+int apply_edits(const ma_conn_spec_t* specs, size_t k);
+
+// Rewrites the entries of the frozen schedule of `g` for the inputs changed
+// by `specs`, or drops the schedule if they cannot be encoded. A schedule
+// that was stale before stays stale.
+void patch_schedule(ma_group_t* g, const ma_conn_spec_t* specs, size_t k);
+
+// Applies the edits queued on `g`. Called by the stepping thread.
+int apply_queued_edits(ma_group_t* g);
+
+// Frees or unmaps the slab of the group.
+void release_slab(ma_group_t* g);
+
+// Records that the buffers in the slab of `g` are about to be written, so
+// that the next clone maps a fresh copy of them.
+void slab_written(ma_group_t* g);
+
+// Builds the lookup table of the members of `g`. Returns NULL if allocation fails.
+member_entry_t* build_member_index(const ma_group_t* g);
+
+// Returns the position of `a` in the group, or `SIZE_MAX` if it is not a member.
+size_t find_member(const member_entry_t* index, size_t num, const moore_t* a);
+
+// Drops the frozen schedule of `g` if the topology changed and builds the
+// clock domains if the clocks or members changed. Must succeed before
+// `group_step_once` is called.
+int group_prepare(ma_group_t* g);
+
+// Releases the clock domains of `g`.
+void drop_ticks(ma_group_t* g);
+
+// Performs one step of the group.
+void group_step_once(ma_group_t* g);
+
+// Returns whether requests of `ma_step_async` on `g` are unfinished. The
+// entry points that step or change the group fail with `EBUSY` until then.
+static inline bool async_busy(const ma_group_t* g) {
+  return atomic_load_explicit(&g->async_pending, memory_order_acquire) != 0;
+}
+
+// Runs the pending requests of `ma_step_async` and ends the worker thread.
+void stop_worker(ma_worker_t* w);
+
+// Removes the member at `pos`, deleting it if the group owns it. The group
+// must not be compact.
+void remove_member(ma_group_t* g, size_t pos);
+
+// Computes the next state of `a` from its transition table.
+void table_transition(moore_t* a);
+
+// Looks the current state and input of `a` up in its cache. On a hit the
+// cached next state is copied into `next_state` and the cached output is
+// returned, otherwise NULL.
+const bits_t* memo_lookup(moore_t* a);
+
+// Caches the current state and output of `a` as the result of the
+// transition whose lookup missed last.
+void memo_store(moore_t* a);
+
+void memo_free(memo_t* m);
+
+// Discards what `ma_group_optimize` derived from the current inputs of `a`.
+// Called whenever the inputs are changed from outside the step.
+void unfold(moore_t* a);
+
+// Records the traced words that changed in the step that led to `cycle`.
+void trace_record(ma_trace_t* t, uint64_t cycle);
+
+// Appends the state of the group after a step to the rewind history.
+void rewind_record(ma_rewind_t* r);
+
+// Publishes the current cycle and outputs to the readers of `v`.
+void view_publish(ma_view_t* v);
+
+#ifdef MA_STATS
+// Returns a timestamp in processor cycles where available, nanoseconds otherwise.
+static inline uint64_t stats_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+#endif
+
+// Converts the `s` bits to `ceil(s/word_len)` where 
+// the `word_len` is given by number of bits in `bits_t`.
+static inline size_t bits_to_words(size_t s) {
+  return (s + BITS_PER_WORD - 1) / BITS_PER_WORD;
+}
+
+// Retrieves the `n`-th bit from `bits`. Indexing is 0-based.
+static inline int get_bit(const bits_t* bits, size_t n) {
+  return (bits[n / BITS_PER_WORD] >> (n % BITS_PER_WORD)) & ((bits_t) 1);
+}
+
+// Sets the `n`-th bit of `bits`. Indexing is 0-based.
+static inline void set_bit(bits_t* bits, size_t n) {
+  bits[n / BITS_PER_WORD] |= ((bits_t) 1) << (n % BITS_PER_WORD);
+}
+
+// Unsets the `n`-th bit of `bits`. Indexing is 0-based.
+static inline void unset_bit(bits_t* bits, size_t n) {
+  bits[n / BITS_PER_WORD] &= ~(((bits_t) 1) << (n % BITS_PER_WORD));
+}
+
+// Sets n-th bit of `bits` to `bit`. Indexing is 0-based.
+static inline void copy_bit(bits_t* bits, int bit, size_t n) {
+  if (bit) {
+    set_bit(bits, n);
+  } else {
+    unset_bit(bits, n);
+  }
+}
+
+// Reads `len` (at most `BITS_PER_WORD`) bits of `src` starting at bit `off`.
+static inline bits_t read_bits(const bits_t* src, size_t off, size_t len) {
+  size_t idx = off / BITS_PER_WORD;
+  size_t shift = off % BITS_PER_WORD;
+  bits_t val = src[idx] >> shift;
+
+  if (shift != 0 && shift + len > BITS_PER_WORD) {
+    val |= src[idx + 1] << (BITS_PER_WORD - shift);
+  }
+
+  return len == BITS_PER_WORD ? val : val & ((((bits_t) 1) << len) - 1);
+}
+
+// Writes the low `len` (at most `BITS_PER_WORD`) bits of `val` into `dst`
+// starting at bit `off`. Other bits of `dst` are preserved.
+static inline void write_bits(bits_t* dst, size_t off, bits_t val, size_t len) {
+  size_t idx = off / BITS_PER_WORD;
+  size_t shift = off % BITS_PER_WORD;
+  bits_t mask = len == BITS_PER_WORD ? ~((bits_t) 0) : (((bits_t) 1) << len) - 1;
+
+  dst[idx] = (dst[idx] & ~(mask << shift)) | ((val & mask) << shift);
+
+  if (shift != 0 && shift + len > BITS_PER_WORD) {
+    size_t rest = BITS_PER_WORD - shift;
+    dst[idx + 1] = (dst[idx + 1] & ~(mask >> rest)) | ((val & mask) >> rest);
+  }
+}
+
+// Copies `len` bits from `src` at bit `src_off` to `dst` at bit `dst_off`.
+static inline void copy_bits(bits_t* dst, size_t dst_off,
+                             const bits_t* src, size_t src_off, size_t len) {
+  while (len > 0) {
+    size_t chunk = len < BITS_PER_WORD ? len : BITS_PER_WORD;
+    write_bits(dst, dst_off, read_bits(src, src_off, chunk), chunk);
+    dst_off += chunk;
+    src_off += chunk;
+    len -= chunk;
+  }
+}
+
+#define PAD_WORDS (MA_BUFFER_PAD / sizeof(bits_t))
+
+// Returns the number of words of a buffer of `bits` bits of `a`.
+static inline size_t buffer_words(const moore_t* a, size_t bits) {
+  size_t words = bits_to_words(bits);
+  return a->padded ? (words + PAD_WORDS - 1) / PAD_WORDS * PAD_WORDS : words;
+}
+
+// Returns the number of words of all the buffers of `a`.
+static inline size_t total_buffer_words(const moore_t* a) {
+  return 2 * buffer_words(a, a->state_bit_count) + buffer_words(a, a->num_input_bits) +
+         buffer_words(a, a->num_output_bits);
+}
+
+// Rounds `p` up to a multiple of `MA_BUFFER_ALIGN`.
+static inline bits_t* align_buffer(void* p) {
+  uintptr_t addr = (uintptr_t) p;
+  return (bits_t*) ((addr + MA_BUFFER_ALIGN - 1) & ~(uintptr_t) (MA_BUFFER_ALIGN - 1));
+}
+
+// Allocates `words` zeroed words aligned like the buffers of padded automata,
+// to be released with `free`. Returns NULL if out of memory.
+static inline bits_t* alloc_scratch(size_t words) {
+  size_t bytes = (words * sizeof(bits_t) + MA_BUFFER_ALIGN - 1) / MA_BUFFER_ALIGN * MA_BUFFER_ALIGN;
+  bits_t* p = aligned_alloc(MA_BUFFER_ALIGN, bytes == 0 ? MA_BUFFER_ALIGN : bytes);
+  if (p) {
+    memset(p, 0, bytes);
+  }
+  return p;
+}
+
+// Zeroes the bits of the `words` words of `buf` past the first `bits`.
+static inline void clear_pad(bits_t* buf, size_t bits, size_t words) {
+  size_t used = bits_to_words(bits);
+  if (bits % BITS_PER_WORD != 0) {
+    buf[used - 1] &= ((bits_t) 1 << (bits % BITS_PER_WORD)) - 1;
+  }
+  memset(buf + used, 0, (words - used) * sizeof(bits_t));
+}
+
+// Zeroes the pad of the state and output buffers of a padded automaton.
+static inline void clear_state_pad(moore_t* a) {
+  if (a->padded) {
+    clear_pad(a->state, a->state_bit_count, buffer_words(a, a->state_bit_count));
+    clear_pad(a->output, a->num_output_bits, buffer_words(a, a->num_output_bits));
+  }
+}
+
+// The xoshiro256** generator, seeded through splitmix64.
+typedef struct {
+  uint64_t s[4];
+} rng_t;
+
+static inline uint64_t splitmix64(uint64_t* x) {
+  uint64_t z = (*x += 0x9e3779b97f4a7c15u);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+  return z ^ (z >> 31);
+}
+
+static inline void rng_seed(rng_t* r, uint64_t seed) {
+  for (size_t i = 0; i < 4; ++i) {
+    r->s[i] = splitmix64(&seed);
+  }
+}
+
+static inline uint64_t rotl64(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_next(rng_t* r) {
+  uint64_t* s = r->s;
+  uint64_t result = rotl64(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl64(s[3], 45);
+  return result;
+}
+
+// Advances `r` by 2^128 outputs, to the start of the next independent stream.
+static inline void rng_jump(rng_t* r) {
+  static const uint64_t jump[4] = {0x180ec6d33cfd0abau, 0xd5a61266f0c9392cu,
+                                   0xa9582618e03fc9aau, 0x39abdc4529b1661cu};
+  uint64_t s[4] = {0, 0, 0, 0};
+  for (size_t i = 0; i < 4; ++i) {
+    for (int b = 0; b < 64; ++b) {
+      if (jump[i] & (uint64_t) 1 << b) {
+        for (size_t k = 0; k < 4; ++k) {
+          s[k] ^= r->s[k];
+        }
+      }
+      rng_next(r);
+    }
+  }
+  memcpy(r->s, s, sizeof(s));
+}
+
+#endif
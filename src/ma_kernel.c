@@ -0,0 +1,377 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Largest number of input and state bits of a synthesised automaton.
+#define MAX_KERNEL_VARS 16
+
+// Words of a plane evaluated together, 512 lanes.
+#define KERNEL_BLOCK 8
+
+// A straight-line program computing boolean functions in algebraic normal
+// form. Node `0` is the constant one, node `i > 0` is the product of node
+// `ops[i].parent` and variable `ops[i].var`. Function `f` is the exclusive or
+// of nodes terms[first[f]..first[f + 1]).
+typedef struct {
+  size_t num_nodes;
+  struct {
+    uint32_t parent;
+    uint32_t var;
+  }* ops;
+  size_t num_funcs;
+  size_t* first;
+  uint32_t* terms;
+} program_t;
+
+// The transition program has the input bits followed by the state bits as
+// variables, the output program the state bits.
+struct ma_kernel {
+  size_t n, m, s;
+  program_t trans;
+  program_t out;
+};
+
+static inline uint32_t high_bit(size_t mask) {
+  return 63 - __builtin_clzll(mask);
+}
+
+static void free_program(program_t* p) {
+  free(p->ops);
+  free(p->first);
+  free(p->terms);
+}
+
+// Computes the algebraic normal form of the truth table `f` over `vars`
+// variables in place (the Möbius transform).
+static void moebius(uint8_t* f, size_t vars) {
+  for (size_t i = 0; i < vars; ++i) {
+    size_t bit = (size_t) 1 << i;
+    for (size_t x = 0; x < ((size_t) 1 << vars); ++x) {
+      if (x & bit) {
+        f[x] ^= f[x ^ bit];
+      }
+    }
+  }
+}
+
+// Builds a program from `num_funcs` truth tables over `vars` variables.
+// Bit `f` of `table[x * stride + f / 64]` is function `f` at assignment `x`.
+static int build_program(program_t* p, const bits_t* table, size_t stride, size_t num_funcs,
+                         size_t vars) {
+  size_t size = (size_t) 1 << vars;
+  uint8_t* anf = malloc(num_funcs * size);
+  uint32_t* node_of = calloc(size, sizeof(*node_of));
+  int ret = -1;
+
+  memset(p, 0, sizeof(*p));
+  p->num_funcs = num_funcs;
+  p->first = calloc(num_funcs + 1, sizeof(*p->first));
+  if (!anf || !node_of || !p->first) {
+    goto exit;
+  }
+
+  for (size_t f = 0; f < num_funcs; ++f) {
+    uint8_t* coef = anf + f * size;
+    for (size_t x = 0; x < size; ++x) {
+      coef[x] = get_bit(table + x * stride, f);
+    }
+    moebius(coef, vars);
+    for (size_t x = 0; x < size; ++x) {
+      node_of[x] |= coef[x];
+      p->first[f + 1] += coef[x];
+    }
+    p->first[f + 1] += p->first[f];
+  }
+
+  // A product is computed from the product without its highest variable.
+  node_of[0] = 1;
+  for (size_t x = size; x-- > 1;) {
+    if (node_of[x]) {
+      node_of[x & ~((size_t) 1 << high_bit(x))] = 1;
+    }
+  }
+  for (size_t x = 0; x < size; ++x) {
+    p->num_nodes += node_of[x];
+  }
+
+  p->ops = malloc(p->num_nodes * sizeof(*p->ops));
+  p->terms = malloc((p->first[num_funcs] + 1) * sizeof(*p->terms));
+  if (!p->ops || !p->terms) {
+    goto exit;
+  }
+
+  // Increasing masks place every parent before its products.
+  p->ops[0].parent = 0;
+  p->ops[0].var = 0;
+  node_of[0] = 0;
+  for (size_t x = 1, i = 1; x < size; ++x) {
+    if (node_of[x]) {
+      uint32_t var = high_bit(x);
+      p->ops[i].parent = node_of[x & ~((size_t) 1 << var)];
+      p->ops[i].var = var;
+      node_of[x] = i++;
+    }
+  }
+
+  for (size_t f = 0, k = 0; f < num_funcs; ++f) {
+    const uint8_t* coef = anf + f * size;
+    for (size_t x = 0; x < size; ++x) {
+      if (coef[x]) {
+        p->terms[k++] = node_of[x];
+      }
+    }
+  }
+
+  ret = 0;
+
+exit:
+  if (ret == -1) {
+    free_program(p);
+    memset(p, 0, sizeof(*p));
+    errno = ENOMEM;
+  }
+  free(anf);
+  free(node_of);
+  return ret;
+}
+
+// Enumerates `t` and `y` and synthesises their programs.
+static int synthesize(ma_kernel_t* k, transition_function_t t, output_function_t y) {
+  size_t vars = k->n + k->s, out_words = bits_to_words(k->m);
+  bits_t* next = malloc(((size_t) 1 << vars) * sizeof(*next));
+  bits_t* out = malloc(((size_t) 1 << k->s) * out_words * sizeof(*out));
+  int ret = -1;
+
+  if (!next || !out) {
+    errno = ENOMEM;
+    goto exit;
+  }
+
+  bits_t input_mask = ((bits_t) 1 << k->n) - 1, state_mask = ((bits_t) 1 << k->s) - 1;
+  for (size_t x = 0; x < ((size_t) 1 << vars); ++x) {
+    bits_t input = x & input_mask, state = x >> k->n;
+    t(&next[x], &input, &state, k->n, k->s);
+    next[x] &= state_mask;
+  }
+  for (size_t x = 0; x < ((size_t) 1 << k->s); ++x) {
+    bits_t state = x;
+    memset(out + x * out_words, 0, out_words * sizeof(*out));
+    y(out + x * out_words, &state, k->m, k->s);
+  }
+
+  if (build_program(&k->trans, next, 1, k->s, vars) == -1 ||
+      build_program(&k->out, out, out_words, k->m, k->s) == -1) {
+    goto exit;
+  }
+
+  ret = 0;
+
+exit:
+  free(next);
+  free(out);
+  return ret;
+}
+
+ma_kernel_t* ma_kernel_synthesize(size_t n, size_t m, size_t s, transition_function_t t,
+                                  output_function_t y) {
+  if (m == 0 || s == 0 || !t || !y) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (n + s > MAX_KERNEL_VARS) {
+    errno = E2BIG;
+    return NULL;
+  }
+
+  ma_kernel_t* k = calloc(1, sizeof(*k));
+  if (!k) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  k->n = n;
+  k->m = m;
+  k->s = s;
+  if (synthesize(k, t, y) == -1) {
+    ma_kernel_delete(k);
+    return NULL;
+  }
+
+  return k;
+}
+
+void ma_kernel_delete(ma_kernel_t* k) {
+  if (!k) {
+    return;
+  }
+
+  free_program(&k->trans);
+  free_program(&k->out);
+  free(k);
+}
+
+size_t ma_kernel_terms(const ma_kernel_t* k) {
+  if (!k) {
+    errno = EINVAL;
+    return SIZE_MAX;
+  }
+
+  return k->trans.first[k->trans.num_funcs] + k->out.first[k->out.num_funcs];
+}
+
+// Evaluates `p` on `bw` words of every variable and writes function `f` to
+// `dst[f]`. `val` holds `p->num_nodes` blocks.
+static void eval_program(const program_t* p, const bits_t* const var[], bits_t* const dst[],
+                         size_t bw, bits_t* val) {
+  for (size_t w = 0; w < KERNEL_BLOCK; ++w) {
+    val[w] = ~(bits_t) 0;
+  }
+  for (size_t i = 1; i < p->num_nodes; ++i) {
+    const bits_t* a = val + p->ops[i].parent * KERNEL_BLOCK;
+    const bits_t* b = var[p->ops[i].var];
+    bits_t* v = val + i * KERNEL_BLOCK;
+    for (size_t w = 0; w < bw; ++w) {
+      v[w] = a[w] & b[w];
+    }
+  }
+
+  for (size_t f = 0; f < p->num_funcs; ++f) {
+    bits_t acc[KERNEL_BLOCK] = {0};
+    for (size_t j = p->first[f]; j < p->first[f + 1]; ++j) {
+      const bits_t* v = val + p->terms[j] * KERNEL_BLOCK;
+      for (size_t w = 0; w < bw; ++w) {
+        acc[w] ^= v[w];
+      }
+    }
+    memcpy(dst[f], acc, bw * sizeof(*acc));
+  }
+}
+
+int ma_kernel_step(const ma_kernel_t* k, bits_t* state, const bits_t* input, bits_t* output,
+                   size_t words) {
+  if (!k || !state || (k->n != 0 && !input) || !output) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  size_t nodes = k->trans.num_nodes > k->out.num_nodes ? k->trans.num_nodes : k->out.num_nodes;
+  bits_t* val = malloc((nodes + k->s) * KERNEL_BLOCK * sizeof(*val));
+  const bits_t** var = malloc((k->n + k->s) * sizeof(*var));
+  bits_t** dst = malloc((k->s > k->m ? k->s : k->m) * sizeof(*dst));
+  if (!val || !var || !dst) {
+    free(val);
+    free(var);
+    free(dst);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  bits_t* next = val + nodes * KERNEL_BLOCK;
+  for (size_t base = 0; base < words; base += KERNEL_BLOCK) {
+    size_t bw = words - base < KERNEL_BLOCK ? words - base : KERNEL_BLOCK;
+
+    for (size_t i = 0; i < k->n; ++i) {
+      var[i] = input + i * words + base;
+    }
+    for (size_t j = 0; j < k->s; ++j) {
+      var[k->n + j] = state + j * words + base;
+      dst[j] = next + j * KERNEL_BLOCK;
+    }
+    eval_program(&k->trans, var, dst, bw, val);
+
+    // The outputs are those of the new state.
+    for (size_t j = 0; j < k->s; ++j) {
+      memcpy(state + j * words + base, next + j * KERNEL_BLOCK, bw * sizeof(*next));
+      var[j] = state + j * words + base;
+    }
+    for (size_t j = 0; j < k->m; ++j) {
+      dst[j] = output + j * words + base;
+    }
+    eval_program(&k->out, var, dst, bw, val);
+  }
+
+  free(val);
+  free(var);
+  free(dst);
+  return 0;
+}
+
+// Writes the nodes of `p` as variables `<prefix><i>` and returns -1 on error.
+static int emit_nodes(const program_t* p, FILE* out, char prefix, char var_prefix) {
+  for (size_t i = 1; i < p->num_nodes; ++i) {
+    int r;
+    if (p->ops[i].parent == 0) {
+      r = fprintf(out, "    uint64_t %c%zu = %c%u;\n", prefix, i, var_prefix, p->ops[i].var);
+    } else {
+      r = fprintf(out, "    uint64_t %c%zu = %c%u & %c%u;\n", prefix, i, prefix, p->ops[i].parent,
+                  var_prefix, p->ops[i].var);
+    }
+    if (r < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// Writes function `f` of `p` as an expression over the nodes.
+static int emit_sum(const program_t* p, FILE* out, char prefix, size_t f) {
+  if (p->first[f] == p->first[f + 1]) {
+    return fprintf(out, "0") < 0 ? -1 : 0;
+  }
+  for (size_t j = p->first[f]; j < p->first[f + 1]; ++j) {
+    int r = p->terms[j] == 0 ? fprintf(out, "%s~(uint64_t) 0", j == p->first[f] ? "" : " ^ ")
+                             : fprintf(out, "%s%c%u", j == p->first[f] ? "" : " ^ ", prefix,
+                                       p->terms[j]);
+    if (r < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int ma_kernel_emit_c(const ma_kernel_t* k, FILE* out, const char* name) {
+  if (!k || !out || !name || !*name) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  bool ok = fprintf(out, "void %s(uint64_t* state, const uint64_t* input, uint64_t* output, "
+                         "size_t words) {\n  for (size_t w = 0; w < words; ++w) {\n", name) >= 0;
+  for (size_t i = 0; i < k->n && ok; ++i) {
+    ok = fprintf(out, "    uint64_t i%zu = input[%zu * words + w];\n", i, i) >= 0;
+  }
+  for (size_t j = 0; j < k->s && ok; ++j) {
+    ok = fprintf(out, "    uint64_t s%zu = state[%zu * words + w];\n", j, j) >= 0;
+  }
+
+  // Variables of the transition program are named after their bits.
+  for (size_t i = 1; i < k->trans.num_nodes && ok; ++i) {
+    uint32_t var = k->trans.ops[i].var;
+    char v = var < k->n ? 'i' : 's';
+    size_t bit = var < k->n ? var : var - k->n;
+    ok = (k->trans.ops[i].parent == 0
+              ? fprintf(out, "    uint64_t t%zu = %c%zu;\n", i, v, bit)
+              : fprintf(out, "    uint64_t t%zu = t%u & %c%zu;\n", i, k->trans.ops[i].parent, v,
+                        bit)) >= 0;
+  }
+  for (size_t j = 0; j < k->s && ok; ++j) {
+    ok = fprintf(out, "    uint64_t n%zu = ", j) >= 0 && emit_sum(&k->trans, out, 't', j) == 0 &&
+         fprintf(out, ";\n    state[%zu * words + w] = n%zu;\n", j, j) >= 0;
+  }
+
+  ok = ok && emit_nodes(&k->out, out, 'u', 'n') == 0;
+  for (size_t j = 0; j < k->m && ok; ++j) {
+    ok = fprintf(out, "    output[%zu * words + w] = ", j) >= 0 &&
+         emit_sum(&k->out, out, 'u', j) == 0 && fprintf(out, ";\n") >= 0;
+  }
+  ok = ok && fprintf(out, "  }\n}\n") >= 0;
+
+  if (!ok) {
+    errno = EIO;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,181 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_SETS 1024
+#define DEFAULT_WAYS 4
+#define MAX_WAYS 64
+
+// A set-associative cache of transitions. An entry is the hash of its key
+// (`0` if the entry is empty), the key, the next state and the output, all
+// in whole words. A full set replaces its entries in turn.
+struct memo {
+  size_t sets;               // A power of two.
+  size_t ways;
+  size_t key_words;          // State words followed by input words.
+  size_t state_words;
+  size_t output_words;
+  size_t entry_words;
+  bits_t* entries;
+  uint8_t* victim;           // Next entry replaced in every set.
+  bits_t* key;               // Key of the last lookup.
+  uint64_t hash;
+  ma_memo_stats_t stats;
+};
+
+static bits_t* entry(const memo_t* m, size_t set, size_t way) {
+  return m->entries + (set * m->ways + way) * m->entry_words;
+}
+
+// Packs the valid bits of the state and the input of `a` into the key.
+static void make_key(memo_t* m, const moore_t* a) {
+  size_t s = bits_to_words(a->state_bit_count);
+  memcpy(m->key, a->state, s * sizeof(bits_t));
+  if (a->num_input_bits != 0) {
+    memcpy(m->key + s, a->input, bits_to_words(a->num_input_bits) * sizeof(bits_t));
+  }
+
+  size_t tails[2] = {a->state_bit_count % BITS_PER_WORD, a->num_input_bits % BITS_PER_WORD};
+  size_t last[2] = {s - 1, m->key_words - 1};
+  for (size_t i = 0; i < 2; ++i) {
+    if (tails[i] != 0) {
+      m->key[last[i]] &= ((bits_t) 1 << tails[i]) - 1;
+    }
+  }
+}
+
+static uint64_t hash_key(const bits_t* key, size_t words) {
+  uint64_t h = words;
+  for (size_t i = 0; i < words; ++i) {
+    h = (h ^ key[i]) * 0x9e3779b97f4a7c15u;
+    h ^= h >> 29;
+  }
+  // Zero marks an empty entry.
+  return h | 1;
+}
+
+const bits_t* memo_lookup(moore_t* a) {
+  memo_t* m = a->memo;
+  make_key(m, a);
+  m->hash = hash_key(m->key, m->key_words);
+
+  size_t set = m->hash & (m->sets - 1);
+  for (size_t w = 0; w < m->ways; ++w) {
+    const bits_t* e = entry(m, set, w);
+    if (e[0] == m->hash && memcmp(e + 1, m->key, m->key_words * sizeof(bits_t)) == 0) {
+      ++m->stats.hits;
+      const bits_t* next = e + 1 + m->key_words;
+      memcpy(a->next_state, next, m->state_words * sizeof(bits_t));
+      return next + m->state_words;
+    }
+  }
+
+  ++m->stats.misses;
+  return NULL;
+}
+
+void memo_store(moore_t* a) {
+  memo_t* m = a->memo;
+  size_t set = m->hash & (m->sets - 1);
+  bits_t* e = entry(m, set, m->victim[set]);
+  m->victim[set] = (m->victim[set] + 1) % m->ways;
+
+  m->stats.evictions += e[0] != 0;
+  e[0] = m->hash;
+  memcpy(e + 1, m->key, m->key_words * sizeof(bits_t));
+  memcpy(e + 1 + m->key_words, a->state, m->state_words * sizeof(bits_t));
+  memcpy(e + 1 + m->key_words + m->state_words, a->output, m->output_words * sizeof(bits_t));
+}
+
+void memo_free(memo_t* m) {
+  if (!m) {
+    return;
+  }
+
+  free(m->entries);
+  free(m->victim);
+  free(m->key);
+  free(m);
+}
+
+int ma_memo_enable(moore_t* a, size_t sets, size_t ways) {
+  if (!a || ways > MAX_WAYS) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (a->cloned) {
+    errno = EPERM;
+    return -1;
+  }
+
+  sets = sets == 0 ? DEFAULT_SETS : sets;
+  ways = ways == 0 ? DEFAULT_WAYS : ways;
+  size_t rounded = 1;
+  while (rounded < sets && rounded <= SIZE_MAX / 2) {
+    rounded *= 2;
+  }
+  if (rounded < sets) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  memo_t* m = calloc(1, sizeof(*m));
+  if (!m) {
+    errno = ENOMEM;
+    return -1;
+  }
+  m->sets = rounded;
+  m->ways = ways;
+  m->state_words = bits_to_words(a->state_bit_count);
+  m->key_words = m->state_words + bits_to_words(a->num_input_bits);
+  m->output_words = bits_to_words(a->num_output_bits);
+  m->entry_words = 1 + m->key_words + m->state_words + m->output_words;
+
+  size_t entries = m->sets * m->ways;
+  if (entries / m->ways != m->sets || entries > SIZE_MAX / sizeof(bits_t) / m->entry_words) {
+    free(m);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  m->entries = calloc(entries * m->entry_words, sizeof(bits_t));
+  m->victim = calloc(m->sets, sizeof(*m->victim));
+  m->key = malloc(m->key_words * sizeof(bits_t));
+  if (!m->entries || !m->victim || !m->key) {
+    memo_free(m);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  memo_free(a->memo);
+  a->memo = m;
+  return 0;
+}
+
+int ma_memo_disable(moore_t* a) {
+  if (!a) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  memo_free(a->memo);
+  a->memo = NULL;
+  return 0;
+}
+
+int ma_memo_stats(const moore_t* a, ma_memo_stats_t* stats) {
+  if (!a || !stats) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (!a->memo) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  *stats = a->memo->stats;
+  return 0;
+}
@@ -0,0 +1,299 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void add_usage(const moore_t* a, ma_memory_usage_t* usage) {
+  usage->buffers += sizeof(*a) + total_buffer_words(a) * sizeof(bits_t);
+  if (a->cloned) {
+    return;
+  }
+  if (a->input_connections) {
+    usage->input_connections += a->num_input_bits * sizeof(*a->input_connections);
+  }
+  usage->output_connections += a->num_output_bits * sizeof(*a->output_connections);
+  for (size_t j = 0; j < a->num_output_bits; ++j) {
+    usage->output_connections += a->output_connections[j].capacity * sizeof(connection_t);
+  }
+}
+
+static void sum_usage(ma_memory_usage_t* usage) {
+  usage->total = usage->buffers + usage->input_connections + usage->output_connections +
+                 usage->schedule + usage->group;
+}
+
+int ma_memory_usage(const moore_t* a, ma_memory_usage_t* usage) {
+  if (!a || !usage) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  memset(usage, 0, sizeof(*usage));
+  add_usage(a, usage);
+  sum_usage(usage);
+
+  return 0;
+}
+
+int ma_group_memory_usage(const ma_group_t* g, ma_memory_usage_t* usage) {
+  if (!g || !usage) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  memset(usage, 0, sizeof(*usage));
+  for (size_t i = 0; i < g->num; ++i) {
+    add_usage(g->automata[i], usage);
+  }
+
+  usage->group = sizeof(*g) + g->num * sizeof(*g->automata);
+  if (g->schedule) {
+    usage->schedule = g->schedule_first[g->num] * sizeof(*g->schedule) +
+                      (g->num + 1) * sizeof(*g->schedule_first);
+  }
+  if (g->schedule_index) {
+    usage->schedule += (g->num + 1) * sizeof(*g->schedule_index);
+  }
+  if (g->domains) {
+    usage->schedule += g->num * sizeof(*g->domain_members) +
+                       (g->num_domains + 1) * sizeof(*g->domains);
+  }
+  sum_usage(usage);
+
+  return 0;
+}
+
+uint64_t topology_version(const ma_group_t* g) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < g->num; ++i) {
+    sum += g->automata[i]->topology_version;
+  }
+  return sum;
+}
+
+void drop_schedule(ma_group_t* g) {
+  if (!g->schedule_refs || atomic_fetch_sub(g->schedule_refs, 1) == 1) {
+    free(g->schedule);
+    free(g->schedule_first);
+    free(g->schedule_refs);
+  }
+  free(g->schedule_index);
+  g->schedule = NULL;
+  g->schedule_first = NULL;
+  g->schedule_refs = NULL;
+  g->schedule_index = NULL;
+}
+
+// Shrinks the fan-out arrays of `a` to their exact size.
+static void shrink_output_connections(moore_t* a) {
+  for (size_t j = 0; j < a->num_output_bits; ++j) {
+    output_connection_t* conns = &a->output_connections[j];
+    if (conns->sz == conns->capacity) {
+      continue;
+    }
+    if (conns->sz == 0) {
+      mem_free(&a->alloc, conns->connections, conns->capacity * sizeof(connection_t));
+      conns->connections = NULL;
+      conns->capacity = 0;
+      continue;
+    }
+    connection_t* tmp = mem_realloc(&a->alloc, conns->connections,
+                                    conns->capacity * sizeof(*tmp), conns->sz * sizeof(*tmp));
+    if (tmp) {
+      conns->connections = tmp;
+      conns->capacity = conns->sz;
+    }
+  }
+}
+
+// Frees the input records of the members of an owning group, which then
+// read their inputs from the schedule. Members of other groups may outlive
+// the schedule and keep their records.
+static void compact_inputs(ma_group_t* g) {
+  if (!g->owner) {
+    return;
+  }
+
+  for (size_t i = 0; i < g->num; ++i) {
+    moore_t* a = g->automata[i];
+    a->frozen_pos = i;
+    if (!a->input_connections) {
+      continue;
+    }
+    mem_free(&a->alloc, a->input_connections, a->num_input_bits * sizeof(*a->input_connections));
+    a->input_connections = NULL;
+    a->frozen_group = g;
+  }
+  g->compact = true;
+}
+
+int thaw_schedule(ma_group_t* g) {
+  if (!g->compact) {
+    return 0;
+  }
+
+  size_t i = 0;
+  for (; i < g->num; ++i) {
+    moore_t* a = g->automata[i];
+    if (a->frozen_group != g) {
+      continue;
+    }
+    a->input_connections = mem_alloc(&a->alloc, a->num_input_bits * sizeof(*a->input_connections));
+    if (!a->input_connections) {
+      break;
+    }
+    for (size_t j = 0; j < a->num_input_bits; ++j) {
+      a->input_connections[j].args.automaton = NULL;
+    }
+  }
+
+  if (i < g->num) {
+    while (i-- > 0) {
+      moore_t* a = g->automata[i];
+      if (a->frozen_group == g) {
+        mem_free(&a->alloc, a->input_connections,
+                 a->num_input_bits * sizeof(*a->input_connections));
+        a->input_connections = NULL;
+      }
+    }
+    errno = ENOMEM;
+    return -1;
+  }
+
+  // Every driver of a member is a member, so the fan-out arrays of the
+  // members hold the position of every record.
+  for (i = 0; i < g->num; ++i) {
+    moore_t* d = g->automata[i];
+    for (size_t b = 0; b < d->num_output_bits; ++b) {
+      const output_connection_t* conns = &d->output_connections[b];
+      for (size_t k = 0; k < conns->sz; ++k) {
+        moore_t* a = conns->connections[k].automaton;
+        if (a->frozen_group == g) {
+          a->input_connections[conns->connections[k].bit_idx] = (input_connection_t) {
+              .args = {.automaton = d, .bit_idx = b}, .output_connection_idx = k};
+        }
+      }
+    }
+  }
+
+  for (i = 0; i < g->num; ++i) {
+    if (g->automata[i]->frozen_group == g) {
+      g->automata[i]->frozen_group = NULL;
+    }
+  }
+  g->compact = false;
+  return 0;
+}
+
+int ma_group_freeze(ma_group_t* g) {
+  if (!g) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (g->num > UNCONNECTED) {
+    errno = EOVERFLOW;
+    return -1;
+  }
+
+  if (async_busy(g)) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  // A clone is stepped through the schedule it shares.
+  if (g->clone) {
+    return 0;
+  }
+
+  size_t* first = malloc((g->num + 1) * sizeof(*first));
+  member_entry_t* index = build_member_index(g);
+  compact_conn_t* schedule = NULL;
+  if (!first || !index) {
+    free(first);
+    free(index);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  first[0] = 0;
+  for (size_t i = 0; i < g->num; ++i) {
+    first[i + 1] = first[i] + g->automata[i]->num_input_bits;
+  }
+
+  if (!(schedule = malloc((first[g->num] + 1) * sizeof(*schedule)))) {
+    free(first);
+    free(index);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  int err = 0;
+  for (size_t i = 0; i < g->num && err == 0; ++i) {
+    const moore_t* a = g->automata[i];
+    for (size_t j = 0; j < a->num_input_bits; ++j) {
+      compact_conn_t* c = &schedule[first[i] + j];
+      // A group frozen before has no input records left; its members read
+      // their drivers from the schedule being replaced.
+      connection_t conn = input_source(a, j);
+      if (!conn.automaton) {
+        c->driver = UNCONNECTED;
+        c->driver_bit = 0;
+        continue;
+      }
+
+      size_t driver = find_member(index, g->num, conn.automaton);
+      if (driver == SIZE_MAX) {
+        // Only connections within the group can be encoded.
+        err = EINVAL;
+        break;
+      }
+      if (conn.bit_idx > UINT32_MAX) {
+        err = EOVERFLOW;
+        break;
+      }
+      c->driver = driver;
+      c->driver_bit = conn.bit_idx;
+    }
+  }
+
+  if (err != 0) {
+    free(first);
+    free(schedule);
+    free(index);
+    errno = err;
+    return -1;
+  }
+
+  for (size_t i = 0; i < g->num; ++i) {
+    shrink_output_connections(g->automata[i]);
+  }
+
+  // The members of a compact group read the new schedule, which has the
+  // same layout, from here on.
+  drop_schedule(g);
+  g->schedule = schedule;
+  g->schedule_first = first;
+  g->schedule_index = index;
+  g->schedule_version = topology_version(g);
+  compact_inputs(g);
+
+  return 0;
+}
+
+void gather_frozen(ma_group_t* g) {
+  for (size_t i = 0; i < g->num; ++i) {
+    moore_t* a = g->automata[i];
+    const compact_conn_t* conns = g->schedule + g->schedule_first[i];
+
+    for (size_t j = 0; j < a->num_input_bits; ++j) {
+      if (conns[j].driver == UNCONNECTED) {
+        continue;
+      }
+      copy_bit(a->input, get_bit(g->automata[conns[j].driver]->output, conns[j].driver_bit), j);
+#ifdef MA_STATS
+      ++a->stats.gathered_bits;
+#endif
+    }
+  }
+}
@@ -0,0 +1,402 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Driver of an input bit fed by bit `driver_bit` of the module input ports.
+#define PORT_DRIVER (UINT32_MAX - 1)
+
+#define INIT_KINDS 4
+
+// An automaton of a module definition.
+typedef struct {
+  size_t n, m, s;
+  transition_function_t t;
+  output_function_t y;
+  bits_t* q;                 // Initial state.
+  compact_conn_t* conns;     // Driver of every input bit.
+} kind_t;
+
+struct ma_module {
+  kind_t* kinds;
+  size_t num;
+  size_t cap;
+  size_t num_inputs;         // Width of the input ports in bits.
+  compact_conn_t* outputs;   // Source of every output port bit.
+  size_t num_outputs;
+};
+
+// The words of one automaton of the module in every instance, instance `i`
+// at offset `i * words`.
+typedef struct {
+  size_t n, m, s;
+  transition_function_t t;
+  output_function_t y;
+  size_t state_words, input_words, output_words;
+  bits_t* state;
+  bits_t* next_state;
+  bits_t* input;
+  bits_t* output;
+  const compact_conn_t* conns;
+} kind_arrays_t;
+
+struct ma_instances {
+  size_t count;
+  size_t num_kinds;
+  kind_arrays_t* kinds;
+  compact_conn_t* schedule;  // Input drivers of all kinds, shared by the instances.
+  compact_conn_t* outputs;
+  size_t num_outputs;
+  size_t num_inputs;
+  size_t port_words;
+  bits_t* ports;             // Input ports, `port_words` per instance.
+  bits_t* slab;
+};
+
+ma_module_t* ma_module_new(void) {
+  ma_module_t* mod = calloc(1, sizeof(*mod));
+  if (!mod) {
+    errno = ENOMEM;
+  }
+  return mod;
+}
+
+void ma_module_delete(ma_module_t* mod) {
+  if (!mod) {
+    return;
+  }
+
+  for (size_t i = 0; i < mod->num; ++i) {
+    free(mod->kinds[i].q);
+    free(mod->kinds[i].conns);
+  }
+  free(mod->kinds);
+  free(mod->outputs);
+  free(mod);
+}
+
+size_t ma_module_add(ma_module_t* mod, size_t n, size_t m, size_t s, transition_function_t t,
+                     output_function_t y, const bits_t* q) {
+  if (!mod || m == 0 || s == 0 || !t || !y || !q || n >= UINT32_MAX || m >= UINT32_MAX) {
+    errno = EINVAL;
+    return SIZE_MAX;
+  }
+
+  if (mod->num >= PORT_DRIVER) {
+    errno = EOVERFLOW;
+    return SIZE_MAX;
+  }
+
+  if (mod->num == mod->cap) {
+    size_t cap = mod->cap == 0 ? INIT_KINDS : 2 * mod->cap;
+    kind_t* tmp = realloc(mod->kinds, cap * sizeof(*tmp));
+    if (!tmp) {
+      errno = ENOMEM;
+      return SIZE_MAX;
+    }
+    mod->kinds = tmp;
+    mod->cap = cap;
+  }
+
+  kind_t* k = &mod->kinds[mod->num];
+  *k = (kind_t) {.n = n, .m = m, .s = s, .t = t, .y = y};
+  k->q = malloc(bits_to_words(s) * sizeof(*k->q));
+  k->conns = n == 0 ? NULL : malloc(n * sizeof(*k->conns));
+  if (!k->q || (n != 0 && !k->conns)) {
+    free(k->q);
+    free(k->conns);
+    errno = ENOMEM;
+    return SIZE_MAX;
+  }
+
+  memcpy(k->q, q, bits_to_words(s) * sizeof(*k->q));
+  for (size_t i = 0; i < n; ++i) {
+    k->conns[i] = (compact_conn_t) {.driver = UNCONNECTED, .driver_bit = 0};
+  }
+
+  return mod->num++;
+}
+
+static bool range_ok(size_t start, size_t num, size_t total) {
+  return num != 0 && num <= total && start <= total - num;
+}
+
+int ma_module_connect(ma_module_t* mod, size_t a_in, size_t in, size_t a_out, size_t out,
+                      size_t num) {
+  if (!mod || a_in >= mod->num || a_out >= mod->num ||
+      !range_ok(in, num, mod->kinds[a_in].n) || !range_ok(out, num, mod->kinds[a_out].m)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (size_t i = 0; i < num; ++i) {
+    mod->kinds[a_in].conns[in + i] = (compact_conn_t) {.driver = a_out, .driver_bit = out + i};
+  }
+
+  return 0;
+}
+
+int ma_module_input(ma_module_t* mod, size_t port, size_t a, size_t in, size_t num) {
+  if (!mod || a >= mod->num || !range_ok(in, num, mod->kinds[a].n) ||
+      port >= UINT32_MAX || num >= UINT32_MAX - port) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (size_t i = 0; i < num; ++i) {
+    mod->kinds[a].conns[in + i] = (compact_conn_t) {.driver = PORT_DRIVER,
+                                                    .driver_bit = port + i};
+  }
+  if (port + num > mod->num_inputs) {
+    mod->num_inputs = port + num;
+  }
+
+  return 0;
+}
+
+int ma_module_output(ma_module_t* mod, size_t port, size_t a, size_t out, size_t num) {
+  if (!mod || a >= mod->num || !range_ok(out, num, mod->kinds[a].m) ||
+      port >= UINT32_MAX || num >= UINT32_MAX - port) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (port + num > mod->num_outputs) {
+    compact_conn_t* tmp = realloc(mod->outputs, (port + num) * sizeof(*tmp));
+    if (!tmp) {
+      errno = ENOMEM;
+      return -1;
+    }
+    for (size_t i = mod->num_outputs; i < port + num; ++i) {
+      tmp[i] = (compact_conn_t) {.driver = UNCONNECTED, .driver_bit = 0};
+    }
+    mod->outputs = tmp;
+    mod->num_outputs = port + num;
+  }
+
+  for (size_t i = 0; i < num; ++i) {
+    mod->outputs[port + i] = (compact_conn_t) {.driver = a, .driver_bit = out + i};
+  }
+
+  return 0;
+}
+
+void ma_instances_delete(ma_instances_t* x) {
+  if (!x) {
+    return;
+  }
+
+  free(x->kinds);
+  free(x->schedule);
+  free(x->outputs);
+  free(x->slab);
+  free(x);
+}
+
+// Returns the number of slab words of all instances, or `SIZE_MAX` on overflow.
+static size_t slab_words(const ma_module_t* mod, size_t count, size_t port_words) {
+  size_t per_instance = port_words;
+  for (size_t i = 0; i < mod->num; ++i) {
+    const kind_t* k = &mod->kinds[i];
+    size_t words = 2 * bits_to_words(k->s) + bits_to_words(k->n) + bits_to_words(k->m);
+    if (words > SIZE_MAX / 2 - per_instance) {
+      return SIZE_MAX;
+    }
+    per_instance += words;
+  }
+  return per_instance > SIZE_MAX / sizeof(bits_t) / count ? SIZE_MAX : per_instance * count;
+}
+
+// Copies the definition of `mod` that the instances need.
+static int copy_definition(ma_instances_t* x, const ma_module_t* mod) {
+  size_t total = 0;
+  for (size_t i = 0; i < mod->num; ++i) {
+    total += mod->kinds[i].n;
+  }
+
+  x->kinds = malloc(mod->num * sizeof(*x->kinds));
+  x->schedule = total == 0 ? NULL : malloc(total * sizeof(*x->schedule));
+  x->outputs = mod->num_outputs == 0 ? NULL : malloc(mod->num_outputs * sizeof(*x->outputs));
+  if (!x->kinds || (total != 0 && !x->schedule) || (mod->num_outputs != 0 && !x->outputs)) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  if (mod->num_outputs != 0) {
+    memcpy(x->outputs, mod->outputs, mod->num_outputs * sizeof(*x->outputs));
+  }
+
+  size_t pos = 0;
+  for (size_t i = 0; i < mod->num; ++i) {
+    const kind_t* k = &mod->kinds[i];
+    if (k->n != 0) {
+      memcpy(x->schedule + pos, k->conns, k->n * sizeof(*x->schedule));
+    }
+    x->kinds[i] = (kind_arrays_t) {
+      .n = k->n, .m = k->m, .s = k->s, .t = k->t, .y = k->y,
+      .state_words = bits_to_words(k->s), .input_words = bits_to_words(k->n),
+      .output_words = bits_to_words(k->m), .conns = k->n == 0 ? NULL : x->schedule + pos,
+    };
+    pos += k->n;
+  }
+
+  return 0;
+}
+
+ma_instances_t* ma_module_instantiate(const ma_module_t* mod, size_t count) {
+  if (!mod || mod->num == 0 || count == 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  ma_instances_t* x = calloc(1, sizeof(*x));
+  if (!x) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  x->count = count;
+  x->num_kinds = mod->num;
+  x->num_outputs = mod->num_outputs;
+  x->num_inputs = mod->num_inputs;
+  x->port_words = bits_to_words(mod->num_inputs);
+
+  size_t words = slab_words(mod, count, x->port_words);
+  if (words == SIZE_MAX) {
+    ma_instances_delete(x);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  if (copy_definition(x, mod) == -1 || !(x->slab = calloc(words, sizeof(*x->slab)))) {
+    ma_instances_delete(x);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  // Every array of a kind holds the words of all instances back to back.
+  bits_t* p = x->slab;
+  x->ports = p;
+  p += count * x->port_words;
+  for (size_t i = 0; i < x->num_kinds; ++i) {
+    kind_arrays_t* k = &x->kinds[i];
+    k->state = p;
+    p += count * k->state_words;
+    k->next_state = p;
+    p += count * k->state_words;
+    k->input = p;
+    p += count * k->input_words;
+    k->output = p;
+    p += count * k->output_words;
+
+    for (size_t j = 0; j < count; ++j) {
+      bits_t* state = k->state + j * k->state_words;
+      memcpy(state, mod->kinds[i].q, k->state_words * sizeof(bits_t));
+      k->y(k->output + j * k->output_words, state, k->m, k->s);
+    }
+  }
+
+  return x;
+}
+
+// Copies the driven input bits of kind `k` in every instance.
+static void gather_kind(ma_instances_t* x, kind_arrays_t* k) {
+  for (size_t b = 0; b < k->n; ++b) {
+    compact_conn_t c = k->conns[b];
+    if (c.driver == UNCONNECTED) {
+      continue;
+    }
+
+    const bits_t* src;
+    size_t stride;
+    if (c.driver == PORT_DRIVER) {
+      src = x->ports;
+      stride = x->port_words;
+    } else {
+      src = x->kinds[c.driver].output;
+      stride = x->kinds[c.driver].output_words;
+    }
+
+    // The same bit of every instance: a strided loop over contiguous arrays.
+    bits_t* dst = k->input;
+    for (size_t i = 0; i < x->count; ++i) {
+      copy_bit(dst, get_bit(src, c.driver_bit), b);
+      src += stride;
+      dst += k->input_words;
+    }
+  }
+}
+
+static void transition_kind(ma_instances_t* x, kind_arrays_t* k) {
+  for (size_t i = 0; i < x->count; ++i) {
+    k->t(k->next_state + i * k->state_words, k->input + i * k->input_words,
+         k->state + i * k->state_words, k->n, k->s);
+  }
+
+  memcpy(k->state, k->next_state, x->count * k->state_words * sizeof(bits_t));
+  for (size_t i = 0; i < x->count; ++i) {
+    k->y(k->output + i * k->output_words, k->state + i * k->state_words, k->m, k->s);
+  }
+}
+
+int ma_instances_step(ma_instances_t* x, size_t k) {
+  if (!x) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (size_t c = 0; c < k; ++c) {
+    for (size_t i = 0; i < x->num_kinds; ++i) {
+      gather_kind(x, &x->kinds[i]);
+    }
+    for (size_t i = 0; i < x->num_kinds; ++i) {
+      transition_kind(x, &x->kinds[i]);
+    }
+  }
+
+  return 0;
+}
+
+size_t ma_instances_count(const ma_instances_t* x) {
+  if (!x) {
+    errno = EINVAL;
+    return 0;
+  }
+
+  return x->count;
+}
+
+int ma_instances_set_input(ma_instances_t* x, size_t i, const bits_t* input) {
+  if (!x || i >= x->count || !input || x->num_inputs == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  bits_t* dst = x->ports + i * x->port_words;
+  for (size_t b = 0; b < x->num_inputs; ++b) {
+    copy_bit(dst, get_bit(input, b), b);
+  }
+
+  return 0;
+}
+
+int ma_instances_get_output(const ma_instances_t* x, size_t i, bits_t* output) {
+  if (!x || i >= x->count || !output || x->num_outputs == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  memset(output, 0, bits_to_words(x->num_outputs) * sizeof(bits_t));
+  for (size_t b = 0; b < x->num_outputs; ++b) {
+    compact_conn_t c = x->outputs[b];
+    if (c.driver == UNCONNECTED) {
+      continue;
+    }
+    const kind_arrays_t* k = &x->kinds[c.driver];
+    if (get_bit(k->output + i * k->output_words, c.driver_bit)) {
+      set_bit(output, b);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,340 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Layout of a netlist file (all fields are native 64-bit words):
+//   header, `num_automata` automaton records, `num_ranges` range records.
+// An automaton record is followed by its `ceil(s / 64)` initial state words
+// and `ceil(n / 64)` input words.
+
+#define NETLIST_MAGIC "MANET001"
+
+typedef struct {
+  char magic[8];
+  uint64_t num_automata;
+  uint64_t num_ranges;
+} netlist_header_t;
+
+typedef struct {
+  uint64_t n;
+  uint64_t m;
+  uint64_t s;
+  uint64_t func_id;
+} netlist_automaton_t;
+
+typedef struct {
+  uint64_t in_aut;
+  uint64_t in_bit;
+  uint64_t out_aut;
+  uint64_t out_bit;
+  uint64_t num;
+} netlist_range_t;
+
+static const ma_func_entry_t* find_by_id(const ma_func_registry_t* reg, uint64_t id) {
+  for (size_t i = 0; i < reg->num; ++i) {
+    if (reg->entries[i].id == id) {
+      return &reg->entries[i];
+    }
+  }
+  return NULL;
+}
+
+static const ma_func_entry_t* find_by_funcs(const ma_func_registry_t* reg, const moore_t* a) {
+  for (size_t i = 0; i < reg->num; ++i) {
+    const ma_func_entry_t* e = &reg->entries[i];
+    if (e->t == a->trans_func &&
+        (e->y == a->out_func || (!e->y && a->out_func == id_output))) {
+      return e;
+    }
+  }
+  return NULL;
+}
+
+static bool fits(size_t len, size_t pos, size_t need) {
+  return need <= len && pos <= len - need;
+}
+
+static bool range_ok(uint64_t start, uint64_t num, uint64_t total) {
+  return num != 0 && num <= total && start <= total - num;
+}
+
+// Returns true if the bit counts of `rec` keep the buffers and connection
+// arrays of the automaton within `size_t` arithmetic.
+static bool counts_ok(const netlist_automaton_t* rec) {
+  const uint64_t max_bits = SIZE_MAX / sizeof(output_connection_t);
+  _Static_assert(sizeof(output_connection_t) >= sizeof(input_connection_t),
+                 "output records bound the input records");
+  return rec->n <= max_bits && rec->m <= max_bits && rec->s <= max_bits;
+}
+
+// Creates the automata described by the records starting at `*pos`.
+static int load_automata(ma_group_t* g, size_t total, const char* base, size_t len,
+                         size_t* pos, const ma_func_registry_t* reg) {
+  for (size_t i = 0; i < total; ++i) {
+    netlist_automaton_t rec;
+    if (!fits(len, *pos, sizeof(rec))) {
+      errno = EINVAL;
+      return -1;
+    }
+    memcpy(&rec, base + *pos, sizeof(rec));
+    *pos += sizeof(rec);
+
+    if (!counts_ok(&rec)) {
+      errno = EINVAL;
+      return -1;
+    }
+
+    const ma_func_entry_t* e = find_by_id(reg, rec.func_id);
+    size_t state_words = bits_to_words(rec.s), input_words = bits_to_words(rec.n);
+    if (!e || !e->t || state_words > len / sizeof(bits_t) || input_words > len / sizeof(bits_t) ||
+        !fits(len, *pos, (state_words + input_words) * sizeof(bits_t))) {
+      errno = EINVAL;
+      return -1;
+    }
+
+    const bits_t* words = (const bits_t*) (base + *pos);
+    *pos += (state_words + input_words) * sizeof(bits_t);
+
+    moore_t* a = create_automaton(rec.n, rec.m, rec.s, e->t, e->y ? e->y : id_output, words,
+                                  &g->alloc, g->padded);
+    if (!a) {
+      return -1;
+    }
+    g->automata[g->num++] = a;
+
+    if (input_words != 0) {
+      memcpy(a->input, words + state_words, input_words * sizeof(bits_t));
+    }
+  }
+
+  return 0;
+}
+
+// Applies the ranges in one transactional bulk connection.
+static int load_ranges(ma_group_t* g, const netlist_range_t* ranges, size_t num_ranges) {
+  if (num_ranges == 0) {
+    return 0;
+  }
+
+  ma_conn_spec_t* specs = malloc(num_ranges * sizeof(*specs));
+  if (!specs) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  int ret = -1;
+  for (size_t r = 0; r < num_ranges; ++r) {
+    netlist_range_t rng;
+    memcpy(&rng, &ranges[r], sizeof(rng));
+    if (rng.in_aut >= g->num || rng.out_aut >= g->num ||
+        !range_ok(rng.in_bit, rng.num, g->automata[rng.in_aut]->num_input_bits) ||
+        !range_ok(rng.out_bit, rng.num, g->automata[rng.out_aut]->num_output_bits)) {
+      errno = EINVAL;
+      goto exit;
+    }
+    specs[r] = (ma_conn_spec_t) {.a_in = g->automata[rng.in_aut], .in = rng.in_bit,
+                                 .a_out = g->automata[rng.out_aut], .out = rng.out_bit,
+                                 .num = rng.num};
+  }
+
+  ret = ma_connect_many(specs, num_ranges);
+
+exit:
+  free(specs);
+  return ret;
+}
+
+ma_group_t* ma_load_netlist(const char* path, const ma_func_registry_t* reg) {
+  if (!path || !reg || (reg->num != 0 && !reg->entries)) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd == -1) {
+    return NULL;
+  }
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t len = st.st_size;
+  netlist_header_t header;
+  if (len < sizeof(header)) {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  const char* base = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    return NULL;
+  }
+  madvise((void*) base, len, MADV_SEQUENTIAL);
+
+  ma_group_t* g = NULL;
+  size_t pos = sizeof(header);
+  memcpy(&header, base, sizeof(header));
+
+  if (memcmp(header.magic, NETLIST_MAGIC, 8) != 0 || header.num_automata == 0 ||
+      header.num_automata > len / sizeof(netlist_automaton_t)) {
+    errno = EINVAL;
+    goto fail;
+  }
+
+  g = ma_group_new();
+  if (!g || !(g->automata = malloc(header.num_automata * sizeof(*g->automata)))) {
+    errno = ENOMEM;
+    goto fail;
+  }
+  g->cap = header.num_automata;
+
+  if (load_automata(g, header.num_automata, base, len, &pos, reg) == -1) {
+    goto fail;
+  }
+
+  if (header.num_ranges > len / sizeof(netlist_range_t) ||
+      !fits(len, pos, header.num_ranges * sizeof(netlist_range_t))) {
+    errno = EINVAL;
+    goto fail;
+  }
+
+  if (load_ranges(g, (const netlist_range_t*) (base + pos), header.num_ranges) == -1) {
+    goto fail;
+  }
+
+  // Moves the member buffers into one slab and replaces the input records
+  // with the gather schedule, leaving a few allocations for the whole network.
+  if (ma_group_compact(g) == -1 || ma_group_freeze(g) == -1) {
+    goto fail;
+  }
+
+  munmap((void*) base, len);
+  return g;
+
+fail:;
+  int err = errno;
+  ma_group_delete(g);
+  munmap((void*) base, len);
+  errno = err;
+  return NULL;
+}
+
+// Finds every maximal range of consecutive input bits driven by consecutive
+// output bits of a single automaton and writes it to `out` unless it is NULL.
+// Returns the number of ranges, or `-1` if a driver is not a member of the
+// group or writing failed.
+static long long for_each_range(const ma_group_t* g, const member_entry_t* index, FILE* out) {
+  long long count = 0;
+
+  for (size_t i = 0; i < g->num; ++i) {
+    const moore_t* a = g->automata[i];
+    size_t j = 0;
+    while (j < a->num_input_bits) {
+      connection_t c = input_source(a, j);
+      if (!c.automaton) {
+        ++j;
+        continue;
+      }
+
+      size_t driver = find_member(index, g->num, c.automaton);
+      if (driver == SIZE_MAX) {
+        return -1;
+      }
+
+      size_t len = 1;
+      while (j + len < a->num_input_bits &&
+             input_source(a, j + len).automaton == c.automaton &&
+             input_source(a, j + len).bit_idx == c.bit_idx + len) {
+        ++len;
+      }
+
+      netlist_range_t rng = {.in_aut = i, .in_bit = j, .out_aut = driver,
+                             .out_bit = c.bit_idx, .num = len};
+      if (out && fwrite(&rng, sizeof(rng), 1, out) != 1) {
+        return -1;
+      }
+      ++count;
+      j += len;
+    }
+  }
+
+  return count;
+}
+
+int ma_save_netlist(const ma_group_t* g, const char* path, const ma_func_registry_t* reg) {
+  if (!g || !path || !reg || (reg->num != 0 && !reg->entries)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (size_t i = 0; i < g->num; ++i) {
+    if (!find_by_funcs(reg, g->automata[i])) {
+      errno = EINVAL;
+      return -1;
+    }
+  }
+
+  member_entry_t* index = build_member_index(g);
+  if (!index) {
+    return -1;
+  }
+
+  int ret = -1;
+  FILE* out = NULL;
+  long long num_ranges = for_each_range(g, index, NULL);
+  if (num_ranges == -1) {
+    errno = EINVAL;
+    goto exit;
+  }
+
+  if (!(out = fopen(path, "wb"))) {
+    goto exit;
+  }
+
+  netlist_header_t header = {.num_automata = g->num, .num_ranges = num_ranges};
+  memcpy(header.magic, NETLIST_MAGIC, 8);
+  if (fwrite(&header, sizeof(header), 1, out) != 1) {
+    goto io_error;
+  }
+
+  for (size_t i = 0; i < g->num; ++i) {
+    const moore_t* a = g->automata[i];
+    netlist_automaton_t rec = {.n = a->num_input_bits, .m = a->num_output_bits,
+                               .s = a->state_bit_count, .func_id = find_by_funcs(reg, a)->id};
+    size_t state_words = bits_to_words(a->state_bit_count);
+    size_t input_words = bits_to_words(a->num_input_bits);
+    if (fwrite(&rec, sizeof(rec), 1, out) != 1 ||
+        fwrite(a->state, sizeof(bits_t), state_words, out) != state_words ||
+        (input_words != 0 && fwrite(a->input, sizeof(bits_t), input_words, out) != input_words)) {
+      goto io_error;
+    }
+  }
+
+  if (for_each_range(g, index, out) != num_ranges) {
+    goto io_error;
+  }
+
+  ret = 0;
+  goto exit;
+
+io_error:
+  errno = EIO;
+
+exit:
+  if (out && fclose(out) != 0 && ret == 0) {
+    errno = EIO;
+    ret = -1;
+  }
+  free(index);
+  return ret;
+}
@@ -0,0 +1,196 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Largest number of state and connected input bits of a transition table.
+#define MAX_TABLE_BITS 12
+
+void unfold(moore_t* a) {
+  free(a->table);
+  a->table = NULL;
+  a->frozen = false;
+}
+
+void table_transition(moore_t* a) {
+  const fold_table_t* t = a->table;
+  size_t s = a->state_bit_count;
+  size_t idx = a->state[0] & (((bits_t) 1 << s) - 1);
+
+  for (size_t k = 0; k < t->num_vars; ++k) {
+    idx |= (size_t) get_bit(a->input, t->vars[k]) << (s + k);
+  }
+  a->next_state[0] = t->next[idx];
+}
+
+static size_t connected_bits(const moore_t* a) {
+  size_t num = 0;
+  for (size_t i = 0; i < a->num_input_bits; ++i) {
+    num += input_source(a, i).automaton != NULL;
+  }
+  return num;
+}
+
+// Tabulates the transition function of `a` over all states and values of the
+// connected inputs, with the unconnected inputs fixed to their current values.
+// The function is called on scratch buffers laid out like those of `a`.
+static int build_table(moore_t* a, size_t num_vars) {
+  size_t s = a->state_bit_count;
+  size_t entries = (size_t) 1 << (s + num_vars);
+  size_t state_words = buffer_words(a, s);
+
+  fold_table_t* t = malloc(sizeof(*t) + entries * sizeof(bits_t) + num_vars * sizeof(uint32_t));
+  bits_t* state = alloc_scratch(2 * state_words);
+  bits_t* input = alloc_scratch(buffer_words(a, a->num_input_bits));
+  if (!t || !state || !input) {
+    free(t);
+    free(state);
+    free(input);
+    errno = ENOMEM;
+    return -1;
+  }
+  bits_t* next = state + state_words;
+
+  t->num_vars = num_vars;
+  t->next = (bits_t*) (t + 1);
+  t->vars = (uint32_t*) (t->next + entries);
+  for (size_t i = 0, k = 0; i < a->num_input_bits; ++i) {
+    if (input_source(a, i).automaton) {
+      t->vars[k++] = i;
+    }
+  }
+
+  memcpy(input, a->input, bits_to_words(a->num_input_bits) * sizeof(*input));
+  for (size_t idx = 0; idx < entries; ++idx) {
+    state[0] = idx & (((bits_t) 1 << s) - 1);
+    for (size_t k = 0; k < num_vars; ++k) {
+      copy_bit(input, (idx >> (s + k)) & 1, t->vars[k]);
+    }
+    a->trans_func(next, input, state, a->num_input_bits, s);
+    t->next[idx] = next[0];
+  }
+
+  free(state);
+  free(input);
+  free(a->table);
+  a->table = t;
+  return 0;
+}
+
+// Marks the members that can influence an observed automaton.
+static int mark_live(const ma_group_t* g, moore_t* const observed[], size_t num_observed,
+                     bool* live) {
+  member_entry_t* index = build_member_index(g);
+  size_t* stack = malloc((g->num == 0 ? 1 : g->num) * sizeof(*stack));
+  int ret = -1;
+  size_t top = 0;
+
+  if (!index || !stack) {
+    errno = ENOMEM;
+    goto exit;
+  }
+
+  for (size_t i = 0; i < num_observed; ++i) {
+    size_t pos = observed[i] ? find_member(index, g->num, observed[i]) : SIZE_MAX;
+    if (pos == SIZE_MAX) {
+      errno = EINVAL;
+      goto exit;
+    }
+    if (!live[pos]) {
+      live[pos] = true;
+      stack[top++] = pos;
+    }
+  }
+
+  while (top != 0) {
+    const moore_t* a = g->automata[stack[--top]];
+    for (size_t j = 0; j < a->num_input_bits; ++j) {
+      const moore_t* driver = input_source(a, j).automaton;
+      size_t pos = driver ? find_member(index, g->num, driver) : SIZE_MAX;
+      if (pos != SIZE_MAX && !live[pos]) {
+        live[pos] = true;
+        stack[top++] = pos;
+      }
+    }
+  }
+
+  ret = 0;
+
+exit:
+  free(index);
+  free(stack);
+  return ret;
+}
+
+static int remove_dead(ma_group_t* g, moore_t* const observed[], size_t num_observed,
+                       size_t* removed) {
+  bool* live = calloc(g->num == 0 ? 1 : g->num, sizeof(*live));
+  if (!live) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  if (mark_live(g, observed, num_observed, live) == -1 || thaw_schedule(g) == -1) {
+    free(live);
+    return -1;
+  }
+
+  // Removal moves the last member forward, which has already been visited.
+  for (size_t i = g->num; i-- > 0;) {
+    if (!live[i]) {
+      remove_member(g, i);
+      ++*removed;
+    }
+  }
+
+  free(live);
+  return 0;
+}
+
+int ma_group_optimize(ma_group_t* g, moore_t* const observed[], size_t num_observed,
+                      ma_optimize_result_t* result) {
+  if (!g || (num_observed != 0 && !observed)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (num_observed != 0 && g->clone) {
+    errno = EPERM;
+    return -1;
+  }
+
+  if ((num_observed != 0 && (g->trace || g->rewind || g->view)) || async_busy(g)) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  ma_optimize_result_t res = {0};
+  if (num_observed != 0 && remove_dead(g, observed, num_observed, &res.num_removed) == -1) {
+    return -1;
+  }
+
+  for (size_t i = 0; i < g->num; ++i) {
+    moore_t* a = g->automata[i];
+    size_t vars = connected_bits(a);
+
+    // Without connected inputs or generators the next state depends on the
+    // state alone.
+    a->settle = vars == 0 && !a->stim;
+    res.num_settling += a->settle;
+
+    if (vars == 0 || vars == a->num_input_bits || a->port || a->stim ||
+        a->state_bit_count + vars > MAX_TABLE_BITS) {
+      continue;
+    }
+    if (build_table(a, vars) == -1) {
+      return -1;
+    }
+    ++res.num_folded;
+  }
+
+  if (result) {
+    *result = res;
+  }
+
+  return 0;
+}
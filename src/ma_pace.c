@@ -0,0 +1,129 @@
+#define _GNU_SOURCE
+#include "ma_internal.h"
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+
+#define NS_PER_SEC 1000000000u
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t t) {
+  struct timespec ts = {.tv_sec = t / NS_PER_SEC, .tv_nsec = t % NS_PER_SEC};
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+  }
+}
+
+// Waits for the release time `t` of a tick.
+static void wait_until(const ma_pace_opts_t* opts, uint64_t t) {
+  switch (opts->mode) {
+    case MA_PACE_SLEEP:
+      sleep_until(t);
+      return;
+    case MA_PACE_HYBRID:
+      if (t > opts->spin_ns) {
+        sleep_until(t - opts->spin_ns);
+      }
+    case MA_PACE_BUSY:
+      while (now_ns() < t) {
+      }
+      return;
+  }
+}
+
+// Returns the histogram bucket of a latency: [2^i, 2^(i+1)) ns.
+static size_t latency_bucket(uint64_t ns) {
+  size_t bucket = 0;
+  while (bucket + 1 < MA_STATS_BUCKETS && (ns >> (bucket + 1)) != 0) {
+    ++bucket;
+  }
+  return bucket;
+}
+
+static int run(ma_group_t* g, const ma_pace_opts_t* opts, ma_pace_stats_t* stats) {
+  uint64_t release = now_ns();
+
+  for (uint64_t tick = 0; opts->ticks == 0 || tick < opts->ticks; ++tick) {
+    wait_until(opts, release);
+    uint64_t start = now_ns();
+
+    if (opts->hook && opts->hook(g, tick, opts->ctx) != 0) {
+      break;
+    }
+    if (group_prepare(g) == -1) {
+      return -1;
+    }
+    group_step_once(g);
+
+    uint64_t done = now_ns();
+    uint64_t latency = done - release;
+    ++stats->ticks;
+    ++stats->latency_hist[latency_bucket(latency)];
+    if (latency > stats->max_latency_ns) {
+      stats->max_latency_ns = latency;
+    }
+    if (start - release > stats->max_jitter_ns) {
+      stats->max_jitter_ns = start - release;
+    }
+
+    // A late tick is followed immediately by the next one, which keeps the
+    // long-run rate.
+    release += opts->period_ns;
+    if (done > release) {
+      ++stats->overruns;
+    }
+  }
+
+  return 0;
+}
+
+int ma_run_paced(ma_group_t* g, const ma_pace_opts_t* opts, ma_pace_stats_t* stats) {
+  if (!g || !opts || opts->period_ns == 0 || opts->mode > MA_PACE_HYBRID ||
+      opts->cpu >= CPU_SETSIZE) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (async_busy(g)) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  ma_pace_stats_t local;
+  if (!stats) {
+    stats = &local;
+  }
+  memset(stats, 0, sizeof(*stats));
+
+  cpu_set_t saved;
+  pthread_t self = pthread_self();
+  if (opts->cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(opts->cpu, &set);
+    int err = pthread_getaffinity_np(self, sizeof(saved), &saved);
+    if (err == 0) {
+      err = pthread_setaffinity_np(self, sizeof(set), &set);
+    }
+    if (err != 0) {
+      errno = err;
+      return -1;
+    }
+  }
+
+  int ret = run(g, opts, stats);
+
+  if (opts->cpu >= 0) {
+    int err = errno;
+    pthread_setaffinity_np(self, sizeof(saved), &saved);
+    errno = err;
+  }
+
+  return ret;
+}
@@ -0,0 +1,160 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A bounded multi-producer single-consumer queue of input vectors. Slot `i`
+// is free for position `pos` when `seq[i] == pos` and holds the vector
+// pushed at `pos` when `seq[i] == pos + 1`.
+struct ma_port {
+  moore_t* automaton;
+  ma_port_mode_t mode;
+  size_t words;              // Length of a vector in words.
+  size_t mask;               // Number of slots minus one.
+
+  atomic_size_t* seq;
+  uint64_t* cycles;          // Cycle stamp of every slot.
+  bits_t* data;              // `words` words per slot.
+
+  _Alignas(64) atomic_size_t head;  // Next position claimed by a producer.
+  _Alignas(64) size_t tail;         // Next position read by the stepping thread.
+};
+
+static void destroy_port(ma_port_t* p) {
+  free(p->seq);
+  free(p->cycles);
+  free(p->data);
+  free(p);
+}
+
+ma_port_t* ma_port_open(moore_t* a, ma_port_mode_t mode, size_t capacity) {
+  if (!a || a->num_input_bits == 0 || capacity == 0 || capacity > SIZE_MAX / 2 ||
+      (mode != MA_PORT_LATEST && mode != MA_PORT_QUEUED)) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (a->port) {
+    errno = EBUSY;
+    return NULL;
+  }
+
+  size_t slots = 1;
+  while (slots < capacity) {
+    slots *= 2;
+  }
+
+  ma_port_t* p = calloc(1, sizeof(*p));
+  if (!p) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  p->automaton = a;
+  p->mode = mode;
+  p->words = bits_to_words(a->num_input_bits);
+  p->mask = slots - 1;
+  p->seq = malloc(slots * sizeof(*p->seq));
+  p->cycles = malloc(slots * sizeof(*p->cycles));
+  p->data = p->words > SIZE_MAX / sizeof(bits_t) / slots
+            ? NULL : malloc(slots * p->words * sizeof(*p->data));
+  if (!p->seq || !p->cycles || !p->data) {
+    destroy_port(p);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  for (size_t i = 0; i < slots; ++i) {
+    atomic_init(&p->seq[i], i);
+  }
+  atomic_init(&p->head, 0);
+
+  a->port = p;
+  return p;
+}
+
+int ma_port_push(ma_port_t* p, const bits_t* input, uint64_t cycle) {
+  if (!p || !input) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  size_t pos = atomic_load_explicit(&p->head, memory_order_relaxed);
+  for (;;) {
+    size_t seq = atomic_load_explicit(&p->seq[pos & p->mask], memory_order_acquire);
+    ptrdiff_t diff = (ptrdiff_t) (seq - pos);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&p->head, &pos, pos + 1,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The slot still holds a vector of the previous lap.
+      errno = EAGAIN;
+      return -1;
+    } else {
+      pos = atomic_load_explicit(&p->head, memory_order_relaxed);
+    }
+  }
+
+  size_t slot = pos & p->mask;
+  p->cycles[slot] = cycle;
+  memcpy(p->data + slot * p->words, input, p->words * sizeof(bits_t));
+  atomic_store_explicit(&p->seq[slot], pos + 1, memory_order_release);
+
+  return 0;
+}
+
+// Returns true if the vector at position `pos` is published and due.
+static bool is_due(const ma_port_t* p, size_t pos) {
+  size_t slot = pos & p->mask;
+  return atomic_load_explicit(&p->seq[slot], memory_order_acquire) == pos + 1 &&
+         p->cycles[slot] <= p->automaton->cycle;
+}
+
+static void drain_port(ma_port_t* p) {
+  size_t num = 0;
+  while (is_due(p, p->tail + num) && (num == 0 || p->mode == MA_PORT_LATEST)) {
+    ++num;
+  }
+
+  if (num == 0) {
+    return;
+  }
+
+  // Only the last due vector is visible. Bits past the input width are kept.
+  moore_t* a = p->automaton;
+  const bits_t* src = p->data + ((p->tail + num - 1) & p->mask) * p->words;
+  size_t last = p->words - 1;
+  size_t tail_bits = a->num_input_bits % BITS_PER_WORD;
+  bits_t keep = tail_bits == 0 ? 0 : ~(bits_t) 0 << tail_bits;
+  memcpy(a->input, src, last * sizeof(bits_t));
+  a->input[last] = (a->input[last] & keep) | (src[last] & ~keep);
+  unfold(a);
+
+  for (size_t i = 0; i < num; ++i, ++p->tail) {
+    atomic_store_explicit(&p->seq[p->tail & p->mask], p->tail + p->mask + 1,
+                          memory_order_release);
+  }
+}
+
+void drain_ports(moore_t* const at[], size_t num) {
+  for (size_t i = 0; i < num; ++i) {
+    if (at[i]->port) {
+      drain_port(at[i]->port);
+    }
+    if (at[i]->stim) {
+      apply_stimuli(at[i]);
+    }
+  }
+}
+
+void ma_port_close(ma_port_t* p) {
+  if (!p) {
+    return;
+  }
+
+  p->automaton->port = NULL;
+  destroy_port(p);
+}
@@ -0,0 +1,663 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_MAX_STATES ((size_t) 1 << 20)
+#define MAX_FREE_BITS 24  // At most 2^24 input combinations are tried per state.
+#define BLOCK_LEN 256     // Number of frontier entries moved between threads at once.
+#define NO_ENTRY UINT64_MAX
+
+// Source of a connected input bit of a member automaton.
+typedef struct {
+  size_t bit;            // Input bit of the member.
+  const bits_t* ext;     // Output of a driver outside of the explored set, or NULL.
+  size_t driver;         // Index of the driving member (when `ext` is NULL).
+  size_t driver_bit;     // Output bit of the driver.
+} gather_t;
+
+// A BFS level. Entries above `limit` are spilled to a temporary file.
+typedef struct {
+  pthread_mutex_t lock;
+  uint64_t* mem;
+  size_t len;
+  size_t cap;
+  size_t limit;
+  FILE* spill;
+  size_t spilled;
+  size_t read;
+} frontier_t;
+
+typedef struct {
+  moore_t** at;
+  size_t num;
+  const ma_reach_opts_t* opts;
+
+  size_t words;              // Words of a packed global state.
+  size_t* state_pos;         // Bit offset of each member state in a packed state.
+  size_t* scratch_off;       // Per member: offsets of state, next state, input, output.
+  size_t scratch_words;
+
+  gather_t* gathers;
+  size_t* gather_begin;      // Gathers of member `i` are [gather_begin[i], gather_begin[i + 1]).
+  size_t* free_member;
+  size_t* free_bit;
+  size_t num_free;
+
+  // Visited set: an open addressing table of entry indices (plus one) into
+  // the entry arrays below. Slots are claimed with a single CAS.
+  bits_t* keys;
+  uint64_t* parent;
+  uint64_t* via;
+  size_t max_entries;
+  atomic_size_t next_entry;
+  atomic_size_t count;
+  _Atomic uint64_t* slots;
+  size_t mask;
+
+  frontier_t frontier[2];
+  frontier_t* cur;
+  frontier_t* next;
+
+  atomic_int stop;
+  atomic_int error;
+  _Atomic uint64_t found;
+} reach_t;
+
+typedef struct {
+  reach_t* r;
+  bits_t* scratch;
+  bits_t* key;
+  const bits_t** outputs;
+  uint64_t* block;
+  uint64_t* out;
+  size_t out_len;
+  uint64_t pending;          // Entry reserved by a failed insertion, reused by the next one.
+} worker_t;
+
+static int frontier_init(frontier_t* f, size_t limit) {
+  memset(f, 0, sizeof(*f));
+  f->limit = limit;
+  return pthread_mutex_init(&f->lock, NULL) == 0 ? 0 : -1;
+}
+
+static void frontier_reset(frontier_t* f) {
+  f->len = 0;
+  if (f->spill) {
+    fclose(f->spill);
+  }
+  f->spill = NULL;
+  f->spilled = 0;
+  f->read = 0;
+}
+
+static void frontier_destroy(frontier_t* f) {
+  frontier_reset(f);
+  free(f->mem);
+  pthread_mutex_destroy(&f->lock);
+}
+
+static bool frontier_empty(const frontier_t* f) {
+  return f->len == 0 && f->read == f->spilled;
+}
+
+static int frontier_push(frontier_t* f, const uint64_t* entries, size_t k) {
+  int ret = 0;
+  pthread_mutex_lock(&f->lock);
+
+  if (f->len + k <= f->limit) {
+    if (f->len + k > f->cap) {
+      size_t new_cap = f->cap == 0 ? BLOCK_LEN : 2 * f->cap;
+      while (new_cap < f->len + k) {
+        new_cap *= 2;
+      }
+      uint64_t* tmp = realloc(f->mem, new_cap * sizeof(*tmp));
+      if (!tmp) {
+        errno = ENOMEM;
+        ret = -1;
+        goto out;
+      }
+      f->mem = tmp;
+      f->cap = new_cap;
+    }
+    memcpy(f->mem + f->len, entries, k * sizeof(*entries));
+    f->len += k;
+  } else {
+    if (!f->spill && !(f->spill = tmpfile())) {
+      ret = -1;
+      goto out;
+    }
+    if (fwrite(entries, sizeof(*entries), k, f->spill) != k) {
+      errno = EIO;
+      ret = -1;
+      goto out;
+    }
+    f->spilled += k;
+  }
+
+out:
+  pthread_mutex_unlock(&f->lock);
+  return ret;
+}
+
+// Prepares the spilled part of the frontier for reading.
+static int frontier_begin_read(frontier_t* f) {
+  if (f->spill && (fflush(f->spill) != 0 || fseek(f->spill, 0, SEEK_SET) != 0)) {
+    return -1;
+  }
+  return 0;
+}
+
+// Takes up to `max` entries from the frontier and stores their number in
+// `taken`. Returns -1 if the spilled part could not be read back.
+static int frontier_pop(frontier_t* f, uint64_t* entries, size_t max, size_t* taken) {
+  size_t k = 0;
+  int ret = 0;
+  pthread_mutex_lock(&f->lock);
+
+  if (f->len > 0) {
+    k = f->len < max ? f->len : max;
+    f->len -= k;
+    memcpy(entries, f->mem + f->len, k * sizeof(*entries));
+  } else if (f->read < f->spilled) {
+    k = f->spilled - f->read < max ? f->spilled - f->read : max;
+    if (fread(entries, sizeof(*entries), k, f->spill) != k) {
+      // The states left in the file would be missing from the result.
+      f->read = f->spilled;
+      errno = EIO;
+      k = 0;
+      ret = -1;
+    } else {
+      f->read += k;
+    }
+  }
+
+  pthread_mutex_unlock(&f->lock);
+  *taken = k;
+  return ret;
+}
+
+static uint64_t hash_key(const bits_t* key, size_t words) {
+  uint64_t h = 0x9e3779b97f4a7c15ULL;
+  for (size_t i = 0; i < words; ++i) {
+    h ^= key[i];
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+  }
+  return h;
+}
+
+static void fail(reach_t* r, int err) {
+  int expected = 0;
+  atomic_compare_exchange_strong(&r->error, &expected, err);
+  atomic_store(&r->stop, 1);
+}
+
+// Inserts `w->key` into the visited set. Returns `1` and stores the new
+// entry in `entry` if the state was not visited before, `0` if it was and
+// `-1` if the set is full.
+static int visit(worker_t* w, uint64_t parent, uint64_t via, uint64_t* entry) {
+  reach_t* r = w->r;
+
+  if (w->pending == NO_ENTRY) {
+    size_t e = atomic_fetch_add(&r->next_entry, 1);
+    if (e >= r->max_entries) {
+      return -1;
+    }
+    w->pending = e;
+  }
+
+  uint64_t e = w->pending;
+  memcpy(r->keys + e * r->words, w->key, r->words * sizeof(bits_t));
+  r->parent[e] = parent;
+  r->via[e] = via;
+
+  size_t h = hash_key(w->key, r->words) & r->mask;
+  for (;;) {
+    uint64_t cur = atomic_load_explicit(&r->slots[h], memory_order_acquire);
+    if (cur == 0) {
+      if (atomic_compare_exchange_strong_explicit(&r->slots[h], &cur, e + 1,
+                                                  memory_order_acq_rel,
+                                                  memory_order_acquire)) {
+        w->pending = NO_ENTRY;
+        atomic_fetch_add(&r->count, 1);
+        *entry = e;
+        return 1;
+      }
+    }
+    if (memcmp(r->keys + (cur - 1) * r->words, w->key, r->words * sizeof(bits_t)) == 0) {
+      return 0;
+    }
+    h = (h + 1) & r->mask;
+  }
+}
+
+static bits_t* member_buf(worker_t* w, size_t i, size_t which) {
+  return w->scratch + w->r->scratch_off[4 * i + which];
+}
+
+static void pack_state(worker_t* w, size_t which) {
+  reach_t* r = w->r;
+  memset(w->key, 0, r->words * sizeof(bits_t));
+  for (size_t i = 0; i < r->num; ++i) {
+    copy_bits(w->key, r->state_pos[i], member_buf(w, i, which), 0, r->at[i]->state_bit_count);
+  }
+}
+
+static int flush_out(worker_t* w) {
+  if (w->out_len > 0 && frontier_push(w->r->next, w->out, w->out_len) == -1) {
+    return -1;
+  }
+  w->out_len = 0;
+  return 0;
+}
+
+// Expands a single visited state: checks the predicate and inserts
+// all of its successors.
+static int expand(worker_t* w, uint64_t e) {
+  reach_t* r = w->r;
+  const bits_t* key = r->keys + e * r->words;
+
+  for (size_t i = 0; i < r->num; ++i) {
+    moore_t* a = r->at[i];
+    bits_t* state = member_buf(w, i, 0);
+    memset(state, 0, bits_to_words(a->state_bit_count) * sizeof(bits_t));
+    copy_bits(state, 0, key, r->state_pos[i], a->state_bit_count);
+    a->out_func(member_buf(w, i, 3), state, a->num_output_bits, a->state_bit_count);
+    w->outputs[i] = member_buf(w, i, 3);
+  }
+
+  if (r->opts->predicate && r->opts->predicate(w->outputs, r->num, r->opts->ctx)) {
+    uint64_t expected = NO_ENTRY;
+    atomic_compare_exchange_strong(&r->found, &expected, e);
+    atomic_store(&r->stop, 1);
+    return 0;
+  }
+
+  // Gather connected inputs, these do not depend on the free input bits.
+  for (size_t i = 0; i < r->num; ++i) {
+    moore_t* a = r->at[i];
+    bits_t* input = member_buf(w, i, 2);
+    if (a->num_input_bits != 0) {
+      memcpy(input, a->input, bits_to_words(a->num_input_bits) * sizeof(bits_t));
+    }
+    for (size_t g = r->gather_begin[i]; g < r->gather_begin[i + 1]; ++g) {
+      const gather_t* gt = &r->gathers[g];
+      const bits_t* src = gt->ext ? gt->ext : member_buf(w, gt->driver, 3);
+      copy_bit(input, get_bit(src, gt->driver_bit), gt->bit);
+    }
+  }
+
+  uint64_t combinations = (uint64_t) 1 << r->num_free;
+  for (uint64_t x = 0; x < combinations && !atomic_load_explicit(&r->stop, memory_order_relaxed); ++x) {
+    for (size_t k = 0; k < r->num_free; ++k) {
+      copy_bit(member_buf(w, r->free_member[k], 2), (x >> k) & 1, r->free_bit[k]);
+    }
+    for (size_t i = 0; i < r->num; ++i) {
+      moore_t* a = r->at[i];
+      a->trans_func(member_buf(w, i, 1), member_buf(w, i, 2), member_buf(w, i, 0),
+                    a->num_input_bits, a->state_bit_count);
+    }
+    pack_state(w, 1);
+
+    uint64_t succ;
+    int res = visit(w, e, x, &succ);
+    if (res == -1) {
+      fail(r, ENOSPC);
+      return -1;
+    }
+    if (res == 1) {
+      w->out[w->out_len++] = succ;
+      if (w->out_len == BLOCK_LEN && flush_out(w) == -1) {
+        fail(r, errno);
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+static void* expand_level(void* arg) {
+  worker_t* w = arg;
+  reach_t* r = w->r;
+  size_t k;
+
+  while (!atomic_load(&r->stop)) {
+    if (frontier_pop(r->cur, w->block, BLOCK_LEN, &k) == -1) {
+      fail(r, errno);
+      break;
+    }
+    if (k == 0) {
+      break;
+    }
+    for (size_t i = 0; i < k && !atomic_load(&r->stop); ++i) {
+      expand(w, w->block[i]);
+    }
+  }
+  if (flush_out(w) == -1) {
+    fail(r, errno);
+  }
+
+  return NULL;
+}
+
+// Precomputes the packed layout and the input sources of every member.
+static int build_layout(reach_t* r) {
+  size_t bits = 0, off = 0, num_gathers = 0;
+
+  r->state_pos = malloc(r->num * sizeof(*r->state_pos));
+  r->scratch_off = malloc(4 * r->num * sizeof(*r->scratch_off));
+  r->gather_begin = malloc((r->num + 1) * sizeof(*r->gather_begin));
+  if (!r->state_pos || !r->scratch_off || !r->gather_begin) {
+    return -1;
+  }
+
+  for (size_t i = 0; i < r->num; ++i) {
+    moore_t* a = r->at[i];
+    r->state_pos[i] = bits;
+    bits += a->state_bit_count;
+
+    // The scratch buffers of padded members are laid out like their own.
+    size_t sizes[4] = {buffer_words(a, a->state_bit_count), buffer_words(a, a->state_bit_count),
+                       buffer_words(a, a->num_input_bits), buffer_words(a, a->num_output_bits)};
+    if (a->padded) {
+      off = (off + PAD_WORDS - 1) / PAD_WORDS * PAD_WORDS;
+    }
+    for (size_t j = 0; j < 4; ++j) {
+      r->scratch_off[4 * i + j] = off;
+      off += sizes[j];
+    }
+
+    for (size_t j = 0; j < a->num_input_bits; ++j) {
+      if (input_source(a, j).automaton) {
+        ++num_gathers;
+      } else {
+        ++r->num_free;
+      }
+    }
+  }
+
+  r->words = bits_to_words(bits);
+  r->scratch_words = off;
+
+  if (r->num_free > MAX_FREE_BITS) {
+    errno = E2BIG;
+    return -1;
+  }
+
+  r->gathers = malloc((num_gathers + 1) * sizeof(*r->gathers));
+  r->free_member = malloc((r->num_free + 1) * sizeof(*r->free_member));
+  r->free_bit = malloc((r->num_free + 1) * sizeof(*r->free_bit));
+  if (!r->gathers || !r->free_member || !r->free_bit) {
+    return -1;
+  }
+
+  size_t g = 0, f = 0;
+  for (size_t i = 0; i < r->num; ++i) {
+    moore_t* a = r->at[i];
+    r->gather_begin[i] = g;
+
+    for (size_t j = 0; j < a->num_input_bits; ++j) {
+      connection_t conn = input_source(a, j);
+      if (!conn.automaton) {
+        r->free_member[f] = i;
+        r->free_bit[f++] = j;
+        continue;
+      }
+
+      gather_t* gt = &r->gathers[g++];
+      gt->bit = j;
+      gt->driver_bit = conn.bit_idx;
+      gt->ext = conn.automaton->output;
+      for (size_t d = 0; d < r->num; ++d) {
+        if (r->at[d] == conn.automaton) {
+          gt->ext = NULL;
+          gt->driver = d;
+          break;
+        }
+      }
+    }
+  }
+  r->gather_begin[r->num] = g;
+
+  return 0;
+}
+
+static int build_visited(reach_t* r, size_t max_states, size_t num_threads) {
+  size_t capacity = 1;
+
+  r->max_entries = max_states + num_threads;
+  while (capacity < 2 * r->max_entries) {
+    capacity *= 2;
+  }
+  r->mask = capacity - 1;
+
+  r->keys = malloc(r->max_entries * r->words * sizeof(*r->keys));
+  r->parent = malloc(r->max_entries * sizeof(*r->parent));
+  r->via = malloc(r->max_entries * sizeof(*r->via));
+  r->slots = calloc(capacity, sizeof(*r->slots));
+
+  return r->keys && r->parent && r->via && r->slots ? 0 : -1;
+}
+
+static int init_worker(worker_t* w, reach_t* r) {
+  w->r = r;
+  w->pending = NO_ENTRY;
+  w->out_len = 0;
+  w->scratch = alloc_scratch(r->scratch_words);
+  w->key = malloc(r->words * sizeof(*w->key));
+  w->outputs = malloc(r->num * sizeof(*w->outputs));
+  w->block = malloc(BLOCK_LEN * sizeof(*w->block));
+  w->out = malloc(BLOCK_LEN * sizeof(*w->out));
+
+  return w->scratch && w->key && w->outputs && w->block && w->out ? 0 : -1;
+}
+
+static void destroy_worker(worker_t* w) {
+  free(w->scratch);
+  free(w->key);
+  free(w->outputs);
+  free(w->block);
+  free(w->out);
+}
+
+static int build_trace(reach_t* r, ma_reach_result_t* result) {
+  uint64_t e = atomic_load(&r->found);
+  size_t len = 0;
+
+  for (uint64_t cur = e; cur != NO_ENTRY; cur = r->parent[cur]) {
+    ++len;
+  }
+
+  result->trace_states = malloc(len * r->words * sizeof(bits_t));
+  result->trace_inputs = malloc(len * sizeof(bits_t));
+  if (!result->trace_states || !result->trace_inputs) {
+    return -1;
+  }
+
+  result->trace_len = len;
+  for (uint64_t cur = e; cur != NO_ENTRY; cur = r->parent[cur]) {
+    --len;
+    memcpy(result->trace_states + len * r->words, r->keys + cur * r->words,
+           r->words * sizeof(bits_t));
+    if (len > 0) {
+      result->trace_inputs[len - 1] = r->via[cur];
+    }
+  }
+
+  return 0;
+}
+
+// Runs the level-synchronous BFS. `workers` are fully initialized.
+static int explore(reach_t* r, worker_t* workers, size_t num_threads, ma_reach_result_t* result) {
+  worker_t* w = &workers[0];
+  pthread_t* threads = malloc(num_threads * sizeof(*threads));
+  if (!threads) {
+    return -1;
+  }
+
+  // Seed the search with the current global state.
+  for (size_t i = 0; i < r->num; ++i) {
+    memcpy(member_buf(w, i, 0), r->at[i]->state,
+           bits_to_words(r->at[i]->state_bit_count) * sizeof(bits_t));
+  }
+  pack_state(w, 0);
+
+  uint64_t root;
+  if (visit(w, NO_ENTRY, 0, &root) == -1) {
+    free(threads);
+    errno = ENOSPC;
+    return -1;
+  }
+  if (frontier_push(r->cur, &root, 1) == -1) {
+    free(threads);
+    return -1;
+  }
+
+  while (!atomic_load(&r->stop) && !frontier_empty(r->cur)) {
+    if (frontier_begin_read(r->cur) == -1) {
+      fail(r, errno);
+      break;
+    }
+
+    size_t started = 1;
+    for (; started < num_threads; ++started) {
+      if (pthread_create(&threads[started], NULL, expand_level, &workers[started]) != 0) {
+        break;
+      }
+    }
+    expand_level(&workers[0]);
+    for (size_t t = 1; t < started; ++t) {
+      pthread_join(threads[t], NULL);
+    }
+
+    ++result->depth;
+    frontier_reset(r->cur);
+    frontier_t* tmp = r->cur;
+    r->cur = r->next;
+    r->next = tmp;
+  }
+
+  free(threads);
+
+  if (atomic_load(&r->error) != 0) {
+    errno = atomic_load(&r->error);
+    return -1;
+  }
+
+  result->num_states = atomic_load(&r->count);
+  if (atomic_load(&r->found) != NO_ENTRY) {
+    result->found = 1;
+    return build_trace(r, result);
+  }
+
+  return 0;
+}
+
+static void destroy_reach(reach_t* r) {
+  free(r->state_pos);
+  free(r->scratch_off);
+  free(r->gather_begin);
+  free(r->gathers);
+  free(r->free_member);
+  free(r->free_bit);
+  free(r->keys);
+  free(r->parent);
+  free(r->via);
+  free(r->slots);
+}
+
+int ma_reach(moore_t* at[], size_t num, const ma_reach_opts_t* opts,
+             ma_reach_result_t* result) {
+  bool ok = at && num != 0 && opts && result;
+  for (size_t i = 0; i < num && ok; ++i) {
+    ok = at[i] != NULL;
+  }
+
+  if (!ok) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  memset(result, 0, sizeof(*result));
+
+  size_t num_threads = opts->num_threads == 0 ? 1 : opts->num_threads;
+  size_t max_states = opts->max_states == 0 ? DEFAULT_MAX_STATES : opts->max_states;
+  size_t limit = opts->memory_budget == 0 ? SIZE_MAX : opts->memory_budget / sizeof(uint64_t);
+
+  reach_t r = {.at = at, .num = num, .opts = opts};
+  atomic_init(&r.next_entry, 0);
+  atomic_init(&r.count, 0);
+  atomic_init(&r.stop, 0);
+  atomic_init(&r.error, 0);
+  atomic_init(&r.found, NO_ENTRY);
+
+  int ret = -1;
+  size_t initialized = 0;
+  worker_t* workers = NULL;
+
+  if (frontier_init(&r.frontier[0], limit) == -1) {
+    return -1;
+  }
+  if (frontier_init(&r.frontier[1], limit) == -1) {
+    frontier_destroy(&r.frontier[0]);
+    return -1;
+  }
+  r.cur = &r.frontier[0];
+  r.next = &r.frontier[1];
+
+  if (build_layout(&r) == -1) {
+    if (errno != E2BIG) {
+      errno = ENOMEM;
+    }
+    goto out;
+  }
+
+  if (build_visited(&r, max_states, num_threads) == -1 ||
+      !(workers = malloc(num_threads * sizeof(*workers)))) {
+    errno = ENOMEM;
+    goto out;
+  }
+
+  for (; initialized < num_threads; ++initialized) {
+    if (init_worker(&workers[initialized], &r) == -1) {
+      destroy_worker(&workers[initialized]);
+      errno = ENOMEM;
+      goto out;
+    }
+  }
+
+  ret = explore(&r, workers, num_threads, result);
+  result->state_words = r.words;
+
+out:
+  for (size_t t = 0; t < initialized; ++t) {
+    destroy_worker(&workers[t]);
+  }
+  free(workers);
+  destroy_reach(&r);
+  frontier_destroy(&r.frontier[0]);
+  frontier_destroy(&r.frontier[1]);
+
+  if (ret == -1) {
+    ma_reach_result_free(result);
+  }
+
+  return ret;
+}
+
+void ma_reach_result_free(ma_reach_result_t* result) {
+  if (!result) {
+    return;
+  }
+
+  free(result->trace_states);
+  free(result->trace_inputs);
+  result->trace_states = NULL;
+  result->trace_inputs = NULL;
+  result->trace_len = 0;
+}
@@ -0,0 +1,453 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define BARRIER_SPINS 1000
+
+// Header of the shared region. It is followed by two copies of the boundary
+// words (indexed by the parity of the cycle) and the result words.
+typedef struct {
+  _Alignas(64) atomic_uint count;       // Shards that reached the barrier.
+  _Alignas(64) atomic_uint generation;  // Futex word, incremented on release.
+  atomic_int abort;                     // Set by the parent when a shard failed.
+} shard_header_t;
+
+// The plan of a sharded run, computed before the shards are forked so that
+// they need no allocations.
+typedef struct {
+  size_t num_shards;
+  moore_t** members;         // Members grouped by shard, in group order.
+  size_t* positions;         // Group position of every entry of `members`.
+  size_t* member_first;      // Shard `c` owns members[member_first[c]..member_first[c + 1]).
+  size_t* proxies;           // Group positions of the remote drivers each shard mirrors,
+  size_t* proxy_first;       // indexed like `members`.
+  size_t* boundary_off;      // Offset of a member in a boundary copy, `SIZE_MAX` if unread remotely.
+  size_t boundary_words;
+  size_t* result_off;        // Offset of a member in the result words.
+  size_t result_words;
+} plan_t;
+
+static long futex(atomic_uint* addr, int op, unsigned val) {
+  return syscall(SYS_futex, (unsigned*) addr, op, val, NULL, NULL, 0);
+}
+
+// Waits until all shards arrive. Returns -1 if the run was aborted.
+static int barrier_wait(shard_header_t* h, unsigned num) {
+  unsigned gen = atomic_load(&h->generation);
+
+  // An abort after this check changes the generation, so it is not missed.
+  if (atomic_load(&h->abort)) {
+    return -1;
+  }
+
+  if (atomic_fetch_add(&h->count, 1) + 1 == num) {
+    atomic_store(&h->count, 0);
+    atomic_fetch_add(&h->generation, 1);
+    futex(&h->generation, FUTEX_WAKE, INT_MAX);
+  } else {
+    for (int i = 0; i < BARRIER_SPINS && atomic_load(&h->generation) == gen; ++i) {
+      sched_yield();
+    }
+    while (atomic_load(&h->generation) == gen) {
+      futex(&h->generation, FUTEX_WAIT, gen);
+    }
+  }
+
+  return atomic_load(&h->abort) ? -1 : 0;
+}
+
+static void release_all(shard_header_t* h) {
+  atomic_store(&h->abort, 1);
+  atomic_fetch_add(&h->generation, 1);
+  futex(&h->generation, FUTEX_WAKE, INT_MAX);
+}
+
+static size_t member_words(const moore_t* a) {
+  return bits_to_words(a->state_bit_count) + bits_to_words(a->num_input_bits) +
+         bits_to_words(a->num_output_bits);
+}
+
+static void free_plan(plan_t* p) {
+  free(p->members);
+  free(p->positions);
+  free(p->member_first);
+  free(p->proxies);
+  free(p->proxy_first);
+  free(p->boundary_off);
+  free(p->result_off);
+}
+
+// Appends the remote drivers of shard `c` to `p->proxies` (or only counts
+// them if `p->proxies` is NULL). `seen` must not contain `c + 1` initially.
+static size_t find_proxies(const ma_group_t* g, const member_entry_t* index,
+                           const size_t* shard_of, plan_t* p, size_t c, size_t* seen,
+                           size_t pos) {
+  for (size_t i = p->member_first[c]; i < p->member_first[c + 1]; ++i) {
+    const moore_t* a = p->members[i];
+    for (size_t j = 0; j < a->num_input_bits; ++j) {
+      const moore_t* driver = input_source(a, j).automaton;
+      size_t d = driver ? find_member(index, g->num, driver) : SIZE_MAX;
+      if (d == SIZE_MAX || shard_of[d] == c || seen[d] == c + 1) {
+        continue;
+      }
+      seen[d] = c + 1;
+      if (p->proxies) {
+        p->proxies[pos] = d;
+      } else {
+        p->boundary_off[d] = 0;
+      }
+      ++pos;
+    }
+  }
+  return pos;
+}
+
+static int make_plan(const ma_group_t* g, const size_t* shard_of, plan_t* p) {
+  size_t n = g->num, k = p->num_shards;
+  member_entry_t* index = build_member_index(g);
+  size_t* seen = calloc(n, sizeof(*seen));
+  p->members = malloc(n * sizeof(*p->members));
+  p->positions = malloc(n * sizeof(*p->positions));
+  p->member_first = calloc(k + 1, sizeof(*p->member_first));
+  p->proxy_first = calloc(k + 1, sizeof(*p->proxy_first));
+  p->boundary_off = malloc(n * sizeof(*p->boundary_off));
+  p->result_off = malloc(n * sizeof(*p->result_off));
+  int ret = -1;
+
+  if (!index || !seen || !p->members || !p->positions || !p->member_first || !p->proxy_first ||
+      !p->boundary_off || !p->result_off) {
+    errno = ENOMEM;
+    goto exit;
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    ++p->member_first[shard_of[i] + 1];
+    p->boundary_off[i] = SIZE_MAX;
+    p->result_off[i] = p->result_words;
+    p->result_words += member_words(g->automata[i]);
+  }
+  for (size_t c = 0; c < k; ++c) {
+    p->member_first[c + 1] += p->member_first[c];
+  }
+  for (size_t i = 0, c = 0; c < k; ++c) {
+    for (size_t j = 0; j < n; ++j) {
+      if (shard_of[j] == c) {
+        p->positions[i] = j;
+        p->members[i++] = g->automata[j];
+      }
+    }
+  }
+
+  // Count the proxies of every shard and mark the boundary members.
+  for (size_t c = 0; c < k; ++c) {
+    p->proxy_first[c + 1] = find_proxies(g, index, shard_of, p, c, seen, p->proxy_first[c]);
+  }
+  for (size_t i = 0; i < n; ++i) {
+    if (p->boundary_off[i] != SIZE_MAX) {
+      p->boundary_off[i] = p->boundary_words;
+      p->boundary_words += bits_to_words(g->automata[i]->num_output_bits);
+    }
+  }
+
+  if (!(p->proxies = malloc((p->proxy_first[k] + 1) * sizeof(*p->proxies)))) {
+    errno = ENOMEM;
+    goto exit;
+  }
+  memset(seen, 0, n * sizeof(*seen));
+  for (size_t c = 0; c < k; ++c) {
+    find_proxies(g, index, shard_of, p, c, seen, p->proxy_first[c]);
+  }
+
+  ret = 0;
+
+exit:
+  free(index);
+  free(seen);
+  return ret;
+}
+
+static void copy_words(bits_t* dst, const bits_t* src, size_t words) {
+  if (words != 0) {
+    memcpy(dst, src, words * sizeof(bits_t));
+  }
+}
+
+// Body of the process of shard `c`. Never returns.
+static void run_shard(const ma_group_t* g, const plan_t* p, size_t c, shard_header_t* h,
+                      bits_t* boundary, bits_t* results, size_t cycles) {
+  size_t first = p->member_first[c], num = p->member_first[c + 1] - first;
+
+  for (size_t k = 0; k < cycles; ++k) {
+    // Mirror the outputs the remote drivers had after the previous cycle.
+    const bits_t* in = boundary + (k & 1) * p->boundary_words;
+    for (size_t i = p->proxy_first[c]; i < p->proxy_first[c + 1]; ++i) {
+      moore_t* a = g->automata[p->proxies[i]];
+      copy_words(a->output, in + p->boundary_off[p->proxies[i]],
+                 bits_to_words(a->num_output_bits));
+    }
+
+    if (num != 0) {
+      step_automata(p->members + first, num);
+    }
+
+    bits_t* out = boundary + ((k + 1) & 1) * p->boundary_words;
+    for (size_t i = first; i < first + num; ++i) {
+      size_t pos = p->positions[i];
+      if (p->boundary_off[pos] != SIZE_MAX) {
+        copy_words(out + p->boundary_off[pos], p->members[i]->output,
+                   bits_to_words(p->members[i]->num_output_bits));
+      }
+    }
+
+    if (barrier_wait(h, p->num_shards) == -1) {
+      _exit(1);
+    }
+  }
+
+  for (size_t i = first; i < first + num; ++i) {
+    const moore_t* a = p->members[i];
+    bits_t* dst = results + p->result_off[p->positions[i]];
+    copy_words(dst, a->state, bits_to_words(a->state_bit_count));
+    dst += bits_to_words(a->state_bit_count);
+    copy_words(dst, a->input, bits_to_words(a->num_input_bits));
+    dst += bits_to_words(a->num_input_bits);
+    copy_words(dst, a->output, bits_to_words(a->num_output_bits));
+  }
+
+  _exit(0);
+}
+
+// Copies the results of the shards back into the members of `g`.
+static void collect(ma_group_t* g, const plan_t* p, const bits_t* results, size_t cycles) {
+  slab_written(g);
+  for (size_t i = 0; i < g->num; ++i) {
+    moore_t* a = g->automata[i];
+    const bits_t* src = results + p->result_off[i];
+    copy_words(a->state, src, bits_to_words(a->state_bit_count));
+    src += bits_to_words(a->state_bit_count);
+    copy_words(a->input, src, bits_to_words(a->num_input_bits));
+    src += bits_to_words(a->num_input_bits);
+    copy_words(a->output, src, bits_to_words(a->num_output_bits));
+    a->cycle += cycles;
+    unfold(a);
+  }
+  g->cycle += cycles;
+}
+
+// Maps a new POSIX shared-memory region of `len` bytes.
+static void* map_shared(size_t len) {
+  char name[64];
+  static atomic_uint counter;
+  snprintf(name, sizeof(name), "/ma_shard_%ld_%u", (long) getpid(), atomic_fetch_add(&counter, 1));
+
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd == -1) {
+    return NULL;
+  }
+  // The forked shards inherit the mapping, so the name is not needed.
+  shm_unlink(name);
+
+  void* base = ftruncate(fd, len) == -1 ? MAP_FAILED
+               : mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  int err = errno;
+  close(fd);
+  if (base == MAP_FAILED) {
+    errno = err;
+    return NULL;
+  }
+  return base;
+}
+
+static bool shard_failed(int status) {
+  return !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+}
+
+// Waits for the `num` shards in the order they exit, so that the first one
+// that fails releases the others from the barrier. The shards are watched
+// through pidfds rather than `waitpid(-1, ...)`, which could reap children
+// of the application. Returns -1 if any of them failed.
+static int reap_shards(shard_header_t* h, const pid_t* pids, size_t num) {
+  struct pollfd* fds = calloc(num == 0 ? 1 : num, sizeof(*fds));
+  int ret = 0, err = fds ? 0 : ENOMEM;
+
+  for (size_t i = 0; fds && i < num; ++i) {
+    fds[i].fd = (int) syscall(SYS_pidfd_open, pids[i], 0);
+    fds[i].events = POLLIN;
+    if (fds[i].fd == -1 && err == 0) {
+      err = errno;
+    }
+  }
+
+  if (err != 0) {
+    // Without a way to watch every shard, the run is aborted.
+    release_all(h);
+    for (size_t i = 0; i < num; ++i) {
+      int status;
+      waitpid(pids[i], &status, 0);
+      if (fds && fds[i].fd != -1) {
+        close(fds[i].fd);
+      }
+    }
+    free(fds);
+    errno = err;
+    return -1;
+  }
+
+  for (size_t left = num; left != 0;) {
+    if (poll(fds, num, -1) == -1) {
+      continue;
+    }
+    for (size_t i = 0; i < num; ++i) {
+      if (fds[i].fd == -1 || !(fds[i].revents & (POLLIN | POLLHUP))) {
+        continue;
+      }
+      int status;
+      if (waitpid(pids[i], &status, 0) == -1 || shard_failed(status)) {
+        if (ret == 0) {
+          release_all(h);
+        }
+        ret = -1;
+      }
+      close(fds[i].fd);
+      // A negative descriptor is ignored by `poll`.
+      fds[i].fd = -1;
+      --left;
+    }
+  }
+
+  free(fds);
+  if (ret == -1) {
+    errno = EIO;
+  }
+  return ret;
+}
+
+// Forks the shards and waits for them. Returns -1 if any of them failed.
+static int run_shards(ma_group_t* g, const plan_t* p, shard_header_t* h, bits_t* boundary,
+                      bits_t* results, size_t cycles) {
+  pid_t* pids = malloc(p->num_shards * sizeof(*pids));
+  size_t started = 0;
+  int err = 0;
+
+  if (!pids) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  for (; started < p->num_shards; ++started) {
+    pids[started] = fork();
+    if (pids[started] == 0) {
+      run_shard(g, p, started, h, boundary, results, cycles);
+    }
+    if (pids[started] == -1) {
+      err = errno;
+      release_all(h);
+      break;
+    }
+  }
+
+  if (reap_shards(h, pids, started) == -1 && err == 0) {
+    err = errno;
+  }
+
+  free(pids);
+  if (err != 0) {
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
+
+int ma_run_sharded(ma_group_t* g, const size_t shard_of[], size_t num_shards, size_t cycles) {
+  if (!g || !shard_of || num_shards == 0 || num_shards > UINT_MAX) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (size_t i = 0; i < g->num; ++i) {
+    if (shard_of[i] >= num_shards) {
+      errno = EINVAL;
+      return -1;
+    }
+  }
+
+  // Input ports, generators and recorders would only see the copies in the shards.
+  bool busy = g->trace || g->rewind || g->view || async_busy(g);
+  for (size_t i = 0; i < g->num && !busy; ++i) {
+    busy = g->automata[i]->port || g->automata[i]->stim;
+  }
+  if (busy) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  if (group_prepare(g) == -1) {
+    return -1;
+  }
+  if (g->hyperperiod > 1) {
+    errno = ENOTSUP;
+    return -1;
+  }
+
+  if (cycles == 0 || g->num == 0) {
+    g->cycle += cycles;
+    return 0;
+  }
+
+  plan_t p = {.num_shards = num_shards};
+  int ret = -1;
+  void* base = NULL;
+  size_t len = 0;
+
+  if (make_plan(g, shard_of, &p) == -1) {
+    goto exit;
+  }
+
+  len = sizeof(shard_header_t) + (2 * p.boundary_words + p.result_words) * sizeof(bits_t);
+  if (!(base = map_shared(len))) {
+    goto exit;
+  }
+
+  shard_header_t* h = base;
+  atomic_init(&h->count, 0);
+  atomic_init(&h->generation, 0);
+  atomic_init(&h->abort, 0);
+  bits_t* boundary = (bits_t*) (h + 1);
+  bits_t* results = boundary + 2 * p.boundary_words;
+
+  // The shards start from the current outputs.
+  for (size_t i = 0; i < g->num; ++i) {
+    if (p.boundary_off[i] != SIZE_MAX) {
+      copy_words(boundary + p.boundary_off[i], g->automata[i]->output,
+                 bits_to_words(g->automata[i]->num_output_bits));
+    }
+  }
+
+  if (run_shards(g, &p, h, boundary, results, cycles) == -1) {
+    goto exit;
+  }
+
+  collect(g, &p, results, cycles);
+  ret = 0;
+
+exit:;
+  int err = errno;
+  if (base) {
+    munmap(base, len);
+  }
+  free_plan(&p);
+  errno = err;
+  return ret;
+}
@@ -0,0 +1,312 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A snapshot is the group cycle followed by the state, input and output
+// words of every member in group order.
+
+struct ma_rewind {
+  ma_group_t* group;
+  size_t interval;           // Number of cycles between keyframes.
+  size_t words;              // Length of a snapshot in words.
+  uint64_t start;            // Cycle of the first keyframe.
+  int error;                 // Set when recording failed; later cycles are lost.
+
+  bits_t* shadow;            // Snapshot of the last recorded cycle.
+  bits_t* scratch;
+
+  bits_t* keyframes;
+  size_t num_keyframes;
+  size_t keyframes_cap;
+
+  uint64_t* log;             // Pairs (word index, value) of per-step changes.
+  size_t log_len;
+  size_t log_cap;
+
+  size_t* cycle_end;         // `log_len` after each recorded cycle.
+  size_t num_cycles;
+  size_t cycle_cap;
+};
+
+static size_t snapshot_words(const ma_group_t* g) {
+  size_t words = 1;
+  for (size_t i = 0; i < g->num; ++i) {
+    const moore_t* a = g->automata[i];
+    words += bits_to_words(a->state_bit_count) + bits_to_words(a->num_input_bits) +
+             bits_to_words(a->num_output_bits);
+  }
+  return words;
+}
+
+static void take_snapshot(const ma_group_t* g, bits_t* buf) {
+  *buf++ = g->cycle;
+  for (size_t i = 0; i < g->num; ++i) {
+    const moore_t* a = g->automata[i];
+    size_t sizes[3] = {bits_to_words(a->state_bit_count), bits_to_words(a->num_input_bits),
+                       bits_to_words(a->num_output_bits)};
+    const bits_t* src[3] = {a->state, a->input, a->output};
+    for (size_t j = 0; j < 3; ++j) {
+      if (sizes[j] != 0) {
+        memcpy(buf, src[j], sizes[j] * sizeof(bits_t));
+      }
+      buf += sizes[j];
+    }
+  }
+}
+
+static void restore_snapshot(ma_group_t* g, const bits_t* buf) {
+  slab_written(g);
+  g->cycle = *buf++;
+  for (size_t i = 0; i < g->num; ++i) {
+    moore_t* a = g->automata[i];
+    unfold(a);
+    size_t sizes[3] = {bits_to_words(a->state_bit_count), bits_to_words(a->num_input_bits),
+                       bits_to_words(a->num_output_bits)};
+    bits_t* dst[3] = {a->state, a->input, a->output};
+    for (size_t j = 0; j < 3; ++j) {
+      if (sizes[j] != 0) {
+        memcpy(dst[j], buf, sizes[j] * sizeof(bits_t));
+      }
+      buf += sizes[j];
+    }
+  }
+
+  if (g->view) {
+    view_publish(g->view);
+  }
+}
+
+size_t ma_snapshot_size(const ma_group_t* g) {
+  if (!g) {
+    errno = EINVAL;
+    return 0;
+  }
+
+  return snapshot_words(g) * sizeof(bits_t);
+}
+
+int ma_snapshot(const ma_group_t* g, bits_t* buf) {
+  if (!g || !buf) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (async_busy(g)) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  take_snapshot(g, buf);
+  return 0;
+}
+
+// Makes room for `need` elements of size `elem` in the dynamic array `*arr`.
+static int reserve(void* arr, size_t* cap, size_t need, size_t elem) {
+  if (need <= *cap) {
+    return 0;
+  }
+
+  size_t new_cap = *cap == 0 ? 16 : *cap;
+  while (new_cap < need) {
+    new_cap *= 2;
+  }
+
+  void* tmp = realloc(*(void**) arr, new_cap * elem);
+  if (!tmp) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  *(void**) arr = tmp;
+  *cap = new_cap;
+  return 0;
+}
+
+static int add_keyframe(ma_rewind_t* r, const bits_t* snapshot) {
+  if (reserve(&r->keyframes, &r->keyframes_cap, (r->num_keyframes + 1) * r->words,
+              sizeof(bits_t)) == -1) {
+    return -1;
+  }
+
+  memcpy(r->keyframes + r->num_keyframes * r->words, snapshot, r->words * sizeof(bits_t));
+  ++r->num_keyframes;
+  return 0;
+}
+
+static int add_cycle(ma_rewind_t* r) {
+  if (reserve(&r->cycle_end, &r->cycle_cap, r->num_cycles + 1, sizeof(size_t)) == -1) {
+    return -1;
+  }
+
+  r->cycle_end[r->num_cycles++] = r->log_len;
+  return 0;
+}
+
+void rewind_record(ma_rewind_t* r) {
+  if (r->error != 0) {
+    return;
+  }
+
+  take_snapshot(r->group, r->scratch);
+
+  if (r->num_cycles % r->interval == 0) {
+    if (add_keyframe(r, r->scratch) == -1) {
+      r->error = ENOMEM;
+      return;
+    }
+  } else {
+    // The cycle word at index 0 is implied by the position in the log.
+    for (size_t w = 1; w < r->words; ++w) {
+      if (r->scratch[w] == r->shadow[w]) {
+        continue;
+      }
+      if (reserve(&r->log, &r->log_cap, r->log_len + 2, sizeof(uint64_t)) == -1) {
+        r->error = ENOMEM;
+        return;
+      }
+      r->log[r->log_len++] = w;
+      r->log[r->log_len++] = r->scratch[w];
+    }
+  }
+
+  if (add_cycle(r) == -1) {
+    r->error = ENOMEM;
+    return;
+  }
+
+  bits_t* tmp = r->shadow;
+  r->shadow = r->scratch;
+  r->scratch = tmp;
+}
+
+// Keeps the first `len` recorded cycles, `len > 0`, and loads the last of
+// them into the shadow.
+static void truncate_history(ma_rewind_t* r, size_t len) {
+  size_t idx = len - 1;
+  size_t key = idx / r->interval;
+
+  // Replay the deltas forward from the nearest keyframe into the shadow.
+  memcpy(r->shadow, r->keyframes + key * r->words, r->words * sizeof(bits_t));
+  size_t from = r->cycle_end[key * r->interval];
+  for (size_t pos = from; pos < r->cycle_end[idx]; pos += 2) {
+    r->shadow[r->log[pos]] = r->log[pos + 1];
+  }
+  r->shadow[0] = r->start + idx;
+
+  r->num_keyframes = key + 1;
+  r->num_cycles = len;
+  r->log_len = r->cycle_end[idx];
+  r->error = 0;
+}
+
+static void rewind_restored(ma_rewind_t* r) {
+  uint64_t cycle = r->group->cycle;
+
+  // The recorded cycles must stay consecutive: those from the restored one
+  // on are dropped, and without any before it the history starts over.
+  if (cycle > r->start && cycle - r->start <= r->num_cycles) {
+    truncate_history(r, cycle - r->start);
+  } else {
+    r->start = cycle;
+    r->num_keyframes = 0;
+    r->num_cycles = 0;
+    r->log_len = 0;
+    r->error = 0;
+  }
+  rewind_record(r);
+}
+
+int ma_restore(ma_group_t* g, const bits_t* buf) {
+  if (!g || !buf) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (async_busy(g)) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  restore_snapshot(g, buf);
+  if (g->rewind) {
+    rewind_restored(g->rewind);
+  }
+  return 0;
+}
+
+static void destroy_rewind(ma_rewind_t* r) {
+  free(r->shadow);
+  free(r->scratch);
+  free(r->keyframes);
+  free(r->log);
+  free(r->cycle_end);
+  free(r);
+}
+
+ma_rewind_t* ma_rewind_start(ma_group_t* g, size_t keyframe_interval) {
+  if (!g || keyframe_interval == 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (g->rewind) {
+    errno = EBUSY;
+    return NULL;
+  }
+
+  ma_rewind_t* r = calloc(1, sizeof(*r));
+  if (!r) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  r->group = g;
+  r->interval = keyframe_interval;
+  r->words = snapshot_words(g);
+  r->start = g->cycle;
+  r->shadow = malloc(r->words * sizeof(*r->shadow));
+  r->scratch = malloc(r->words * sizeof(*r->scratch));
+  if (!r->shadow || !r->scratch) {
+    destroy_rewind(r);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  // The current cycle becomes the first keyframe.
+  rewind_record(r);
+  if (r->error != 0) {
+    destroy_rewind(r);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  g->rewind = r;
+  return r;
+}
+
+int ma_rewind_to(ma_rewind_t* r, uint64_t cycle) {
+  if (!r || cycle < r->start || cycle - r->start >= r->num_cycles) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (async_busy(r->group)) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  // Forget the future; recording continues from the restored cycle.
+  truncate_history(r, cycle - r->start + 1);
+  restore_snapshot(r->group, r->shadow);
+  return 0;
+}
+
+void ma_rewind_stop(ma_rewind_t* r) {
+  if (!r) {
+    return;
+  }
+
+  r->group->rewind = NULL;
+  destroy_rewind(r);
+}
@@ -0,0 +1,144 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <string.h>
+
+#ifdef MA_STATS
+
+// Returns the fan-out histogram bucket of an output bit.
+static size_t fan_out_bucket(size_t fan_out) {
+  size_t bucket = 0;
+  while (fan_out != 0 && bucket + 1 < MA_STATS_BUCKETS) {
+    fan_out >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+int ma_stats_get(const ma_group_t* g, ma_stats_t* stats) {
+  if (!g || !stats) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  memset(stats, 0, sizeof(*stats));
+  stats->steps = g->steps;
+  stats->step_ns_total = g->step_ns_total;
+  memcpy(stats->step_ns_hist, g->step_ns_hist, sizeof(stats->step_ns_hist));
+
+  for (size_t i = 0; i < g->num; ++i) {
+    const moore_t* a = g->automata[i];
+    for (size_t j = 0; j < a->num_input_bits; ++j) {
+      stats->connections += input_source(a, j).automaton != NULL;
+    }
+    for (size_t j = 0; j < a->num_output_bits; ++j) {
+      // Members of a clone do not record their fan-out.
+      size_t fan_out = a->cloned ? 0 : a->output_connections[j].sz;
+      ++stats->fan_out_hist[fan_out_bucket(fan_out)];
+      if (fan_out > stats->max_fan_out) {
+        stats->max_fan_out = fan_out;
+      }
+    }
+  }
+
+  return 0;
+}
+
+int ma_stats_automaton(const moore_t* a, ma_automaton_stats_t* stats) {
+  if (!a || !stats) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  *stats = a->stats;
+  return 0;
+}
+
+int ma_stats_reset(ma_group_t* g) {
+  if (!g) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  g->steps = 0;
+  g->step_ns_total = 0;
+  memset(g->step_ns_hist, 0, sizeof(g->step_ns_hist));
+  for (size_t i = 0; i < g->num; ++i) {
+    memset(&g->automata[i]->stats, 0, sizeof(g->automata[i]->stats));
+  }
+
+  return 0;
+}
+
+static void dump_array(FILE* out, const char* name, const void* values, size_t num, bool sizes) {
+  fprintf(out, "\"%s\": [", name);
+  for (size_t i = 0; i < num; ++i) {
+    unsigned long long v = sizes ? ((const size_t*) values)[i] : ((const uint64_t*) values)[i];
+    fprintf(out, "%s%llu", i == 0 ? "" : ", ", v);
+  }
+  fputc(']', out);
+}
+
+int ma_stats_dump_json(const ma_group_t* g, FILE* out) {
+  ma_stats_t stats;
+
+  if (!out || ma_stats_get(g, &stats) == -1) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  fprintf(out, "{\"steps\": %llu, \"step_ns_total\": %llu, ",
+          (unsigned long long) stats.steps, (unsigned long long) stats.step_ns_total);
+  dump_array(out, "step_ns_hist", stats.step_ns_hist, MA_STATS_BUCKETS, false);
+  fprintf(out, ", \"connections\": %zu, \"max_fan_out\": %zu, ",
+          stats.connections, stats.max_fan_out);
+  dump_array(out, "fan_out_hist", stats.fan_out_hist, MA_STATS_BUCKETS, true);
+  fprintf(out, ", \"automata\": [");
+
+  for (size_t i = 0; i < g->num; ++i) {
+    const moore_t* a = g->automata[i];
+    size_t fan_out = 0;
+    for (size_t j = 0; j < a->num_output_bits && !a->cloned; ++j) {
+      fan_out += a->output_connections[j].sz;
+    }
+    fprintf(out,
+            "%s\n  {\"index\": %zu, \"n\": %zu, \"m\": %zu, \"s\": %zu, "
+            "\"trans_calls\": %llu, \"out_calls\": %llu, \"trans_cycles\": %llu, "
+            "\"out_cycles\": %llu, \"gathered_bits\": %llu, \"fan_out\": %zu}",
+            i == 0 ? "" : ",", i, a->num_input_bits, a->num_output_bits, a->state_bit_count,
+            (unsigned long long) a->stats.trans_calls, (unsigned long long) a->stats.out_calls,
+            (unsigned long long) a->stats.trans_cycles, (unsigned long long) a->stats.out_cycles,
+            (unsigned long long) a->stats.gathered_bits, fan_out);
+  }
+  fprintf(out, "\n]}\n");
+
+  if (ferror(out)) {
+    errno = EIO;
+    return -1;
+  }
+
+  return 0;
+}
+
+#else
+
+int ma_stats_get(const ma_group_t*, ma_stats_t*) {
+  errno = ENOTSUP;
+  return -1;
+}
+
+int ma_stats_automaton(const moore_t*, ma_automaton_stats_t*) {
+  errno = ENOTSUP;
+  return -1;
+}
+
+int ma_stats_reset(ma_group_t*) {
+  errno = ENOTSUP;
+  return -1;
+}
+
+int ma_stats_dump_json(const ma_group_t*, FILE*) {
+  errno = ENOTSUP;
+  return -1;
+}
+
+#endif
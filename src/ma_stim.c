@@ -0,0 +1,219 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Random words are drawn from `LANES` xoshiro256** generators stepped side
+// by side, with their states laid out by word, so that the compiler can keep
+// the lanes in vector registers.
+#define LANES 4
+
+// Maximal-length taps of a 64-bit Galois LFSR: x^64 + x^63 + x^61 + x^60 + 1.
+#define DEFAULT_TAPS 0xd800000000000000u
+
+struct ma_stim {
+  moore_t* automaton;
+  ma_stim_t* next;           // Next generator of the automaton.
+  ma_stim_kind_t kind;
+  size_t in;
+  size_t num;
+  size_t words;              // Words of the generated vector.
+  uint64_t value;            // Register of the LFSR or value of the counter.
+  uint64_t param;
+  uint64_t lanes[4][LANES];  // Word `k` of the state of lane `l` is `lanes[k][l]`.
+  uint64_t pool[LANES];      // Random words not used yet, from `pool_pos`.
+  size_t pool_pos;
+  bits_t* vectors;           // `len` vectors of `words` words to replay.
+  size_t len;
+  size_t pos;
+  bits_t* vec;               // The vector of the current step.
+};
+
+// Steps every lane once, refilling the pool.
+static void refill(ma_stim_t* s) {
+  uint64_t (*st)[LANES] = s->lanes;
+  for (size_t l = 0; l < LANES; ++l) {
+    s->pool[l] = rotl64(st[1][l] * 5, 7) * 9;
+    uint64_t t = st[1][l] << 17;
+    st[2][l] ^= st[0][l];
+    st[3][l] ^= st[1][l];
+    st[1][l] ^= st[2][l];
+    st[0][l] ^= st[3][l];
+    st[2][l] ^= t;
+    st[3][l] = rotl64(st[3][l], 45);
+  }
+  s->pool_pos = 0;
+}
+
+static void fill_random(ma_stim_t* s) {
+  for (size_t w = 0; w < s->words; ++w) {
+    if (s->pool_pos == LANES) {
+      refill(s);
+    }
+    s->vec[w] = s->pool[s->pool_pos++];
+  }
+}
+
+// Produces the vector of the next step.
+static const bits_t* generate(ma_stim_t* s) {
+  switch (s->kind) {
+    case MA_STIM_RANDOM:
+      fill_random(s);
+      return s->vec;
+    case MA_STIM_LFSR:
+      s->value = (s->value >> 1) ^ (-(s->value & 1) & s->param);
+      s->vec[0] = s->value;
+      return s->vec;
+    case MA_STIM_COUNTER:
+      s->vec[0] = s->value;
+      s->value += s->param;
+      return s->vec;
+    case MA_STIM_REPLAY: {
+      const bits_t* v = s->vectors + s->pos * s->words;
+      s->pos = s->pos + 1 == s->len ? 0 : s->pos + 1;
+      return v;
+    }
+  }
+  return s->vec;
+}
+
+void apply_stimuli(moore_t* a) {
+  for (ma_stim_t* s = a->stim; s; s = s->next) {
+    copy_bits(a->input, s->in, generate(s), 0, s->num);
+  }
+  unfold(a);
+}
+
+static void seed_lanes(ma_stim_t* s, uint64_t seed, uint64_t stream) {
+  rng_t rng;
+  rng_seed(&rng, seed);
+  for (uint64_t i = 0; i < stream; ++i) {
+    for (size_t l = 0; l < LANES; ++l) {
+      rng_jump(&rng);
+    }
+  }
+  for (size_t l = 0; l < LANES; ++l) {
+    for (size_t k = 0; k < 4; ++k) {
+      s->lanes[k][l] = rng.s[k];
+    }
+    rng_jump(&rng);
+  }
+  s->pool_pos = LANES;
+}
+
+// Returns true if inputs [`in`, `in + num`) of `a` are free and not driven
+// by another generator.
+static bool is_free_range(const moore_t* a, size_t in, size_t num) {
+  for (size_t j = in; j < in + num; ++j) {
+    if (input_source(a, j).automaton) {
+      return false;
+    }
+  }
+  for (const ma_stim_t* s = a->stim; s; s = s->next) {
+    if (in < s->in + s->num && s->in < in + num) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool is_valid_stim(const moore_t* a, const ma_stim_spec_t* spec) {
+  if (spec->num == 0 || spec->num > SIZE_MAX - spec->in ||
+      spec->in + spec->num > a->num_input_bits) {
+    return false;
+  }
+
+  switch (spec->kind) {
+    case MA_STIM_RANDOM:
+      return true;
+    case MA_STIM_LFSR:
+    case MA_STIM_COUNTER:
+      return spec->num <= BITS_PER_WORD;
+    case MA_STIM_REPLAY:
+      return spec->vectors && spec->len != 0;
+  }
+  return false;
+}
+
+static void destroy_stim(ma_stim_t* s) {
+  free(s->vectors);
+  free(s->vec);
+  free(s);
+}
+
+ma_stim_t* ma_stim_open(moore_t* a, const ma_stim_spec_t* spec) {
+  if (!a || !spec || !is_valid_stim(a, spec)) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (a->cloned) {
+    errno = EPERM;
+    return NULL;
+  }
+
+  if (!is_free_range(a, spec->in, spec->num)) {
+    errno = EBUSY;
+    return NULL;
+  }
+
+  ma_stim_t* s = calloc(1, sizeof(*s));
+  if (!s) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  s->automaton = a;
+  s->kind = spec->kind;
+  s->in = spec->in;
+  s->num = spec->num;
+  s->words = bits_to_words(spec->num);
+  s->vec = malloc(s->words * sizeof(*s->vec));
+  if (!s->vec) {
+    destroy_stim(s);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  switch (spec->kind) {
+    case MA_STIM_RANDOM:
+      seed_lanes(s, spec->seed, spec->stream);
+      break;
+    case MA_STIM_LFSR:
+      // The register of an LFSR must not be zero.
+      s->value = spec->seed == 0 ? 1 : spec->seed;
+      s->param = spec->param == 0 ? DEFAULT_TAPS : spec->param;
+      break;
+    case MA_STIM_COUNTER:
+      s->value = spec->seed;
+      s->param = spec->param;
+      break;
+    case MA_STIM_REPLAY:
+      s->len = spec->len;
+      if (s->words > SIZE_MAX / sizeof(bits_t) / s->len ||
+          !(s->vectors = malloc(s->len * s->words * sizeof(bits_t)))) {
+        destroy_stim(s);
+        errno = ENOMEM;
+        return NULL;
+      }
+      memcpy(s->vectors, spec->vectors, s->len * s->words * sizeof(bits_t));
+      break;
+  }
+
+  s->next = a->stim;
+  a->stim = s;
+  return s;
+}
+
+void ma_stim_close(ma_stim_t* s) {
+  if (!s) {
+    return;
+  }
+
+  ma_stim_t** link = &s->automaton->stim;
+  while (*link != s) {
+    link = &(*link)->next;
+  }
+  *link = s->next;
+  destroy_stim(s);
+}
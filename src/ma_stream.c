@@ -0,0 +1,200 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct {
+  int fd;
+  bits_t* base;
+  size_t len;                // Length of the mapping in bytes.
+} mapping_t;
+
+static bool is_valid_map(const ma_stream_map_t* map, bool input) {
+  if (!map->path || !map->automata || map->num == 0) {
+    return false;
+  }
+
+  for (size_t i = 0; i < map->num; ++i) {
+    if (!map->automata[i] || (input && map->automata[i]->num_input_bits == 0)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Returns the number of words of a single cycle record of `map`.
+static size_t record_words(const ma_stream_map_t* map, bool input) {
+  size_t words = 0;
+  for (size_t i = 0; i < map->num; ++i) {
+    const moore_t* a = map->automata[i];
+    words += bits_to_words(input ? a->num_input_bits : a->num_output_bits);
+  }
+  return words;
+}
+
+static void unmap(mapping_t* m) {
+  if (m->base) {
+    munmap(m->base, m->len);
+  }
+  if (m->fd != -1) {
+    close(m->fd);
+  }
+}
+
+static int map_input(mapping_t* m, const char* path, size_t len) {
+  struct stat st;
+
+  if ((m->fd = open(path, O_RDONLY)) == -1 || fstat(m->fd, &st) == -1) {
+    return -1;
+  }
+
+  if ((size_t) st.st_size < len) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  void* base = mmap(NULL, len, PROT_READ, MAP_PRIVATE, m->fd, 0);
+  if (base == MAP_FAILED) {
+    return -1;
+  }
+
+  m->base = base;
+  m->len = len;
+  madvise(base, len, MADV_SEQUENTIAL);
+
+  return 0;
+}
+
+static int map_output(mapping_t* m, const char* path, size_t len) {
+  if ((m->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) == -1 ||
+      ftruncate(m->fd, len) == -1) {
+    return -1;
+  }
+
+  void* base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, m->fd, 0);
+  if (base == MAP_FAILED) {
+    return -1;
+  }
+
+  m->base = base;
+  m->len = len;
+  madvise(base, len, MADV_SEQUENTIAL);
+
+  return 0;
+}
+
+// Computes for every input word of the designated automata the mask of
+// unconnected bits, i.e. the bits the stimulus is allowed to overwrite.
+static bits_t* free_input_masks(const ma_stream_map_t* map, size_t words) {
+  bits_t* masks = calloc(words, sizeof(*masks));
+  if (!masks) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  size_t off = 0;
+  for (size_t i = 0; i < map->num; ++i) {
+    const moore_t* a = map->automata[i];
+    for (size_t j = 0; j < a->num_input_bits; ++j) {
+      if (!input_source(a, j).automaton) {
+        set_bit(masks + off, j);
+      }
+    }
+    off += bits_to_words(a->num_input_bits);
+  }
+
+  return masks;
+}
+
+int ma_run_stream(ma_group_t* g, const ma_stream_map_t* in_map,
+                  const ma_stream_map_t* out_map, size_t cycles) {
+  if (!g || (in_map && !is_valid_map(in_map, true)) ||
+      (out_map && !is_valid_map(out_map, false))) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (async_busy(g)) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  size_t in_words = in_map ? record_words(in_map, true) : 0;
+  size_t out_words = out_map ? record_words(out_map, false) : 0;
+
+  if ((in_words != 0 && cycles > SIZE_MAX / sizeof(bits_t) / in_words) ||
+      (out_words != 0 && cycles > SIZE_MAX / sizeof(bits_t) / out_words)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (cycles == 0) {
+    return 0;
+  }
+
+  if (group_prepare(g) == -1) {
+    return -1;
+  }
+
+  int ret = -1;
+  bits_t* masks = NULL;
+  mapping_t in = {.fd = -1}, out = {.fd = -1};
+
+  if (in_map && (map_input(&in, in_map->path, cycles * in_words * sizeof(bits_t)) == -1 ||
+                 !(masks = free_input_masks(in_map, in_words)))) {
+    goto exit;
+  }
+
+  if (out_map && map_output(&out, out_map->path, cycles * out_words * sizeof(bits_t)) == -1) {
+    goto exit;
+  }
+
+  // The stimulus changes the free inputs on every cycle.
+  for (size_t i = 0; in_map && i < in_map->num; ++i) {
+    unfold(in_map->automata[i]);
+    in_map->automata[i]->settle = false;
+  }
+
+  const bits_t* src = in.base;
+  bits_t* dst = out.base;
+
+  for (size_t c = 0; c < cycles; ++c) {
+    if (in_map) {
+      const bits_t* mask = masks;
+      for (size_t i = 0; i < in_map->num; ++i) {
+        moore_t* a = in_map->automata[i];
+        size_t words = bits_to_words(a->num_input_bits);
+        for (size_t w = 0; w < words; ++w) {
+          a->input[w] = (a->input[w] & ~mask[w]) | (src[w] & mask[w]);
+        }
+        src += words;
+        mask += words;
+      }
+    }
+
+    group_step_once(g);
+
+    if (out_map) {
+      for (size_t i = 0; i < out_map->num; ++i) {
+        const moore_t* a = out_map->automata[i];
+        size_t words = bits_to_words(a->num_output_bits);
+        memcpy(dst, a->output, words * sizeof(bits_t));
+        dst += words;
+      }
+    }
+  }
+
+  ret = 0;
+
+exit:
+  free(masks);
+  unmap(&in);
+  unmap(&out);
+
+  return ret;
+}
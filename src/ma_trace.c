@@ -0,0 +1,390 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TRACE_MAGIC "MATRACE1"
+#define RING_WORDS ((size_t) 1 << 16)  // Must be a power of two.
+#define CYCLE_MARK ((uint64_t) 1 << 63)
+#define WRITER_SLEEP_NS 50000
+
+// Records are pairs of words. A pair `(CYCLE_MARK, c)` starts the changes
+// of cycle `c`, a pair `(i, v)` sets the `i`-th traced word to `v`.
+struct ma_trace {
+  ma_group_t* group;
+  size_t num_probes;
+  ma_trace_probe_t* probes;
+  size_t num_words;
+  bits_t* shadow;            // Last recorded value of every traced word.
+
+  // Single-producer single-consumer ring of record words.
+  uint64_t* ring;
+  _Alignas(64) atomic_size_t head;  // Written by the stepping thread.
+  _Alignas(64) atomic_size_t tail;  // Written by the writer thread.
+
+  FILE* file;
+  pthread_t writer;
+  atomic_int stop;
+  atomic_int error;
+};
+
+static const bits_t* probe_words(const ma_trace_probe_t* p) {
+  return p->kind == MA_TRACE_STATE ? p->automaton->state : p->automaton->output;
+}
+
+static size_t probe_bits(const ma_trace_probe_t* p) {
+  return p->kind == MA_TRACE_STATE ? p->automaton->state_bit_count
+                                   : p->automaton->num_output_bits;
+}
+
+static void ring_push(ma_trace_t* t, uint64_t a, uint64_t b) {
+  size_t head = atomic_load_explicit(&t->head, memory_order_relaxed);
+
+  // Wait for the writer if the ring is full.
+  while (head + 2 - atomic_load_explicit(&t->tail, memory_order_acquire) > RING_WORDS) {
+    sched_yield();
+  }
+
+  t->ring[head & (RING_WORDS - 1)] = a;
+  t->ring[(head + 1) & (RING_WORDS - 1)] = b;
+  atomic_store_explicit(&t->head, head + 2, memory_order_release);
+}
+
+// Appends the changed words of all probes.
+void trace_record(ma_trace_t* t, uint64_t cycle) {
+  bool marked = false;
+  size_t idx = 0;
+
+  for (size_t p = 0; p < t->num_probes; ++p) {
+    const bits_t* words = probe_words(&t->probes[p]);
+    size_t num = bits_to_words(probe_bits(&t->probes[p]));
+
+    for (size_t w = 0; w < num; ++w, ++idx) {
+      if (words[w] == t->shadow[idx]) {
+        continue;
+      }
+      if (!marked) {
+        ring_push(t, CYCLE_MARK, cycle);
+        marked = true;
+      }
+      t->shadow[idx] = words[w];
+      ring_push(t, idx, words[w]);
+    }
+  }
+}
+
+static void* writer_main(void* arg) {
+  ma_trace_t* t = arg;
+  struct timespec pause = {.tv_sec = 0, .tv_nsec = WRITER_SLEEP_NS};
+
+  for (;;) {
+    bool stopping = atomic_load(&t->stop);
+    size_t tail = atomic_load_explicit(&t->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&t->head, memory_order_acquire);
+
+    if (head == tail) {
+      if (stopping) {
+        break;
+      }
+      nanosleep(&pause, NULL);
+      continue;
+    }
+
+    // Write the available words in at most two contiguous chunks.
+    size_t begin = tail & (RING_WORDS - 1);
+    size_t len = head - tail;
+    size_t first = len < RING_WORDS - begin ? len : RING_WORDS - begin;
+
+    if (fwrite(t->ring + begin, sizeof(uint64_t), first, t->file) != first ||
+        fwrite(t->ring, sizeof(uint64_t), len - first, t->file) != len - first) {
+      atomic_store(&t->error, EIO);
+    }
+    atomic_store_explicit(&t->tail, head, memory_order_release);
+  }
+
+  return NULL;
+}
+
+static int write_header(ma_trace_t* t) {
+  if (fwrite(TRACE_MAGIC, 1, 8, t->file) != 8) {
+    return -1;
+  }
+
+  uint64_t num = t->num_probes;
+  if (fwrite(&num, sizeof(num), 1, t->file) != 1) {
+    return -1;
+  }
+
+  for (size_t p = 0; p < t->num_probes; ++p) {
+    uint64_t desc[2] = {t->probes[p].kind, probe_bits(&t->probes[p])};
+    if (fwrite(desc, sizeof(*desc), 2, t->file) != 2) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+static void destroy_trace(ma_trace_t* t) {
+  if (t->file) {
+    fclose(t->file);
+  }
+  free(t->probes);
+  free(t->shadow);
+  free(t->ring);
+  free(t);
+}
+
+ma_trace_t* ma_trace_start(ma_group_t* g, const char* path,
+                           const ma_trace_probe_t* probes, size_t num) {
+  bool ok = g && path && probes && num != 0;
+  for (size_t p = 0; p < num && ok; ++p) {
+    ok = probes[p].automaton &&
+         (probes[p].kind == MA_TRACE_OUTPUT || probes[p].kind == MA_TRACE_STATE);
+  }
+
+  if (!ok) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (g->trace || async_busy(g)) {
+    errno = EBUSY;
+    return NULL;
+  }
+
+  ma_trace_t* t = calloc(1, sizeof(*t));
+  if (!t) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  t->group = g;
+  t->num_probes = num;
+  for (size_t p = 0; p < num; ++p) {
+    t->num_words += bits_to_words(probe_bits(&probes[p]));
+  }
+
+  t->probes = malloc(num * sizeof(*t->probes));
+  t->shadow = malloc(t->num_words * sizeof(*t->shadow));
+  t->ring = malloc(RING_WORDS * sizeof(*t->ring));
+  if (!t->probes || !t->shadow || !t->ring) {
+    destroy_trace(t);
+    errno = ENOMEM;
+    return NULL;
+  }
+  memcpy(t->probes, probes, num * sizeof(*t->probes));
+
+  atomic_init(&t->head, 0);
+  atomic_init(&t->tail, 0);
+  atomic_init(&t->stop, 0);
+  atomic_init(&t->error, 0);
+
+  if (!(t->file = fopen(path, "wb")) || write_header(t) == -1) {
+    int err = errno;
+    destroy_trace(t);
+    errno = err == 0 ? EIO : err;
+    return NULL;
+  }
+
+  int err = pthread_create(&t->writer, NULL, writer_main, t);
+  if (err != 0) {
+    destroy_trace(t);
+    errno = err;
+    return NULL;
+  }
+
+  // The first record holds every traced word. Flip the shadow so that
+  // each of them is seen as changed. The writer is already running, since
+  // the record may not fit in the ring.
+  size_t idx = 0;
+  for (size_t p = 0; p < num; ++p) {
+    const bits_t* words = probe_words(&probes[p]);
+    for (size_t w = 0; w < bits_to_words(probe_bits(&probes[p])); ++w) {
+      t->shadow[idx++] = ~words[w];
+    }
+  }
+  trace_record(t, g->cycle);
+
+  g->trace = t;
+  return t;
+}
+
+int ma_trace_stop(ma_trace_t* t) {
+  if (!t) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  atomic_store(&t->stop, 1);
+  pthread_join(t->writer, NULL);
+  t->group->trace = NULL;
+
+  int err = atomic_load(&t->error);
+  if (fclose(t->file) != 0 && err == 0) {
+    err = EIO;
+  }
+  t->file = NULL;
+  destroy_trace(t);
+
+  if (err != 0) {
+    errno = err;
+    return -1;
+  }
+
+  return 0;
+}
+
+// Writes a short VCD identifier of the `idx`-th variable.
+static void vcd_id(char* buf, size_t idx) {
+  const size_t base = '~' - '!' + 1;
+  do {
+    *buf++ = (char) ('!' + idx % base);
+    idx /= base;
+  } while (idx != 0);
+  *buf = '\0';
+}
+
+static void vcd_value(FILE* out, const bits_t* words, size_t bits, size_t probe) {
+  char id[8];
+  vcd_id(id, probe);
+  fputc('b', out);
+  for (size_t b = bits; b-- > 0;) {
+    fputc(get_bit(words, b) ? '1' : '0', out);
+  }
+  fprintf(out, " %s\n", id);
+}
+
+// Emits the values of the probes marked in `dirty` at time `cycle`.
+static void vcd_flush(FILE* out, uint64_t cycle, const bits_t* values, bool* dirty,
+                      const uint64_t* bits, const size_t* first, size_t num) {
+  fprintf(out, "#%llu\n", (unsigned long long) cycle);
+  for (size_t p = 0; p < num; ++p) {
+    if (dirty[p]) {
+      vcd_value(out, values + first[p], bits[p], p);
+      dirty[p] = false;
+    }
+  }
+}
+
+int ma_trace_to_vcd(const char* trace_path, const char* vcd_path) {
+  if (!trace_path || !vcd_path) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  int ret = -1;
+  FILE* in = fopen(trace_path, "rb");
+  FILE* out = NULL;
+  uint64_t* kinds = NULL;
+  uint64_t* bits = NULL;
+  size_t* first = NULL;
+  size_t* owner = NULL;
+  bits_t* values = NULL;
+  bool* dirty = NULL;
+  char magic[8];
+  uint64_t num;
+
+  if (!in) {
+    return -1;
+  }
+
+  if (fread(magic, 1, 8, in) != 8 || memcmp(magic, TRACE_MAGIC, 8) != 0 ||
+      fread(&num, sizeof(num), 1, in) != 1 || num == 0 || num > SIZE_MAX / sizeof(uint64_t)) {
+    errno = EINVAL;
+    goto exit;
+  }
+
+  kinds = malloc(num * sizeof(*kinds));
+  bits = malloc(num * sizeof(*bits));
+  first = malloc((num + 1) * sizeof(*first));
+  dirty = calloc(num, sizeof(*dirty));
+  if (!kinds || !bits || !first || !dirty) {
+    errno = ENOMEM;
+    goto exit;
+  }
+
+  // The words of all probes are indexed by `size_t`, also in `owner`.
+  const size_t max_words = SIZE_MAX / sizeof(*owner);
+  first[0] = 0;
+  for (size_t p = 0; p < num; ++p) {
+    uint64_t desc[2];
+    if (fread(desc, sizeof(*desc), 2, in) != 2 || desc[1] == 0 ||
+        desc[1] > SIZE_MAX - (BITS_PER_WORD - 1) ||
+        bits_to_words(desc[1]) > max_words - first[p]) {
+      errno = EINVAL;
+      goto exit;
+    }
+    kinds[p] = desc[0];
+    bits[p] = desc[1];
+    first[p + 1] = first[p] + bits_to_words(bits[p]);
+  }
+
+  values = calloc(first[num], sizeof(*values));
+  owner = malloc(first[num] * sizeof(*owner));
+  if (!values || !owner) {
+    errno = ENOMEM;
+    goto exit;
+  }
+  for (size_t p = 0; p < num; ++p) {
+    for (size_t w = first[p]; w < first[p + 1]; ++w) {
+      owner[w] = p;
+    }
+  }
+
+  if (!(out = fopen(vcd_path, "w"))) {
+    goto exit;
+  }
+
+  fprintf(out, "$timescale 1ns $end\n$scope module ma $end\n");
+  for (size_t p = 0; p < num; ++p) {
+    char id[8];
+    vcd_id(id, p);
+    fprintf(out, "$var wire %llu %s p%zu_%s $end\n", (unsigned long long) bits[p], id, p,
+            kinds[p] == MA_TRACE_STATE ? "state" : "output");
+  }
+  fprintf(out, "$upscope $end\n$enddefinitions $end\n");
+
+  uint64_t rec[2], cycle = 0;
+  bool started = false;
+  while (fread(rec, sizeof(*rec), 2, in) == 2) {
+    if (rec[0] == CYCLE_MARK) {
+      if (started) {
+        vcd_flush(out, cycle, values, dirty, bits, first, num);
+      }
+      started = true;
+      cycle = rec[1];
+    } else if (rec[0] < first[num]) {
+      values[rec[0]] = rec[1];
+      dirty[owner[rec[0]]] = true;
+    }
+  }
+  if (started) {
+    vcd_flush(out, cycle, values, dirty, bits, first, num);
+  }
+
+  ret = ferror(in) || ferror(out) ? -1 : 0;
+  if (ret == -1) {
+    errno = EIO;
+  }
+
+exit:
+  if (out && fclose(out) != 0 && ret == 0) {
+    errno = EIO;
+    ret = -1;
+  }
+  fclose(in);
+  free(kinds);
+  free(bits);
+  free(first);
+  free(owner);
+  free(values);
+  free(dirty);
+
+  return ret;
+}
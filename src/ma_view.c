@@ -0,0 +1,145 @@
+#include "ma_internal.h"
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+// The view keeps two copies of the published words, the cycle followed by
+// the outputs of the selected automata. The stepping thread increments `seq`
+// before updating each copy and writes copy `(seq - 1) & 1`, so readers
+// always find a complete one: copy `seq & 1` is not being written while
+// `seq` is unchanged. Readers retry whenever `seq` changed during their copy.
+struct ma_view {
+  ma_group_t* group;
+  moore_t** automata;
+  size_t num;
+  size_t words;              // Length of a copy in words.
+  _Atomic bits_t* copies;    // Two copies of `words` words.
+  _Alignas(64) atomic_uint_fast64_t seq;
+};
+
+static void write_copy(ma_view_t* v, _Atomic bits_t* dst) {
+  atomic_store_explicit(dst++, v->group->cycle, memory_order_relaxed);
+  for (size_t i = 0; i < v->num; ++i) {
+    const moore_t* a = v->automata[i];
+    for (size_t w = 0; w < bits_to_words(a->num_output_bits); ++w) {
+      atomic_store_explicit(dst++, a->output[w], memory_order_relaxed);
+    }
+  }
+}
+
+void view_publish(ma_view_t* v) {
+  for (size_t k = 0; k < 2; ++k) {
+    // The fences order the previous copy before the new `seq`, and the new
+    // `seq` before the writes of the next copy.
+    uint_fast64_t seq = atomic_load_explicit(&v->seq, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&v->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    write_copy(v, v->copies + (seq & 1) * v->words);
+  }
+}
+
+ma_view_t* ma_view_create(ma_group_t* g, moore_t* const at[], size_t num) {
+  if (!g || !at || num == 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (g->view || async_busy(g)) {
+    errno = EBUSY;
+    return NULL;
+  }
+
+  member_entry_t* index = build_member_index(g);
+  if (!index) {
+    return NULL;
+  }
+
+  bool ok = true;
+  for (size_t i = 0; i < num && ok; ++i) {
+    ok = at[i] && find_member(index, g->num, at[i]) != SIZE_MAX;
+  }
+  free(index);
+
+  if (!ok) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  ma_view_t* v = calloc(1, sizeof(*v));
+  if (!v) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  v->group = g;
+  v->num = num;
+  v->words = 1;
+  for (size_t i = 0; i < num; ++i) {
+    v->words += bits_to_words(at[i]->num_output_bits);
+  }
+
+  v->automata = malloc(num * sizeof(*v->automata));
+  v->copies = malloc(2 * v->words * sizeof(*v->copies));
+  if (!v->automata || !v->copies) {
+    free(v->automata);
+    free(v->copies);
+    free(v);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  for (size_t i = 0; i < num; ++i) {
+    v->automata[i] = at[i];
+  }
+  atomic_init(&v->seq, 0);
+  view_publish(v);
+
+  g->view = v;
+  return v;
+}
+
+size_t ma_view_size(const ma_view_t* v) {
+  if (!v) {
+    errno = EINVAL;
+    return 0;
+  }
+
+  return (v->words - 1) * sizeof(bits_t);
+}
+
+int ma_view_read(const ma_view_t* v, bits_t* outputs, uint64_t* cycle) {
+  if (!v || !outputs) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  uint64_t c;
+  uint_fast64_t seq;
+  do {
+    seq = atomic_load_explicit(&v->seq, memory_order_acquire);
+    _Atomic bits_t* src = v->copies + (seq & 1) * v->words;
+    c = atomic_load_explicit(src, memory_order_relaxed);
+    for (size_t w = 1; w < v->words; ++w) {
+      outputs[w - 1] = atomic_load_explicit(&src[w], memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_acquire);
+  } while (atomic_load_explicit(&v->seq, memory_order_relaxed) != seq);
+
+  if (cycle) {
+    *cycle = c;
+  }
+
+  return 0;
+}
+
+void ma_view_delete(ma_view_t* v) {
+  if (!v) {
+    return;
+  }
+
+  v->group->view = NULL;
+  free(v->automata);
+  free(v->copies);
+  free(v);
+}
@@ -0,0 +1,104 @@
+#include "test.h"
+#include "errno.h"
+#include "stdlib.h"
+
+// Counts the live blocks and bytes of an allocator and fails allocations
+// once `budget` reaches zero.
+typedef struct {
+  long blocks;
+  long bytes;
+  long calls;
+  long budget;
+} arena_t;
+
+static void* arena_alloc(size_t size, void* ctx) {
+  arena_t* a = ctx;
+  if (a->budget-- == 0) {
+    return NULL;
+  }
+  ++a->calls;
+  ++a->blocks;
+  a->bytes += size;
+  return malloc(size);
+}
+
+static void* arena_realloc(void* ptr, size_t old_size, size_t size, void* ctx) {
+  arena_t* a = ctx;
+  if (a->budget-- == 0) {
+    return NULL;
+  }
+  void* p = realloc(ptr, size);
+  if (p) {
+    ++a->calls;
+    a->bytes += size - old_size;
+  }
+  return p;
+}
+
+static void arena_free(void* ptr, size_t size, void* ctx) {
+  arena_t* a = ctx;
+  --a->blocks;
+  a->bytes -= size;
+  free(ptr);
+}
+
+static void t_and(bits_t* next_state, const bits_t* input, const bits_t*, size_t, size_t) {
+  next_state[0] = input[0] & (input[0] >> 1) & 1;
+}
+
+static void id_out(bits_t* output, const bits_t* state, size_t, size_t) {
+  output[0] = state[0];
+}
+
+// Tests that every block of an automaton comes from and returns to its allocator.
+int alloc_test(void) {
+  arena_t arena = {.budget = -1};
+  ma_allocator_t alloc = {arena_alloc, arena_realloc, arena_free, &arena};
+  const bits_t zero = 0;
+
+  errno = 0;
+  ASSERT(ma_set_allocator(&(ma_allocator_t) {arena_alloc, NULL, arena_free, NULL}) == -1 &&
+         errno == EINVAL);
+
+  // Per group: the members, their fan-out arrays and the slab.
+  ma_group_t* g = ma_group_new();
+  ASSERT(g && ma_group_set_allocator(g, &alloc) == 0);
+  ma_id_t id[16];
+  for (size_t i = 0; i < 16; ++i) {
+    id[i] = ma_group_add(g, 2, 1, 1, t_and, id_out, &zero);
+    ASSERT(id[i] != MA_ID_INVALID);
+  }
+  for (size_t i = 1; i < 16; ++i) {
+    ASSERT(ma_id_connect(g, id[i], 0, id[0], 0, 1) == 0);
+    ASSERT(ma_id_connect(g, id[i], 1, id[i - 1], 0, 1) == 0);
+  }
+  long calls = arena.calls;
+  ASSERT(ma_group_compact(g) == 0 && arena.calls == calls + 1);
+  ASSERT(ma_group_set_allocator(g, NULL) == -1 && errno == EBUSY);
+  ASSERT(ma_group_freeze(g) == 0 && ma_group_step(g, 3) == 0);
+  ASSERT(arena.blocks > 0);
+  ma_group_delete(g);
+  ASSERT(arena.blocks == 0 && arena.bytes == 0);
+
+  // Globally, including a failing allocation.
+  ASSERT(ma_set_allocator(&alloc) == 0);
+  moore_t* a = ma_create_simple(2, 1, t_and);
+  moore_t* b = ma_create_simple(0, 1, t_and);
+  ASSERT(a && b && ma_connect(a, 0, b, 0, 1) == 0 && arena.blocks > 0);
+  ma_delete(a);
+  ma_delete(b);
+  ASSERT(arena.blocks == 0 && arena.bytes == 0);
+
+  arena.budget = 3;
+  ASSERT(!ma_create_simple(2, 1, t_and) && errno == ENOMEM);
+  ASSERT(arena.blocks == 0 && arena.bytes == 0);
+  ASSERT(ma_set_allocator(NULL) == 0);
+
+  arena.budget = -1;
+  calls = arena.calls;
+  a = ma_create_simple(2, 1, t_and);
+  ASSERT(a && arena.calls == calls);
+  ma_delete(a);
+
+  return PASS;
+}
@@ -0,0 +1,123 @@
+#include "test.h"
+#include "errno.h"
+#include "poll.h"
+#include "sched.h"
+#include "stdatomic.h"
+
+static atomic_int open_gate;
+
+// Latches its inputs, but only once the gate is open.
+static void t_gated(bits_t* next_state, const bits_t* input, const bits_t*, size_t, size_t) {
+  while (!atomic_load(&open_gate)) {
+    sched_yield();
+  }
+  next_state[0] = input[0];
+}
+
+static void id_out(bits_t* output, const bits_t* state, size_t, size_t) {
+  output[0] = state[0];
+}
+
+// The handle functions and the equivalence check refuse a busy group.
+static int check_handles(void) {
+  const bits_t zero = 0, v = 1;
+  atomic_store(&open_gate, 0);
+  ma_group_t* g = ma_group_new();
+  ASSERT(g);
+  ma_id_t x = ma_group_add(g, 8, 8, 8, t_gated, id_out, &zero);
+  ma_id_t y = ma_group_add(g, 8, 8, 8, t_gated, id_out, &zero);
+  ASSERT(x != MA_ID_INVALID && y != MA_ID_INVALID);
+  ma_equiv_pair_t pair = {ma_group_get(g, x), ma_group_get(g, x)};
+  ma_equiv_map_t map = {.outputs = &pair, .num_outputs = 1};
+  ma_equiv_result_t res;
+
+  ma_completion_t* c = ma_step_async(g, 1);
+  ASSERT(c);
+  errno = 0;
+  ASSERT(ma_id_connect(g, y, 0, x, 0, 8) == -1 && errno == EBUSY);
+  ASSERT(ma_id_disconnect(g, y, 0, 8) == -1 && errno == EBUSY);
+  ASSERT(ma_id_set_input(g, x, &v) == -1 && errno == EBUSY);
+  ASSERT(ma_id_set_state(g, x, &v) == -1 && errno == EBUSY);
+  ASSERT(ma_equiv_check(g, g, &map, 1, 0, &res) == -1 && errno == EBUSY);
+  atomic_store(&open_gate, 1);
+  ASSERT(ma_completion_wait(c) == 0);
+  ma_completion_delete(c);
+
+  ASSERT(ma_id_set_input(g, x, &v) == 0 && ma_id_connect(g, y, 0, x, 0, 8) == 0);
+  ASSERT(ma_group_step(g, 2) == 0 && ma_id_get_output(g, y)[0] == v);
+  ma_group_delete(g);
+  return PASS;
+}
+
+// Tests pipelined stepping on the worker thread, fed by a port and read through a view.
+int async_test(void) {
+  moore_t* a = ma_create_simple(8, 8, t_gated);
+  ASSERT(a);
+  ma_group_t* g = ma_group_create(&a, 1);
+  ASSERT(g);
+  ma_port_t* port = ma_port_open(a, MA_PORT_QUEUED, 4);
+  ma_view_t* view = ma_view_create(g, &a, 1);
+  ASSERT(port && view);
+
+  // The group is busy until the request completes.
+  ma_completion_t* c = ma_step_async(g, 1);
+  ASSERT(c);
+  ASSERT(ma_completion_poll(c) == 0);
+  errno = 0;
+  ASSERT(ma_group_step(g, 1) == -1 && errno == EBUSY);
+  ma_optimize_result_t res;
+  ASSERT(ma_run_stream(g, NULL, NULL, 1) == -1 && errno == EBUSY);
+  ASSERT(ma_group_freeze(g) == -1 && errno == EBUSY);
+  ASSERT(ma_group_optimize(g, NULL, 0, &res) == -1 && errno == EBUSY);
+  bits_t snap[4];
+  ASSERT(ma_snapshot_size(g) == sizeof(snap) && ma_snapshot(g, snap) == -1 && errno == EBUSY);
+  struct pollfd pfd = {.fd = ma_completion_fd(c), .events = POLLIN};
+  ASSERT(pfd.fd >= 0 && poll(&pfd, 1, 0) == 0);
+  atomic_store(&open_gate, 1);
+  ASSERT(poll(&pfd, 1, -1) == 1 && (pfd.revents & POLLIN));
+  ASSERT(ma_completion_wait(c) == 0 && ma_completion_poll(c) == 1);
+  ma_completion_delete(c);
+  ASSERT(ma_group_cycle(g) == 1);
+
+  // The input of cycle `i + 1` is pushed while cycle `i` is computed.
+  bits_t v = 1;
+  ASSERT(ma_port_push(port, &v, 1) == 0);
+  for (uint64_t i = 1; i < 100; ++i) {
+    c = ma_step_async(g, 1);
+    ASSERT(c);
+    v = (i + 1) & 0xff;
+    ASSERT(ma_port_push(port, &v, i + 1) == 0);
+    ASSERT(ma_completion_wait(c) == 0);
+    ma_completion_delete(c);
+
+    bits_t out;
+    uint64_t cycle;
+    ASSERT(ma_view_read(view, &out, &cycle) == 0);
+    ASSERT(cycle == i + 1 && out == (i & 0xff));
+  }
+
+  // Requests run in order and the group finishes them before it is deleted.
+  ma_completion_t* reqs[3];
+  for (size_t i = 0; i < 3; ++i) {
+    ASSERT((reqs[i] = ma_step_async(g, 10)));
+  }
+  ASSERT(ma_completion_wait(reqs[2]) == 0 && ma_completion_poll(reqs[0]) == 1);
+  ASSERT(ma_group_cycle(g) == 130);
+  ma_completion_t* last = ma_step_async(g, 5);
+  ASSERT(last);
+  ma_group_delete(g);
+  ASSERT(ma_completion_poll(last) == 1);
+  for (size_t i = 0; i < 3; ++i) {
+    ma_completion_delete(reqs[i]);
+  }
+  ma_completion_delete(last);
+  ASSERT(ma_cycle(a) == 135);
+
+  ASSERT(ma_step_async(NULL, 1) == NULL && errno == EINVAL);
+  ASSERT(ma_completion_wait(NULL) == -1 && errno == EINVAL);
+
+  ma_delete(a);
+
+  ASSERT(check_handles() == PASS);
+  return PASS;
+}
@@ -0,0 +1,86 @@
+#include "test.h"
+#include "errno.h"
+
+static void t_count(bits_t* next_state, const bits_t*, const bits_t* state, size_t, size_t) {
+  next_state[0] = state[0] + 1;
+}
+
+static void t_latch(bits_t* next_state, const bits_t* input, const bits_t*, size_t, size_t) {
+  next_state[0] = input[0];
+}
+
+// Tests multi-rate stepping of groups with clock domains.
+int clock_test(void) {
+  moore_t* a[4];
+  a[0] = ma_create_simple(0, 64, t_count);   // Every tick.
+  a[1] = ma_create_simple(0, 64, t_count);   // Ticks 1, 3, 5, ...
+  a[2] = ma_create_simple(0, 64, t_count);   // Ticks 0, 8, 16, ...
+  a[3] = ma_create_simple(64, 64, t_latch);  // Samples a[0] on ticks 0, 4, 8, ...
+  ASSERT(a[0] && a[1] && a[2] && a[3]);
+
+  errno = 0;
+  ASSERT(ma_set_clock(a[1], 2, 2) == -1 && errno == EINVAL);
+  ASSERT(ma_set_clock(a[1], 0, 0) == -1 && errno == EINVAL);
+  ASSERT(ma_set_clock(a[1], 2, 1) == 0);
+  ASSERT(ma_set_clock(a[2], 8, 0) == 0);
+  ASSERT(ma_set_clock(a[3], 4, 0) == 0);
+  ASSERT(ma_connect(a[3], 0, a[0], 0, 64) == 0);
+
+  ma_group_t* g = ma_group_create(a, SIZE(a));
+  ASSERT(g);
+
+  ASSERT(ma_group_step(g, 9) == 0);
+  ASSERT(ma_get_output(a[0])[0] == 9);
+  ASSERT(ma_get_output(a[1])[0] == 4);
+  ASSERT(ma_get_output(a[2])[0] == 2);
+  // The last sample was taken on tick 8, when a[0] had stepped 8 times.
+  ASSERT(ma_get_output(a[3])[0] == 8);
+  ASSERT(ma_cycle(a[3]) == 3);
+
+  ASSERT(ma_group_step(g, 7) == 0);
+  ASSERT(ma_get_output(a[0])[0] == 16);
+  ASSERT(ma_get_output(a[1])[0] == 8);
+  ASSERT(ma_get_output(a[2])[0] == 2);
+  ASSERT(ma_get_output(a[3])[0] == 12);
+
+  // Changing a clock takes effect on the next step.
+  ASSERT(ma_set_clock(a[2], 1, 0) == 0);
+  ASSERT(ma_group_step(g, 2) == 0);
+  ASSERT(ma_get_output(a[2])[0] == 4);
+
+  // Hyperperiods that are too long are rejected.
+  ASSERT(ma_set_clock(a[1], 65521, 0) == 0);
+  ASSERT(ma_set_clock(a[2], 65519, 0) == 0);
+  ASSERT(ma_group_step(g, 1) == -1 && errno == E2BIG);
+  ASSERT(ma_group_cycle(g) == 18);
+
+  // `ma_step` ignores clocks.
+  ASSERT(ma_step(&a[2], 1) == 0);
+  ASSERT(ma_get_output(a[2])[0] == 5);
+
+  ma_group_delete(g);
+  for (size_t i = 0; i < SIZE(a); ++i) {
+    ma_delete(a[i]);
+  }
+
+  // The domains take memory linear in the members, whatever the hyperperiod.
+  moore_t* b[64];
+  for (size_t i = 0; i < SIZE(b); ++i) {
+    b[i] = ma_create_simple(0, 64, t_count);
+    ASSERT(b[i]);
+  }
+  ASSERT(ma_set_clock(b[0], 8192, 1) == 0);
+  g = ma_group_create(b, SIZE(b));
+  ASSERT(g);
+  ASSERT(ma_group_step(g, 8194) == 0);
+  ASSERT(ma_get_output(b[0])[0] == 2 && ma_get_output(b[63])[0] == 8194);
+  ma_memory_usage_t usage;
+  ASSERT(ma_group_memory_usage(g, &usage) == 0 && usage.schedule < SIZE(b) * 64);
+
+  ma_group_delete(g);
+  for (size_t i = 0; i < SIZE(b); ++i) {
+    ma_delete(b[i]);
+  }
+
+  return PASS;
+}
@@ -0,0 +1,100 @@
+#include "test.h"
+#include "errno.h"
+
+static void t_mix(bits_t* next_state, const bits_t* input, const bits_t* state, size_t, size_t) {
+  next_state[0] = (state[0] * 5 + input[0] + 1) & 0xff;
+}
+
+static void id_out(bits_t* output, const bits_t* state, size_t, size_t) {
+  output[0] = state[0];
+}
+
+// Builds a chain of three automata fed by a free input, steps it `cycles`
+// times and returns the handles in `id`.
+static ma_group_t* build(ma_id_t id[3], size_t cycles) {
+  const bits_t q = 3;
+  ma_group_t* g = ma_group_new();
+  if (!g) {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < 3; ++i) {
+    id[i] = ma_group_add(g, 8, 8, 8, t_mix, id_out, &q);
+  }
+  const bits_t input = 1;
+  if (ma_id_connect(g, id[1], 0, id[0], 0, 8) == -1 ||
+      ma_id_connect(g, id[2], 0, id[1], 0, 8) == -1 ||
+      ma_id_set_input(g, id[0], &input) == -1 || ma_group_step(g, cycles) == -1) {
+    ma_group_delete(g);
+    return NULL;
+  }
+
+  return g;
+}
+
+static int same_outputs(const ma_group_t* g, const ma_id_t* gid, const ma_group_t* r,
+                        const ma_id_t* rid) {
+  for (size_t i = 0; i < 3; ++i) {
+    const bits_t* a = ma_id_get_output(g, gid[i]);
+    const bits_t* b = ma_id_get_output(r, rid[i]);
+    if (!a || !b || a[0] != b[0]) {
+      return 0;
+    }
+  }
+  return ma_group_cycle(g) == ma_group_cycle(r);
+}
+
+// Tests that clones evolve independently of their origin and of each other.
+int clone_test(void) {
+  ma_id_t id[3], rid[3];
+  ma_group_t* g = build(id, 5);
+  ASSERT(g);
+
+  ma_group_t* c = ma_group_clone(g);
+  ma_group_t* d = ma_group_clone(g);
+  ASSERT(c && d && ma_group_get(c, id[0]) != ma_group_get(g, id[0]));
+
+  // The origin continues with the original stimulus.
+  ASSERT(ma_group_step(g, 10) == 0);
+  ma_group_t* r = build(rid, 15);
+  ASSERT(r && same_outputs(g, id, r, rid));
+  ma_group_delete(r);
+
+  // The clone takes another one.
+  const bits_t other = 9;
+  ASSERT(ma_id_set_input(c, id[0], &other) == 0 && ma_group_step(c, 10) == 0);
+  r = build(rid, 5);
+  ASSERT(r && ma_id_set_input(r, rid[0], &other) == 0 && ma_group_step(r, 10) == 0);
+  ASSERT(same_outputs(c, id, r, rid));
+
+  // A clone of a clone starts from its current buffers and outlives both.
+  ma_group_t* e = ma_group_clone(c);
+  ASSERT(e);
+  ma_group_delete(c);
+  ASSERT(ma_group_step(e, 4) == 0 && ma_group_step(r, 4) == 0);
+  ASSERT(same_outputs(e, id, r, rid));
+  ma_group_delete(r);
+
+  // The untouched clone still holds the state of cycle 5.
+  ma_group_delete(g);
+  r = build(rid, 5);
+  ASSERT(r && same_outputs(d, id, r, rid));
+  ASSERT(ma_group_step(d, 3) == 0 && ma_group_step(r, 3) == 0 && same_outputs(d, id, r, rid));
+
+  // The topology of a clone is fixed.
+  errno = 0;
+  ASSERT(ma_id_connect(d, id[0], 0, id[2], 0, 1) == -1 && errno == EPERM);
+  ASSERT(ma_id_disconnect(d, id[1], 0, 1) == -1 && errno == EPERM);
+  ASSERT(ma_group_remove(d, id[2]) == -1 && errno == EPERM);
+  ASSERT(ma_group_add(d, 1, 1, 1, t_mix, id_out, &other) == MA_ID_INVALID && errno == EPERM);
+
+  moore_t* at[1] = {ma_group_get(r, rid[0])};
+  ma_group_t* borrowed = ma_group_create(at, 1);
+  ASSERT(borrowed && !ma_group_clone(borrowed) && errno == EPERM);
+
+  ma_group_delete(borrowed);
+  ma_group_delete(r);
+  ma_group_delete(d);
+  ma_group_delete(e);
+  return PASS;
+}
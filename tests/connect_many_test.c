@@ -0,0 +1,69 @@
+#include "test.h"
+#include "errno.h"
+
+static void t_steady(bits_t* next_state, const bits_t*, const bits_t* old_state, size_t,
+                     size_t) {
+  next_state[0] = old_state[0];
+}
+
+static void t_copy_input(bits_t* next_state, const bits_t* input, const bits_t*, size_t n,
+                         size_t) {
+  for (size_t i = 0; i < (n + 63) / 64; ++i) {
+    next_state[i] = input[i];
+  }
+}
+
+// Tests `ma_connect_many`: wide fan-out, overriding and all-or-nothing validation.
+int connect_many_test(void) {
+  const size_t k = 100;
+  const bits_t pattern = 0x0123456789abcdefULL, other = 0xffULL;
+  moore_t* a[3];
+  ma_conn_spec_t specs[100];
+
+  a[0] = ma_create_simple(0, 64, t_steady);
+  a[1] = ma_create_simple(0, 64, t_steady);
+  a[2] = ma_create_simple(64 * k, 64 * k, t_copy_input);
+  ASSERT(a[0] && a[1] && a[2]);
+  ASSERT(ma_set_state(a[0], &pattern) == 0);
+  ASSERT(ma_set_state(a[1], &other) == 0);
+
+  // Every bit of a[0] drives `k` inputs.
+  for (size_t i = 0; i < k; ++i) {
+    specs[i] = (ma_conn_spec_t) {.a_in = a[2], .in = 64 * i, .a_out = a[0], .out = 0,
+                                 .num = 64};
+  }
+  ASSERT(ma_connect_many(specs, k) == 0);
+  ASSERT(ma_step(a, SIZE(a)) == 0);
+
+  const bits_t* y = ma_get_output(a[2]);
+  for (size_t i = 0; i < k; ++i) {
+    ASSERT(y[i] == pattern);
+  }
+
+  // A batch with one invalid range changes nothing.
+  specs[0] = (ma_conn_spec_t) {.a_in = a[2], .in = 0, .a_out = a[1], .out = 0, .num = 64};
+  specs[1] = (ma_conn_spec_t) {.a_in = a[2], .in = 64, .a_out = a[1], .out = 1, .num = 64};
+  errno = 0;
+  ASSERT(ma_connect_many(specs, 2) == -1 && errno == EINVAL);
+  ASSERT(ma_connect_many(NULL, 1) == -1 && errno == EINVAL);
+  ASSERT(ma_connect_many(NULL, 0) == 0);
+  ASSERT(ma_step(a, SIZE(a)) == 0);
+  ASSERT(y[0] == pattern && y[1] == pattern);
+
+  // Later ranges win where they overlap earlier ones.
+  specs[1] = (ma_conn_spec_t) {.a_in = a[2], .in = 8, .a_out = a[0], .out = 8, .num = 8};
+  ASSERT(ma_connect_many(specs, 2) == 0);
+  ASSERT(ma_step(a, SIZE(a)) == 0);
+  ASSERT(y[0] == ((other & ~0xff00ULL) | (pattern & 0xff00ULL)));
+  ASSERT(y[1] == pattern);
+
+  // Deleting the driver leaves the inputs with their last values.
+  ma_delete(a[0]);
+  ASSERT(ma_step(&a[2], 1) == 0);
+  ASSERT(y[2] == pattern);
+
+  ma_delete(a[1]);
+  ma_delete(a[2]);
+
+  return PASS;
+}
@@ -0,0 +1,122 @@
+#include "test.h"
+#include "errno.h"
+#include "pthread.h"
+#include "sched.h"
+
+#define BATCHES 2000
+
+static void t_hold(bits_t* next_state, const bits_t*, const bits_t* state, size_t, size_t) {
+  next_state[0] = state[0];
+}
+
+static void t_latch(bits_t* next_state, const bits_t* input, const bits_t*, size_t, size_t) {
+  next_state[0] = input[0];
+}
+
+static void id_out(bits_t* output, const bits_t* state, size_t, size_t) {
+  output[0] = state[0];
+}
+
+typedef struct {
+  ma_group_t* g;
+  moore_t* src[2];
+  moore_t* sink[2];
+} rewire_t;
+
+// Switches both sinks between the sources in single batches.
+static void* rewire(void* arg) {
+  rewire_t* r = arg;
+  for (size_t i = 0; i < BATCHES; ++i) {
+    moore_t* src = r->src[i % 2];
+    ma_conn_spec_t edits[2] = {{r->sink[0], 0, src, 0, 1}, {r->sink[1], 0, src, 0, 1}};
+    if (ma_group_queue_edits(r->g, edits, 2) == -1) {
+      return r;
+    }
+    sched_yield();
+  }
+  return NULL;
+}
+
+static size_t schedule_size(const ma_group_t* g) {
+  ma_memory_usage_t usage;
+  return ma_group_memory_usage(g, &usage) == 0 ? usage.schedule : 0;
+}
+
+// Tests that queued edits are applied between steps and keep the schedule frozen.
+int edit_test(void) {
+  const bits_t zero = 0, one = 1;
+  moore_t* at[4] = {ma_create_full(0, 1, 1, t_hold, id_out, &zero),
+                    ma_create_full(0, 1, 1, t_hold, id_out, &one),
+                    ma_create_simple(1, 1, t_latch), ma_create_simple(1, 1, t_latch)};
+  for (size_t i = 0; i < 4; ++i) {
+    ASSERT(at[i]);
+  }
+  ASSERT(ma_connect(at[2], 0, at[0], 0, 1) == 0 && ma_connect(at[3], 0, at[0], 0, 1) == 0);
+
+  ma_group_t* g = ma_group_create(at, 4);
+  ASSERT(g && ma_group_freeze(g) == 0);
+  size_t frozen = schedule_size(g);
+  ASSERT(frozen > 0);
+
+  // Nothing changes until the next step.
+  ma_conn_spec_t edits[2] = {{at[2], 0, at[1], 0, 1}, {at[3], 0, NULL, 0, 1}};
+  ASSERT(ma_group_queue_edits(g, edits, 2) == 0);
+  ASSERT(ma_group_step(g, 1) == 0);
+  ASSERT(ma_get_output(at[2])[0] == 1 && ma_get_output(at[3])[0] == 0);
+  ASSERT(schedule_size(g) == frozen);
+
+  // The disconnected input is free again.
+  ASSERT(ma_set_input(at[3], &one) == 0);
+  ASSERT(ma_group_step(g, 1) == 0);
+  ASSERT(ma_get_output(at[3])[0] == 1);
+  ASSERT(ma_connect(at[3], 0, at[1], 0, 1) == 0);
+  ASSERT(ma_group_freeze(g) == 0);
+
+  // Both sinks switch in the same step.
+  rewire_t r = {.g = g, .src = {at[0], at[1]}, .sink = {at[2], at[3]}};
+  pthread_t thread;
+  ASSERT(pthread_create(&thread, NULL, rewire, &r) == 0);
+  int agree = 1;
+  for (size_t i = 0; i < 4 * BATCHES; ++i) {
+    ASSERT(ma_group_step(g, 1) == 0);
+    agree &= ma_get_output(at[2])[0] == ma_get_output(at[3])[0];
+  }
+  void* failed;
+  ASSERT(pthread_join(thread, &failed) == 0 && failed == NULL);
+  ASSERT(agree);
+  ASSERT(ma_group_apply_edits(g) == 0 && ma_group_step(g, 1) == 0);
+  ASSERT(ma_get_output(at[2])[0] == 1 && ma_get_output(at[3])[0] == 1);
+  ASSERT(schedule_size(g) == frozen);
+
+  // Edits through handles patch the schedule as well.
+  ma_group_t* h = ma_group_new();
+  ASSERT(h);
+  ma_id_t src = ma_group_add(h, 0, 1, 1, t_hold, id_out, &one);
+  ma_id_t sink = ma_group_add(h, 1, 1, 1, t_latch, id_out, &zero);
+  ASSERT(src != MA_ID_INVALID && sink != MA_ID_INVALID);
+  ASSERT(ma_group_freeze(h) == 0);
+  frozen = schedule_size(h);
+  ASSERT(ma_id_connect(h, sink, 0, src, 0, 1) == 0 && ma_group_step(h, 1) == 0);
+  ASSERT(ma_id_get_output(h, sink)[0] == 1 && schedule_size(h) == frozen);
+  ASSERT(ma_id_disconnect(h, sink, 0, 1) == 0 && schedule_size(h) == frozen);
+
+  errno = 0;
+  ma_conn_spec_t bad = {at[2], 1, NULL, 0, 1};
+  ASSERT(ma_group_queue_edits(g, &bad, 1) == -1 && errno == EINVAL);
+  ASSERT(ma_group_queue_edits(NULL, edits, 1) == -1 && errno == EINVAL);
+  ASSERT(ma_group_apply_edits(NULL) == -1 && errno == EINVAL);
+
+  ma_group_t* c = ma_group_clone(h);
+  ASSERT(c);
+  ma_conn_spec_t own = {ma_group_get(c, sink), 0, NULL, 0, 1};
+  ASSERT(ma_group_queue_edits(c, &own, 1) == -1 && errno == EPERM);
+
+  ma_group_delete(c);
+  ma_group_delete(h);
+  ma_group_delete(g);
+  for (size_t i = 0; i < 4; ++i) {
+    ma_delete(at[i]);
+  }
+
+  return PASS;
+}
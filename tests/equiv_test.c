@@ -0,0 +1,122 @@
+#include "test.h"
+#include "errno.h"
+
+static void t_latch(bits_t* next_state, const bits_t* input, const bits_t*, size_t, size_t) {
+  next_state[0] = input[0] & 3;
+}
+
+// Adds the input to a 4-bit accumulator.
+static void t_add(bits_t* next_state, const bits_t* input, const bits_t* state, size_t, size_t) {
+  next_state[0] = (state[0] + (input[0] & 3)) & 0xf;
+}
+
+// The same accumulator, adding bit by bit.
+static void t_ripple(bits_t* next_state, const bits_t* input, const bits_t* state, size_t,
+                     size_t) {
+  bits_t sum = 0, carry = 0;
+  for (int i = 0; i < 4; ++i) {
+    bits_t x = (state[0] >> i) & 1, y = i < 2 ? (input[0] >> i) & 1 : 0;
+    sum |= (x ^ y ^ carry) << i;
+    carry = (x & y) | (carry & (x ^ y));
+  }
+  next_state[0] = sum;
+}
+
+// The accumulator with a rare bug: 13 + 3 wraps to 1.
+static void t_buggy(bits_t* next_state, const bits_t* input, const bits_t* state, size_t n,
+                    size_t s) {
+  t_add(next_state, input, state, n, s);
+  if (state[0] == 13 && (input[0] & 3) == 3) {
+    next_state[0] = 1;
+  }
+}
+
+static void id_out(bits_t* output, const bits_t* state, size_t, size_t) {
+  output[0] = state[0];
+}
+
+// A latch feeding an accumulator with transition `t`.
+static ma_group_t* make_net(transition_function_t t, moore_t* at[2]) {
+  const bits_t zero = 0;
+  at[0] = ma_create_full(2, 2, 2, t_latch, id_out, &zero);
+  at[1] = ma_create_full(2, 4, 4, t, id_out, &zero);
+  if (!at[0] || !at[1] || ma_connect(at[1], 0, at[0], 0, 2) == -1) {
+    return NULL;
+  }
+  return ma_group_create(at, 2);
+}
+
+// Tests equivalence checking and the replay of a counterexample.
+int equiv_test(void) {
+  moore_t *x[2], *y[2], *z[2], *fx[2], *fz[2];
+  ma_group_t* gx = make_net(t_add, x);
+  ma_group_t* gy = make_net(t_ripple, y);
+  ma_group_t* gz = make_net(t_buggy, z);
+  ASSERT(gx && gy && gz);
+
+  ma_equiv_pair_t in_xy = {x[0], y[0]}, out_xy = {x[1], y[1]};
+  ma_equiv_map_t map = {.inputs = &in_xy, .num_inputs = 1, .outputs = &out_xy,
+                        .num_outputs = 1, .runs = 16, .num_threads = 4};
+  ma_equiv_result_t res;
+  ASSERT(ma_equiv_check(gx, gy, &map, 2000, 42, &res) == 0);
+  ASSERT(res.equivalent && res.trace_len == 0 && !res.trace_inputs);
+  ASSERT(ma_group_cycle(gx) == 0 && ma_get_output(x[1])[0] == 0);
+
+  // The lowest diverging run is found regardless of the number of threads.
+  ma_equiv_pair_t in_xz = {x[0], z[0]}, out_xz = {x[1], z[1]};
+  map = (ma_equiv_map_t) {.inputs = &in_xz, .num_inputs = 1, .outputs = &out_xz,
+                          .num_outputs = 1, .runs = 32, .num_threads = 1};
+  ma_equiv_result_t single;
+  ASSERT(ma_equiv_check(gx, gz, &map, 2000, 7, &single) == 0);
+  map.num_threads = 4;
+  ASSERT(ma_equiv_check(gx, gz, &map, 2000, 7, &res) == 0);
+  ASSERT(!res.equivalent && res.output == 0 && res.input_words == 1);
+  ASSERT(res.seed == single.seed && res.cycle == single.cycle && res.trace_len == res.cycle);
+  ma_equiv_result_free(&single);
+
+  // Replaying the trace through the groups reproduces the divergence.
+  for (size_t c = 0; c < res.trace_len; ++c) {
+    ASSERT(ma_get_output(x[1])[0] == ma_get_output(z[1])[0]);
+    ASSERT(ma_set_input(x[0], res.trace_inputs + c) == 0);
+    ASSERT(ma_set_input(z[0], res.trace_inputs + c) == 0);
+    ASSERT(ma_group_step(gx, 1) == 0 && ma_group_step(gz, 1) == 0);
+  }
+  ASSERT(ma_get_output(x[1])[0] != ma_get_output(z[1])[0]);
+
+  // A single run from the reported seed finds the same divergence.
+  map = (ma_equiv_map_t) {.inputs = &in_xz, .num_inputs = 1, .outputs = &out_xz,
+                          .num_outputs = 1};
+  ma_group_t* fresh = make_net(t_add, fx);
+  ma_group_t* fresh_z = make_net(t_buggy, fz);
+  ASSERT(fresh && fresh_z);
+  in_xz = (ma_equiv_pair_t) {fx[0], fz[0]};
+  out_xz = (ma_equiv_pair_t) {fx[1], fz[1]};
+  ASSERT(ma_equiv_check(fresh, fresh_z, &map, res.cycle, res.seed, &single) == 0);
+  ASSERT(!single.equivalent && single.cycle == res.cycle);
+  ma_equiv_result_free(&single);
+  ma_equiv_result_free(&res);
+
+  errno = 0;
+  // Pairs must be members of the same width.
+  ma_equiv_pair_t bad = {x[0], y[1]};
+  map.inputs = &in_xy;
+  map.outputs = &bad;
+  ASSERT(ma_equiv_check(gx, gy, &map, 10, 1, &res) == -1 && errno == EINVAL);
+  bad = (ma_equiv_pair_t) {x[1], z[1]};
+  ASSERT(ma_equiv_check(gx, gy, &map, 10, 1, &res) == -1 && errno == EINVAL);
+  ma_equiv_pair_t in_yy = {y[0], y[0]}, out_yy = {y[1], y[1]};
+  map.inputs = &in_yy;
+  map.outputs = &out_yy;
+  ASSERT(ma_equiv_check(gy, gy, &map, 10, 1, &res) == 0 && res.equivalent);
+  ASSERT(ma_equiv_check(NULL, gy, &map, 10, 1, &res) == -1 && errno == EINVAL);
+
+  ma_group_t* groups[5] = {gx, gy, gz, fresh, fresh_z};
+  moore_t** members[5] = {x, y, z, fx, fz};
+  for (size_t i = 0; i < 5; ++i) {
+    ma_group_delete(groups[i]);
+    ma_delete(members[i][0]);
+    ma_delete(members[i][1]);
+  }
+
+  return PASS;
+}
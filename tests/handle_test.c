@@ -0,0 +1,82 @@
+#include "test.h"
+#include "errno.h"
+
+static void xor_trans(bits_t* next_state, const bits_t* input,
+                      const bits_t* old_state, size_t, size_t) {
+  next_state[0] = (old_state[0] ^ input[0]) & 1;
+}
+
+static void sum_trans(bits_t* next_state, const bits_t* input,
+                      const bits_t* old_state, size_t, size_t) {
+  next_state[0] = old_state[0] + input[0];
+}
+
+static void id_out(bits_t* output, const bits_t* state, size_t, size_t) {
+  output[0] = state[0];
+}
+
+// Tests handles with heavy churn followed by compaction of the storage.
+int handle_test(void) {
+  const bits_t zero = 0, one = 1;
+  size_t n = 64;
+  ma_id_t ids[n];
+
+  ma_group_t* g = ma_group_new();
+  ASSERT(g != NULL);
+
+  for (size_t i = 0; i < n; ++i) {
+    ids[i] = ma_group_add(g, 64, 64, 64, sum_trans, id_out, &zero);
+    ASSERT(ids[i] != MA_ID_INVALID);
+  }
+
+  // Remove every other automaton; their handles become stale.
+  for (size_t i = 0; i < n; i += 2) {
+    ASSERT(ma_group_remove(g, ids[i]) == 0);
+    ASSERT(ma_group_get(g, ids[i]) == NULL && errno == EINVAL);
+    ASSERT(ma_group_remove(g, ids[i]) == -1 && errno == EINVAL);
+  }
+
+  // Reused slots get new generations.
+  ma_id_t counter[2];
+  counter[0] = ma_group_add(g, 1, 1, 1, xor_trans, id_out, &zero);
+  counter[1] = ma_group_add(g, 1, 1, 1, xor_trans, id_out, &zero);
+  ASSERT(counter[0] != MA_ID_INVALID && counter[1] != MA_ID_INVALID);
+  ASSERT((counter[0] & UINT32_MAX) == (ids[n - 2] & UINT32_MAX) && counter[0] != ids[n - 2]);
+
+  ASSERT(ma_id_set_input(g, counter[0], &one) == 0);
+  ASSERT(ma_id_connect(g, counter[1], 0, counter[0], 0, 1) == 0);
+  for (size_t i = 1; i < n; i += 2) {
+    ASSERT(ma_id_set_input(g, ids[i], &one) == 0);
+    ASSERT(ma_id_connect(g, ids[i], 0, counter[1], 0, 1) == 0);
+  }
+
+  ASSERT(ma_group_step(g, 5) == 0);
+  ASSERT(ma_group_compact(g) == 0);
+  ASSERT(ma_group_step(g, 3) == 0);
+
+  // Counter: 01, 10, 11, 00, 01, 10, 11, 00. The sums count the steps in
+  // which the second counter bit was set before the step.
+  ASSERT(ma_id_get_output(g, counter[0])[0] == 0 && ma_id_get_output(g, counter[1])[0] == 0);
+  for (size_t i = 1; i < n; i += 2) {
+    ASSERT(ma_id_get_output(g, ids[i])[0] == 1 + 1 + 1 + 1);
+  }
+
+  // Compaction keeps working after more churn.
+  ASSERT(ma_group_remove(g, ids[1]) == 0);
+  ASSERT(ma_group_compact(g) == 0);
+  ASSERT(ma_id_set_state(g, ids[3], &zero) == 0);
+  ASSERT(ma_id_disconnect(g, ids[3], 0, 1) == 0);
+  ASSERT(ma_group_step(g, 2) == 0);
+  ASSERT(ma_id_get_output(g, ids[3])[0] == 2);
+
+  // Only groups owning their automata accept handles.
+  moore_t* a = ma_group_get(g, ids[3]);
+  ma_group_t* view = ma_group_create(&a, 1);
+  ASSERT(view != NULL);
+  ASSERT(ma_group_add(view, 1, 1, 1, xor_trans, id_out, &zero) == MA_ID_INVALID && errno == EPERM);
+  ASSERT(ma_group_compact(view) == -1 && errno == EPERM);
+  ma_group_delete(view);
+
+  ma_group_delete(g);
+  return PASS;
+}
@@ -0,0 +1,89 @@
+#include "test.h"
+#include "errno.h"
+#include "stdio.h"
+
+#define WORDS 10
+#define LANES (WORDS * 64)
+
+static void t_mix(bits_t* next_state, const bits_t* input, const bits_t* state, size_t, size_t) {
+  next_state[0] = (state[0] * 5 + input[0] + (state[0] >> 2)) & 0xf;
+}
+
+static void y_mix(bits_t* output, const bits_t* state, size_t, size_t) {
+  output[0] = (__builtin_parityll(state[0]) | (state[0] & 6)) ^ 1;
+}
+
+static void t_parity(bits_t* next_state, const bits_t* input, const bits_t* state, size_t,
+                     size_t) {
+  next_state[0] = (input[0] ^ (input[0] >> 1) ^ state[0]) & 1;
+}
+
+static void id_out(bits_t* output, const bits_t* state, size_t, size_t) {
+  output[0] = state[0];
+}
+
+static bits_t next_random(bits_t* x) {
+  *x = *x * 6364136223846793005ULL + 1442695040888963407ULL;
+  return *x >> 33;
+}
+
+// Scatters `value` of `lane` over `bits` planes.
+static void put(bits_t* planes, size_t bits, size_t lane, bits_t value) {
+  for (size_t j = 0; j < bits; ++j) {
+    bits_t* w = &planes[j * WORDS + lane / 64];
+    *w = (*w & ~(1ULL << (lane % 64))) | (((value >> j) & 1) << (lane % 64));
+  }
+}
+
+static bits_t get(const bits_t* planes, size_t bits, size_t lane) {
+  bits_t value = 0;
+  for (size_t j = 0; j < bits; ++j) {
+    value |= ((planes[j * WORDS + lane / 64] >> (lane % 64)) & 1) << j;
+  }
+  return value;
+}
+
+// Tests the synthesised kernel against the functions it was built from.
+int kernel_test(void) {
+  errno = 0;
+  ASSERT(!ma_kernel_synthesize(2, 0, 1, t_parity, id_out) && errno == EINVAL);
+  ASSERT(!ma_kernel_synthesize(10, 3, 10, t_mix, y_mix) && errno == E2BIG);
+
+  // Linear functions need one term per variable.
+  ma_kernel_t* k = ma_kernel_synthesize(2, 1, 1, t_parity, id_out);
+  ASSERT(k && ma_kernel_terms(k) == 4);
+  ma_kernel_delete(k);
+
+  k = ma_kernel_synthesize(4, 3, 4, t_mix, y_mix);
+  ASSERT(k);
+
+  static bits_t state[4 * WORDS], input[4 * WORDS], output[3 * WORDS];
+  bits_t ref[LANES], seed = 7;
+  for (size_t l = 0; l < LANES; ++l) {
+    ref[l] = next_random(&seed) & 0xf;
+    put(state, 4, l, ref[l]);
+  }
+
+  for (size_t c = 0; c < 6; ++c) {
+    for (size_t l = 0; l < LANES; ++l) {
+      bits_t in = next_random(&seed) & 0xf, next;
+      put(input, 4, l, in);
+      t_mix(&next, &in, &ref[l], 4, 4);
+      ref[l] = next;
+    }
+    ASSERT(ma_kernel_step(k, state, input, output, WORDS) == 0);
+    for (size_t l = 0; l < LANES; ++l) {
+      bits_t out;
+      y_mix(&out, &ref[l], 3, 4);
+      ASSERT(get(state, 4, l) == ref[l] && get(output, 3, l) == (out & 7));
+    }
+  }
+
+  FILE* f = tmpfile();
+  ASSERT(f && ma_kernel_emit_c(k, f, "mix_kernel") == 0 && ftell(f) > 0);
+  fclose(f);
+  ASSERT(ma_kernel_emit_c(k, stdout, "") == -1 && errno == EINVAL);
+
+  ma_kernel_delete(k);
+  return PASS;
+}
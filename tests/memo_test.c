@@ -0,0 +1,77 @@
+#include "test.h"
+#include "errno.h"
+
+static size_t trans_calls, out_calls;
+
+// A 3-bit state machine driven by a 2-bit input.
+static void t_mix(bits_t* next_state, const bits_t* input, const bits_t* state, size_t, size_t) {
+  ++trans_calls;
+  next_state[0] = (state[0] * 5 + input[0] + 1) & 7;
+}
+
+static void y_parity(bits_t* output, const bits_t* state, size_t, size_t) {
+  ++out_calls;
+  output[0] = __builtin_parityll(state[0]) | (state[0] << 1);
+}
+
+// Tests that cached transitions give the same results and are counted.
+int memo_test(void) {
+  const bits_t zero = 0;
+  moore_t* a = ma_create_full(2, 4, 3, t_mix, y_parity, &zero);
+  moore_t* b = ma_create_full(2, 4, 3, t_mix, y_parity, &zero);
+  ASSERT(a && b);
+
+  ma_memo_stats_t stats;
+  errno = 0;
+  ASSERT(ma_memo_stats(a, &stats) == -1 && errno == ENOENT);
+  ASSERT(ma_memo_enable(a, 0, 0) == 0);
+
+  // All 32 pairs of a state and an input fit, so every one misses once.
+  size_t steps = 1000;
+  trans_calls = out_calls = 0;
+  for (size_t i = 0; i < steps; ++i) {
+    bits_t x = (i * 7 + i / 3) & 3;
+    ASSERT(ma_set_input(a, &x) == 0 && ma_set_input(b, &x) == 0);
+    ASSERT(ma_step(&a, 1) == 0 && ma_step(&b, 1) == 0);
+    ASSERT(ma_get_output(a)[0] == ma_get_output(b)[0]);
+  }
+  ASSERT(ma_memo_stats(a, &stats) == 0);
+  ASSERT(stats.hits + stats.misses == steps && stats.misses <= 32 && stats.evictions == 0);
+  ASSERT(trans_calls == steps + stats.misses && out_calls == steps + stats.misses);
+
+  // A single set of two ways keeps evicting.
+  ASSERT(ma_memo_enable(a, 1, 2) == 0);
+  ASSERT(ma_memo_stats(a, &stats) == 0 && stats.hits == 0 && stats.misses == 0);
+  for (size_t i = 0; i < steps; ++i) {
+    bits_t x = i & 3;
+    ASSERT(ma_set_input(a, &x) == 0 && ma_set_input(b, &x) == 0);
+    ASSERT(ma_step(&a, 1) == 0 && ma_step(&b, 1) == 0);
+    ASSERT(ma_get_output(a)[0] == ma_get_output(b)[0]);
+  }
+  ASSERT(ma_memo_stats(a, &stats) == 0 && stats.evictions > 0);
+
+  ASSERT(ma_memo_disable(a) == 0);
+  ASSERT(ma_memo_stats(a, &stats) == -1 && errno == ENOENT);
+  ASSERT(ma_memo_enable(a, 4, 65) == -1 && errno == EINVAL);
+  ASSERT(ma_memo_enable(NULL, 4, 4) == -1 && errno == EINVAL);
+
+  // The cache is released with the automaton.
+  ASSERT(ma_memo_enable(b, 16, 2) == 0);
+
+  ma_delete(a);
+  ma_delete(b);
+
+  // Members of a clone cannot cache their transitions.
+  ma_group_t* g = ma_group_new();
+  ASSERT(g);
+  ma_id_t id = ma_group_add(g, 2, 4, 3, t_mix, y_parity, &zero);
+  ASSERT(id != MA_ID_INVALID);
+  ma_group_t* c = ma_group_clone(g);
+  ASSERT(c);
+  ASSERT(ma_memo_enable(ma_group_get(c, id), 0, 0) == -1 && errno == EPERM);
+  ASSERT(ma_memo_enable(ma_group_get(g, id), 0, 0) == 0);
+  ma_group_delete(c);
+  ma_group_delete(g);
+
+  return PASS;
+}
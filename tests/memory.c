@@ -1,6 +1,8 @@
 #include "test.h"
 #include "errno.h"
 #include "stdio.h"
+#include "stdlib.h"
+#include "unistd.h"
 
 #define V(code, where) (((unsigned long)code) << (3 * where))
 
@@ -18,6 +20,13 @@ static void add_one(bits_t* output, const bits_t* state, size_t, size_t) {
   output[0] = state[0] + 1;
 }
 
+static void copy_trans(bits_t* next_state, const bits_t* input,
+                       const bits_t*, size_t n, size_t) {
+  for (size_t i = 0; i < (n + 63) / 64; ++i) {
+    next_state[i] = input[i];
+  }
+}
+
 // Tests the implementation's response to memory allocation failure.
 // The allocation failure is reported once. The second attempt should succeed.
 static unsigned long alloc_fail_test(void) {
@@ -71,6 +80,121 @@ static unsigned long alloc_fail_test(void) {
   return visited;
 }
 
+// A failed `ma_connect_many` must not leave any of its connections behind.
+static unsigned long connect_many_fail_test(void) {
+  const uint64_t ones = ~0ULL;
+  const size_t k = 20, width = 32;
+  unsigned long visited = 0;
+  moore_t* a[2] = {NULL, NULL};
+  ma_conn_spec_t specs[20];
+
+  a[0] = ma_create_simple(64, 64, xor_trans);
+  a[1] = ma_create_simple(k * width, k * width, copy_trans);
+  if (!a[0] || !a[1] || ma_set_state(a[0], &ones) != 0) {
+    // Creation failures are covered by `alloc_fail_test`.
+    goto exit;
+  }
+
+  for (size_t i = 0; i < k; ++i) {
+    specs[i] = (ma_conn_spec_t) {.a_in = a[1], .in = i * width, .a_out = a[0], .out = 0,
+                                 .num = width};
+  }
+
+  errno = 0;
+  if (ma_connect_many(specs, k) == 0) {
+    visited |= V(1, 0);
+  } else if (errno == ENOMEM) {
+    visited |= V(2, 0);
+    if (ma_step(a, SIZE(a)) != 0) {
+      visited |= V(4, 1);
+      goto exit;
+    }
+    const bits_t* y = ma_get_output(a[1]);
+    for (size_t i = 0; i < k * width / 64; ++i) {
+      if (y[i] != 0) {
+        visited |= V(4, 1);
+      }
+    }
+  } else {
+    visited |= V(4, 0);
+  }
+
+exit:
+  for (size_t i = 0; i < SIZE(a); ++i) {
+    ma_delete(a[i]);
+  }
+  return visited;
+}
+
+static const ma_func_entry_t netlist_funcs[] = {
+  {.id = 1, .t = xor_trans},
+  {.id = 2, .t = sum_trans, .y = add_one},
+};
+
+// Tests the response of `ma_save_netlist` and `ma_load_netlist` to memory
+// allocation failure.
+static unsigned long netlist_fail_test(void) {
+  char path[] = "/tmp/ma_memory_netlist_XXXXXX";
+  ma_func_registry_t reg = {.entries = netlist_funcs, .num = SIZE(netlist_funcs)};
+  const uint64_t q1 = 1;
+  unsigned long visited = 0;
+  moore_t* a[3] = {NULL, NULL, NULL};
+  ma_group_t *g = NULL, *h;
+
+  int fd = mkstemp(path);
+  if (fd == -1) {
+    return V(4, 0);
+  }
+  close(fd);
+
+  for (int tries = 0; tries < 2 && !g; ++tries) {
+    for (size_t i = 0; i < SIZE(a); ++i) {
+      ma_delete(a[i]);
+      a[i] = NULL;
+    }
+    a[0] = ma_create_simple(1, 1, xor_trans);
+    a[1] = ma_create_simple(1, 1, xor_trans);
+    a[2] = ma_create_full(64, 64, 64, sum_trans, add_one, &q1);
+    if (a[0] && a[1] && a[2] && ma_connect(a[1], 0, a[0], 0, 1) == 0 &&
+        ma_connect(a[2], 0, a[1], 0, 1) == 0 && ma_connect(a[2], 1, a[0], 0, 1) == 0) {
+      g = ma_group_create(a, SIZE(a));
+    }
+  }
+  if (!g) {
+    visited |= V(4, 0);
+    goto exit;
+  }
+
+  errno = 0;
+  if (ma_save_netlist(g, path, &reg) == 0) {
+    visited |= V(1, 1);
+  } else if (errno == ENOMEM && ma_save_netlist(g, path, &reg) == 0) {
+    visited |= V(2, 1);
+  } else {
+    visited |= V(4, 1);
+    goto exit;
+  }
+
+  errno = 0;
+  if ((h = ma_load_netlist(path, &reg)) != NULL) {
+    visited |= V(1, 2);
+  } else if (errno == ENOMEM && (h = ma_load_netlist(path, &reg)) != NULL) {
+    visited |= V(2, 2);
+  } else {
+    visited |= V(4, 2);
+    goto exit;
+  }
+  ma_group_delete(h);
+
+exit:
+  ma_group_delete(g);
+  for (size_t i = 0; i < SIZE(a); ++i) {
+    ma_delete(a[i]);
+  }
+  unlink(path);
+  return visited;
+}
+
 // Tests the implementation's response to memory allocation failure.
 static int memory_test_runner(unsigned long (* test_function)(void)) {
   memory_test_data_t* mtd = get_memory_test_data();
@@ -111,5 +235,11 @@ static int memory_test_runner(unsigned long (* test_function)(void)) {
 
 int memory_test(void) {
   memory_tests_check();
-  return memory_test_runner(alloc_fail_test);
+  if (memory_test_runner(alloc_fail_test) != PASS) {
+    return FAIL;
+  }
+  if (memory_test_runner(connect_many_fail_test) != PASS) {
+    return FAIL;
+  }
+  return memory_test_runner(netlist_fail_test);
 }
\ No newline at end of file
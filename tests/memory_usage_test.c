@@ -0,0 +1,161 @@
+#include "test.h"
+#include "errno.h"
+
+// Toggles when all inputs are set (same as in n_bit_adder.c).
+static void t_carry(bits_t* next_state, const bits_t* input,
+                    const bits_t* old_state, size_t n, size_t) {
+  bits_t all_set = (1ULL << n) - 1;
+  next_state[0] = (input[0] & all_set) == all_set ? old_state[0] ^ 1 : old_state[0];
+}
+
+static void y_copy(bits_t* output, const bits_t* state, size_t, size_t) {
+  output[0] = state[0];
+}
+
+static int same_outputs(const ma_group_t* g, const ma_id_t id[], moore_t* const b[], size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    ASSERT(ma_id_get_output(g, id[i])[0] == ma_get_output(b[i])[0]);
+  }
+  return PASS;
+}
+
+// Freezes an owning group, whose members then read their inputs from the
+// schedule, and checks it against a reference counter.
+static int check_owned(size_t n) {
+  const bits_t zero = 0, x = 1;
+  ma_id_t id[n];
+  moore_t* b[n];
+  ma_memory_usage_t before, after;
+
+  ma_group_t* g = ma_group_new();
+  ASSERT(g != NULL);
+  for (size_t i = 0; i < n; ++i) {
+    size_t inputs = i < 2 ? 1 : i;
+    id[i] = ma_group_add(g, inputs, 1, 1, t_carry, y_copy, &zero);
+    b[i] = ma_create_simple(inputs, 1, t_carry);
+    ASSERT(id[i] != MA_ID_INVALID && b[i] != NULL);
+    for (size_t j = 0; j < i; ++j) {
+      ASSERT(ma_id_connect(g, id[i], j, id[j], 0, 1) == 0);
+      ASSERT(ma_connect(b[i], j, b[j], 0, 1) == 0);
+    }
+  }
+  ASSERT(ma_id_set_input(g, id[0], &x) == 0 && ma_set_input(b[0], &x) == 0);
+  ma_group_t* h = ma_group_create(b, n);
+  ASSERT(h != NULL);
+
+  // The input records are replaced rather than supplemented by the schedule.
+  ASSERT(ma_group_memory_usage(g, &before) == 0 && ma_group_freeze(g) == 0);
+  ASSERT(ma_group_memory_usage(g, &after) == 0);
+  ASSERT(after.input_connections == 0);
+  ASSERT(after.input_connections + after.schedule < before.input_connections);
+  ASSERT(ma_group_step(g, 37) == 0 && ma_group_step(h, 37) == 0);
+  ASSERT(same_outputs(g, id, b, n) == PASS);
+
+  // Freezing again rebuilds the schedule from the one in place.
+  ASSERT(ma_group_freeze(g) == 0 && ma_group_memory_usage(g, &after) == 0);
+  ASSERT(after.input_connections == 0 && after.schedule > 0);
+  ASSERT(ma_group_step(g, 5) == 0 && ma_group_step(h, 5) == 0);
+  ASSERT(same_outputs(g, id, b, n) == PASS);
+
+  // Changes elsewhere do not invalidate the schedule of the group.
+  ma_group_t* other = ma_group_create(b, n);
+  ASSERT(other != NULL && ma_group_freeze(other) == 0);
+  ASSERT(ma_disconnect(b[9], 0, 1) == 0 && ma_connect(b[9], 0, b[0], 0, 1) == 0);
+  ASSERT(ma_group_step(g, 1) == 0 && ma_group_step(other, 1) == 0);
+  ASSERT(ma_group_memory_usage(g, &after) == 0 && after.schedule > 0);
+  ASSERT(ma_group_memory_usage(other, &after) == 0 && after.schedule == 0);
+  ma_group_delete(other);
+
+  // An edit gives the members their records back and patches the schedule.
+  ASSERT(ma_id_disconnect(g, id[9], 0, 1) == 0 && ma_id_connect(g, id[9], 0, id[0], 0, 1) == 0);
+  ASSERT(ma_group_memory_usage(g, &after) == 0);
+  ASSERT(after.input_connections == before.input_connections && after.schedule > 0);
+  ASSERT(ma_group_step(g, 1) == 0 && ma_group_step(h, 100) == 0 && ma_group_step(g, 99) == 0);
+  ASSERT(same_outputs(g, id, b, n) == PASS);
+
+  // Removing a member thaws the group first.
+  ASSERT(ma_group_freeze(g) == 0);
+  ASSERT(ma_group_remove(g, id[9]) == 0);
+  ASSERT(ma_group_step(g, 10) == 0 && ma_group_step(h, 10) == 0);
+  ASSERT(same_outputs(g, id, b, n - 1) == PASS);
+
+  // Deleting a frozen group deletes its members.
+  ASSERT(ma_group_freeze(g) == 0);
+  ma_group_delete(g);
+  ma_group_delete(h);
+  for (size_t i = 0; i < n; ++i) {
+    ma_delete(b[i]);
+  }
+  return PASS;
+}
+
+// Tests memory accounting and stepping of a frozen group.
+int memory_usage_test(void) {
+  size_t n = 10;
+  bits_t x = 1;
+  moore_t* a[n];
+  moore_t* b[n];
+  ma_memory_usage_t before, after, single;
+
+  for (size_t i = 0; i < n; ++i) {
+    a[i] = ma_create_simple(i < 2 ? 1 : i, 1, t_carry);
+    b[i] = ma_create_simple(i < 2 ? 1 : i, 1, t_carry);
+    ASSERT(a[i] != NULL && b[i] != NULL);
+    for (size_t j = 0; j < i; ++j) {
+      ASSERT(ma_connect(a[i], j, a[j], 0, 1) == 0);
+      ASSERT(ma_connect(b[i], j, b[j], 0, 1) == 0);
+    }
+  }
+  ASSERT(ma_set_input(a[0], &x) == 0);
+  ASSERT(ma_set_input(b[0], &x) == 0);
+
+  ASSERT(ma_memory_usage(a[0], &single) == 0);
+  ASSERT(single.input_connections > 0 && single.output_connections > 0);
+  ASSERT(single.total == single.buffers + single.input_connections + single.output_connections);
+
+  ma_group_t* g = ma_group_create(a, n);
+  ma_group_t* h = ma_group_create(b, n);
+  ASSERT(g != NULL && h != NULL);
+
+  ASSERT(ma_group_memory_usage(g, &before) == 0);
+  ASSERT(before.schedule == 0);
+  ASSERT(ma_group_freeze(g) == 0);
+  ASSERT(ma_group_memory_usage(g, &after) == 0);
+
+  // The fan-out arrays shrink to their exact size and the schedule takes
+  // 8 bytes per input bit.
+  ASSERT(after.output_connections < before.output_connections);
+  ASSERT(after.schedule >= 8 * (1 + 1 + 44) && after.schedule < before.input_connections);
+
+  for (size_t c = 0; c < 300; ++c) {
+    ASSERT(ma_group_step(g, 1) == 0 && ma_group_step(h, 1) == 0);
+    for (size_t i = 0; i < n; ++i) {
+      ASSERT(ma_get_output(a[i])[0] == ma_get_output(b[i])[0]);
+    }
+  }
+
+  // A topology change invalidates the schedule.
+  ASSERT(ma_disconnect(a[9], 0, 1) == 0);
+  ASSERT(ma_disconnect(b[9], 0, 1) == 0);
+  ASSERT(ma_group_step(g, 1) == 0 && ma_group_step(h, 1) == 0);
+  ASSERT(ma_group_memory_usage(g, &after) == 0 && after.schedule == 0);
+  ASSERT(ma_group_step(g, 100) == 0 && ma_group_step(h, 100) == 0);
+  ASSERT(ma_get_output(a[9])[0] == ma_get_output(b[9])[0]);
+
+  // Only connections inside the group can be frozen.
+  ma_group_t* part = ma_group_create(a + 1, n - 1);
+  ASSERT(part != NULL);
+  ASSERT(ma_group_freeze(part) == -1 && errno == EINVAL);
+  ma_group_delete(part);
+
+  ASSERT(ma_memory_usage(NULL, &single) == -1 && errno == EINVAL);
+  ASSERT(check_owned(n) == PASS);
+
+  ma_group_delete(g);
+  ma_group_delete(h);
+  for (size_t i = 0; i < n; ++i) {
+    ma_delete(a[i]);
+    ma_delete(b[i]);
+  }
+  return PASS;
+}
@@ -0,0 +1,69 @@
+#include "test.h"
+#include "errno.h"
+
+#define COUNT 1000
+
+static void xor_trans(bits_t* next_state, const bits_t* input,
+                      const bits_t* old_state, size_t, size_t) {
+  next_state[0] = old_state[0] ^ input[0];
+}
+
+static void id_out(bits_t* output, const bits_t* state, size_t, size_t) {
+  output[0] = state[0];
+}
+
+// Tests module templates with the counter of `two_bit_adder_test` as the module.
+int module_test(void) {
+  const bits_t zero = 0;
+  ma_module_t* mod = ma_module_new();
+  ASSERT(mod);
+
+  size_t lo = ma_module_add(mod, 1, 1, 1, xor_trans, id_out, &zero);
+  size_t hi = ma_module_add(mod, 1, 1, 1, xor_trans, id_out, &zero);
+  ASSERT(lo == 0 && hi == 1);
+
+  errno = 0;
+  ASSERT(ma_module_connect(mod, hi, 0, 2, 0, 1) == -1 && errno == EINVAL);
+  ASSERT(ma_module_connect(mod, hi, 0, lo, 0, 1) == 0);
+  ASSERT(ma_module_input(mod, 0, lo, 0, 1) == 0);
+  ASSERT(ma_module_output(mod, 0, lo, 0, 1) == 0);
+  ASSERT(ma_module_output(mod, 1, hi, 0, 1) == 0);
+
+  ASSERT(!ma_module_instantiate(mod, 0) && errno == EINVAL);
+  ma_instances_t* x = ma_module_instantiate(mod, COUNT);
+  ASSERT(x && ma_instances_count(x) == COUNT);
+  ma_module_delete(mod);
+
+  // Odd instances count, even ones hold.
+  for (size_t i = 0; i < COUNT; ++i) {
+    bits_t enable = i & 1;
+    ASSERT(ma_instances_set_input(x, i, &enable) == 0);
+  }
+
+  // The same counter built from individual automata for comparison.
+  bits_t one = 1;
+  moore_t* a[2] = {ma_create_simple(1, 1, xor_trans), ma_create_simple(1, 1, xor_trans)};
+  ASSERT(a[0] && a[1]);
+  ASSERT(ma_set_input(a[0], &one) == 0);
+  ASSERT(ma_connect(a[1], 0, a[0], 0, 1) == 0);
+
+  for (size_t step = 0; step < 6; ++step) {
+    ASSERT(ma_instances_step(x, 1) == 0);
+    ASSERT(ma_step(a, SIZE(a)) == 0);
+    bits_t expected = ma_get_output(a[0])[0] | ma_get_output(a[1])[0] << 1;
+
+    for (size_t i = 0; i < COUNT; ++i) {
+      bits_t out;
+      ASSERT(ma_instances_get_output(x, i, &out) == 0);
+      ASSERT(out == (i & 1 ? expected : 0));
+    }
+  }
+
+  ASSERT(ma_instances_get_output(x, COUNT, &one) == -1 && errno == EINVAL);
+
+  ma_delete(a[0]);
+  ma_delete(a[1]);
+  ma_instances_delete(x);
+
+  return PASS;
+}
@@ -0,0 +1,127 @@
+#include "test.h"
+#include "errno.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "unistd.h"
+
+// Toggles when all inputs are set (same as in n_bit_adder.c).
+static void t_carry(bits_t* next_state, const bits_t* input,
+                    const bits_t* old_state, size_t n, size_t) {
+  bits_t all_set = (1ULL << n) - 1;
+  next_state[0] = (input[0] & all_set) == all_set ? old_state[0] ^ 1 : old_state[0];
+}
+
+static void sum_trans(bits_t* next_state, const bits_t* input,
+                      const bits_t* old_state, size_t, size_t) {
+  next_state[0] = old_state[0] + input[0];
+}
+
+static void add_one(bits_t* output, const bits_t* state, size_t, size_t) {
+  output[0] = state[0] + 1;
+}
+
+static const ma_func_entry_t entries[] = {
+  {.id = 7, .t = t_carry},
+  {.id = 9, .t = sum_trans, .y = add_one},
+};
+
+// Saves the n bit counter from n_bit_adder.c feeding an accumulator and
+// checks that the loaded copy behaves the same.
+int netlist_test(void) {
+  char path[] = "/tmp/ma_netlist_XXXXXX";
+  size_t n = 10;
+  bits_t x = 1, q = 5;
+  moore_t* a[n + 1];
+  ma_func_registry_t reg = {.entries = entries, .num = SIZE(entries)};
+
+  int fd = mkstemp(path);
+  ASSERT(fd != -1);
+  close(fd);
+
+  for (size_t i = 0; i < n; ++i) {
+    a[i] = ma_create_simple(i < 2 ? 1 : i, 1, t_carry);
+    ASSERT(a[i] != NULL);
+    for (size_t j = 0; j < i; ++j) {
+      ASSERT(ma_connect(a[i], j, a[j], 0, 1) == 0);
+    }
+  }
+  ASSERT(ma_set_input(a[0], &x) == 0);
+
+  // The accumulator sums the counter bits 3..8 shifted by 2.
+  a[n] = ma_create_full(64, 64, 64, sum_trans, add_one, &q);
+  ASSERT(a[n] != NULL);
+  for (size_t i = 3; i < 9; ++i) {
+    ASSERT(ma_connect(a[n], i - 1, a[i], 0, 1) == 0);
+  }
+
+  ma_group_t* g = ma_group_create(a, n + 1);
+  ASSERT(g != NULL);
+  ASSERT(ma_group_step(g, 37) == 0);
+  ASSERT(ma_save_netlist(g, path, &reg) == 0);
+
+  ma_group_t* h = ma_load_netlist(path, &reg);
+  ASSERT(h != NULL);
+
+  // The fan-out arrays are loaded at their exact size, which freezing keeps,
+  // and the group is returned frozen without any input records.
+  ma_memory_usage_t loaded, frozen;
+  ASSERT(ma_group_memory_usage(h, &loaded) == 0 && ma_group_freeze(h) == 0);
+  ASSERT(ma_group_memory_usage(h, &frozen) == 0);
+  ASSERT(frozen.output_connections == loaded.output_connections);
+  ASSERT(loaded.input_connections == 0 && loaded.schedule != 0);
+  ASSERT(frozen.total == loaded.total);
+
+  // Steps both networks and compares the outputs via snapshots.
+  size_t size = ma_snapshot_size(g);
+  ASSERT(size == ma_snapshot_size(h));
+  bits_t* sg = malloc(size);
+  bits_t* sh = malloc(size);
+  ASSERT(sg != NULL && sh != NULL);
+  for (size_t c = 0; c < 100; ++c) {
+    ASSERT(ma_group_step(g, 1) == 0 && ma_group_step(h, 1) == 0);
+    ASSERT(ma_snapshot(g, sg) == 0 && ma_snapshot(h, sh) == 0);
+    // The cycle word differs, the rest must match.
+    for (size_t w = 1; w < size / sizeof(bits_t); ++w) {
+      ASSERT(sg[w] == sh[w]);
+    }
+  }
+  free(sg);
+  free(sh);
+
+  // The loaded group owns its members and can be compacted and extended.
+  ASSERT(ma_group_compact(h) == 0);
+  moore_t* extra = ma_group_get(h, ma_group_add(h, 1, 1, 64, sum_trans, add_one, &q));
+  ASSERT(extra && ma_set_input(extra, &x) == 0 && ma_group_compact(h) == 0);
+  ASSERT(ma_group_step(h, 3) == 0 && ma_get_output(extra)[0] == q + 3 * x + 1);
+
+  // A function missing from the registry cannot be saved or loaded.
+  ma_func_registry_t partial = {.entries = entries, .num = 1};
+  ASSERT(ma_save_netlist(g, path, &partial) == -1 && errno == EINVAL);
+  ASSERT(ma_save_netlist(h, path, &reg) == 0);
+  ASSERT(ma_load_netlist(path, &partial) == NULL && errno == EINVAL);
+
+  // Drivers outside of the group cannot be described.
+  ma_group_t* part = ma_group_create(a + 1, n);
+  ASSERT(part != NULL);
+  ASSERT(ma_save_netlist(part, path, &reg) == -1 && errno == EINVAL);
+  ma_group_delete(part);
+
+  // Bit counts whose connection arrays would overflow are rejected.
+  uint64_t huge[] = {0, 1, 0, 0, (uint64_t) 1 << 61, 1, 7, 0};
+  memcpy(huge, "MANET001", 8);
+  FILE* f = fopen(path, "wb");
+  ASSERT(f != NULL);
+  ASSERT(fwrite(huge, sizeof(huge), 1, f) == 1);
+  fclose(f);
+  errno = 0;
+  ASSERT(ma_load_netlist(path, &reg) == NULL && errno == EINVAL);
+
+  ma_group_delete(h);
+  ma_group_delete(g);
+  for (size_t i = 0; i <= n; ++i) {
+    ma_delete(a[i]);
+  }
+  unlink(path);
+  return PASS;
+}
@@ -0,0 +1,103 @@
+#include "test.h"
+#include "errno.h"
+
+static void t_hold(bits_t* next_state, const bits_t*, const bits_t* state, size_t, size_t) {
+  next_state[0] = state[0];
+}
+
+static void t_shift(bits_t* next_state, const bits_t*, const bits_t* state, size_t, size_t) {
+  next_state[0] = state[0] >> 1;
+}
+
+static void t_count(bits_t* next_state, const bits_t*, const bits_t* state, size_t, size_t) {
+  next_state[0] = (state[0] + 1) & 0xff;
+}
+
+// The enable (bit 0) is driven, the step (bits 1-2) is a free input.
+static void t_accumulate(bits_t* next_state, const bits_t* input, const bits_t* state, size_t,
+                         size_t) {
+  next_state[0] = (input[0] & 1) ? (state[0] + (input[0] >> 1)) & 3 : state[0];
+}
+
+static void id_out(bits_t* output, const bits_t* state, size_t, size_t) {
+  output[0] = state[0];
+}
+
+// Builds the test network and returns its members in `a`.
+static ma_group_t* build(moore_t* a[6]) {
+  const bits_t zero = 0, full = 0xff, five = 5;
+  ma_id_t id[6];
+  ma_group_t* g = ma_group_new();
+  if (!g) {
+    return NULL;
+  }
+
+  id[0] = ma_group_add(g, 0, 8, 8, t_hold, id_out, &five);
+  id[1] = ma_group_add(g, 0, 8, 8, t_shift, id_out, &full);
+  id[2] = ma_group_add(g, 3, 2, 2, t_accumulate, id_out, &zero);
+  id[3] = ma_group_add(g, 0, 8, 8, t_count, id_out, &zero);
+  id[4] = ma_group_add(g, 1, 1, 1, t_hold, id_out, &zero);
+  id[5] = ma_group_add(g, 0, 1, 1, t_hold, id_out, &zero);
+  for (size_t i = 0; i < 6; ++i) {
+    a[i] = ma_group_get(g, id[i]);
+  }
+
+  bits_t step = 3 << 1;
+  if (!a[5] || ma_connect(a[2], 0, a[3], 0, 1) == -1 || ma_connect(a[4], 0, a[3], 0, 1) == -1 ||
+      ma_connect(a[4], 0, a[5], 0, 1) == -1 || ma_set_input(a[2], &step) == -1) {
+    ma_group_delete(g);
+    return NULL;
+  }
+
+  return g;
+}
+
+static int same_outputs(moore_t* a[], moore_t* b[], size_t num) {
+  for (size_t i = 0; i < num; ++i) {
+    if (ma_get_output(a[i])[0] != ma_get_output(b[i])[0]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Tests `ma_group_optimize` against an unoptimised copy of the same network.
+int optimize_test(void) {
+  moore_t *a[6], *ref[6];
+  ma_group_t* g = build(a);
+  ma_group_t* r = build(ref);
+  ASSERT(g && r);
+
+  moore_t* observed[3] = {a[0], a[1], a[2]};
+  ma_optimize_result_t res;
+  errno = 0;
+  ASSERT(ma_group_optimize(g, (moore_t*[]) {ref[0]}, 1, &res) == -1 && errno == EINVAL);
+  ASSERT(ma_group_optimize(g, observed, SIZE(observed), &res) == 0);
+  ASSERT(res.num_removed == 2 && res.num_folded == 1 && res.num_settling == 3);
+
+  for (size_t c = 0; c < 40; ++c) {
+    ASSERT(ma_group_step(g, 1) == 0 && ma_group_step(r, 1) == 0);
+    ASSERT(same_outputs(a, ref, 3));
+  }
+  ASSERT(ma_cycle(a[0]) == 40 && ma_get_output(a[1])[0] == 0);
+
+  // Changing a folded input or a settled state is still honoured.
+  bits_t step = 1 << 1, state = 0x80;
+  ASSERT(ma_set_input(a[2], &step) == 0 && ma_set_input(ref[2], &step) == 0);
+  ASSERT(ma_set_state(a[1], &state) == 0 && ma_set_state(ref[1], &state) == 0);
+  for (size_t c = 0; c < 20; ++c) {
+    ASSERT(ma_group_step(g, 1) == 0 && ma_group_step(r, 1) == 0);
+    ASSERT(same_outputs(a, ref, 3));
+  }
+
+  // Optimising again refolds; without observed automata nothing is removed.
+  ASSERT(ma_group_optimize(g, NULL, 0, &res) == 0);
+  ASSERT(res.num_removed == 0 && res.num_folded == 1);
+  ASSERT(ma_group_step(g, 9) == 0 && ma_group_step(r, 9) == 0);
+  ASSERT(same_outputs(a, ref, 3));
+
+  ma_group_delete(g);
+  ma_group_delete(r);
+
+  return PASS;
+}
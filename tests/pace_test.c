@@ -0,0 +1,87 @@
+#include "test.h"
+#include "errno.h"
+#include "time.h"
+
+#define PERIOD_NS 200000
+
+static void t_count(bits_t* next_state, const bits_t*, const bits_t* state, size_t, size_t) {
+  next_state[0] = state[0] + 1;
+}
+
+static void id_out(bits_t* output, const bits_t* state, size_t, size_t) {
+  output[0] = state[0];
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+typedef struct {
+  ma_id_t id;
+  uint64_t last;
+} hook_ctx_t;
+
+// Checks the output seen by the hook and stops at tick `last`. Tick 3 takes
+// longer than a period.
+static int hook(ma_group_t* g, uint64_t tick, void* ctx) {
+  const hook_ctx_t* c = ctx;
+  if (ma_id_get_output(g, c->id)[0] != tick) {
+    return -1;
+  }
+  if (tick == 3) {
+    struct timespec ts = {.tv_nsec = 3 * PERIOD_NS};
+    nanosleep(&ts, NULL);
+  }
+  return tick == c->last;
+}
+
+static uint64_t hist_sum(const ma_pace_stats_t* stats) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < MA_STATS_BUCKETS; ++i) {
+    sum += stats->latency_hist[i];
+  }
+  return sum;
+}
+
+// Tests the rate, the hook and the statistics of `ma_run_paced`.
+int pace_test(void) {
+  const bits_t zero = 0;
+  ma_group_t* g = ma_group_new();
+  ASSERT(g && ma_group_add(g, 0, 16, 16, t_count, id_out, &zero) != MA_ID_INVALID);
+
+  ma_pace_opts_t opts = {.period_ns = PERIOD_NS, .ticks = 20, .cpu = -1};
+  ma_pace_stats_t stats;
+  for (int mode = MA_PACE_SLEEP; mode <= MA_PACE_HYBRID; ++mode) {
+    opts.mode = mode;
+    opts.spin_ns = PERIOD_NS / 4;
+    uint64_t start = now_ns();
+    ASSERT(ma_run_paced(g, &opts, &stats) == 0);
+    ASSERT(now_ns() - start >= 19 * PERIOD_NS);
+    ASSERT(stats.ticks == 20 && hist_sum(&stats) == 20);
+    ASSERT(stats.max_latency_ns >= stats.max_jitter_ns);
+  }
+  ASSERT(ma_group_cycle(g) == 60);
+
+  // The hook ends an unbounded run.
+  ma_group_t* h = ma_group_new();
+  hook_ctx_t ctx = {.last = 10};
+  ASSERT(h && (ctx.id = ma_group_add(h, 0, 16, 16, t_count, id_out, &zero)) != MA_ID_INVALID);
+  opts = (ma_pace_opts_t) {.period_ns = PERIOD_NS, .mode = MA_PACE_HYBRID,
+                           .spin_ns = PERIOD_NS / 4, .cpu = -1, .hook = hook, .ctx = &ctx};
+  ASSERT(ma_run_paced(h, &opts, &stats) == 0);
+  ASSERT(stats.ticks == 10 && ma_group_cycle(h) == 10 && stats.overruns >= 1);
+  ASSERT(stats.max_latency_ns >= 3 * PERIOD_NS);
+
+  errno = 0;
+  opts.period_ns = 0;
+  ASSERT(ma_run_paced(h, &opts, NULL) == -1 && errno == EINVAL);
+  opts.period_ns = PERIOD_NS;
+  opts.cpu = 1 << 20;
+  ASSERT(ma_run_paced(h, &opts, NULL) == -1 && errno == EINVAL);
+
+  ma_group_delete(h);
+  ma_group_delete(g);
+  return PASS;
+}
@@ -0,0 +1,143 @@
+#include "test.h"
+#include "stdint.h"
+
+// Counts the calls of `t_wide` on buffers that are not aligned.
+static size_t misaligned;
+
+static int is_aligned(const void* p) {
+  return (uintptr_t) p % MA_BUFFER_ALIGN == 0;
+}
+
+// A counter that writes garbage past its state and output bits, as a
+// vectorised function storing whole vectors would.
+static void t_wide(bits_t* next_state, const bits_t* input, const bits_t* state, size_t,
+                   size_t) {
+  misaligned += !is_aligned(next_state) || !is_aligned(input) || !is_aligned(state);
+  for (size_t i = 0; i < MA_BUFFER_PAD / sizeof(bits_t); ++i) {
+    next_state[i] = ~(bits_t) 0;
+  }
+  next_state[0] = ((state[0] + input[0]) & 0x1f) | ~(bits_t) 0x1f;
+}
+
+static void y_wide(bits_t* output, const bits_t* state, size_t, size_t) {
+  for (size_t i = 0; i < MA_BUFFER_PAD / sizeof(bits_t); ++i) {
+    output[i] = ~(bits_t) 0;
+  }
+  output[0] = state[0] | ~(bits_t) 0x7;
+}
+
+static void t_narrow(bits_t* next_state, const bits_t*, const bits_t* state, size_t, size_t) {
+  next_state[0] = state[0];
+}
+
+static void y_narrow(bits_t* output, const bits_t* state, size_t, size_t) {
+  output[0] = state[0] & 0x7;
+}
+
+// Returns whether the bits of the first pad of `buf` past `bits` are zero.
+static int pad_is_zero(const bits_t* buf, size_t bits) {
+  if (bits % 64 != 0 && buf[bits / 64] >> (bits % 64) != 0) {
+    return 0;
+  }
+  for (size_t i = (bits + 63) / 64; i < MA_BUFFER_PAD / sizeof(bits_t); ++i) {
+    if (buf[i] != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Builds a padded counter driving bit 0 of a second one, whose bit 1 is set.
+static ma_group_t* build_pair(moore_t* a[2]) {
+  const bits_t q = 3, one = 1, two = 2;
+  ma_group_t* g = ma_group_new();
+  if (!g || ma_group_set_padded(g, 1) == -1) {
+    ma_group_delete(g);
+    return NULL;
+  }
+
+  a[0] = ma_group_get(g, ma_group_add(g, 1, 3, 5, t_wide, y_wide, &q));
+  a[1] = ma_group_get(g, ma_group_add(g, 2, 3, 5, t_wide, y_wide, &q));
+  if (!a[0] || !a[1] || ma_set_input(a[0], &one) == -1 || ma_set_input(a[1], &two) == -1 ||
+      ma_connect(a[1], 0, a[0], 0, 1) == -1) {
+    ma_group_delete(g);
+    return NULL;
+  }
+  return g;
+}
+
+// Padded members are folded and explored on buffers laid out like their own.
+static int check_scratch(void) {
+  moore_t *a[2], *ref[2];
+  ma_group_t* g = build_pair(a);
+  ma_group_t* r = build_pair(ref);
+  ASSERT(g && r);
+
+  misaligned = 0;
+  ma_optimize_result_t res;
+  ASSERT(ma_group_optimize(g, NULL, 0, &res) == 0 && res.num_folded == 1);
+  for (int i = 0; i < 20; ++i) {
+    ASSERT(ma_group_step(g, 1) == 0 && ma_group_step(r, 1) == 0);
+    ASSERT(ma_get_output(a[1])[0] == ma_get_output(ref[1])[0]);
+  }
+
+  ma_reach_result_t reach;
+  ma_reach_opts_t opts = {.num_threads = 2};
+  ASSERT(ma_reach(ref, 2, &opts, &reach) == 0 && reach.num_states == 1024);
+  ma_reach_result_free(&reach);
+  ASSERT(misaligned == 0);
+
+  ma_group_delete(g);
+  ma_group_delete(r);
+  return PASS;
+}
+
+// Tests the alignment of padded buffers and that their pad stays zero.
+int padded_test(void) {
+  const bits_t q = 3;
+  const bits_t one = 1;
+
+  moore_t* a = ma_create_padded(1, 3, 5, t_wide, y_wide, &q);
+  ASSERT(a);
+  const bits_t* out = ma_get_output(a);
+  ASSERT(is_aligned(out));
+  ASSERT(out[0] == 3 && pad_is_zero(out, 3));
+
+  ASSERT(ma_set_input(a, &one) == 0);
+  for (int i = 0; i < 40; ++i) {
+    ASSERT(ma_step(&a, 1) == 0);
+  }
+  ASSERT(out[0] == ((3 + 40) & 0x1f & 0x7) && pad_is_zero(out, 3));
+
+  ASSERT(ma_set_state(a, &(bits_t) {~(bits_t) 0}) == 0);
+  ASSERT(out[0] == 0x7 && pad_is_zero(out, 3));
+
+  // Padded members keep their alignment when compacted next to unpadded ones.
+  ma_group_t* g = ma_group_new();
+  ASSERT(g);
+  ma_id_t plain = ma_group_add(g, 1, 3, 5, t_narrow, y_narrow, &q);
+  ASSERT(ma_group_set_padded(g, 1) == 0);
+  ma_id_t ids[3];
+  for (int i = 0; i < 3; ++i) {
+    ids[i] = ma_group_add(g, 1, 3, 5, t_wide, y_wide, &q);
+    ASSERT(ids[i] != MA_ID_INVALID);
+    ASSERT(is_aligned(ma_id_get_output(g, ids[i])));
+  }
+  ASSERT(plain != MA_ID_INVALID);
+  ASSERT(ma_group_compact(g) == 0);
+  for (int i = 0; i < 3; ++i) {
+    ASSERT(ma_id_set_input(g, ids[i], &one) == 0);
+  }
+  ASSERT(ma_group_step(g, 7) == 0);
+  for (int i = 0; i < 3; ++i) {
+    const bits_t* o = ma_id_get_output(g, ids[i]);
+    ASSERT(is_aligned(o));
+    ASSERT(o[0] == ((3 + 7) & 0x7) && pad_is_zero(o, 3));
+  }
+
+  ma_group_delete(g);
+  ma_delete(a);
+
+  ASSERT(check_scratch() == PASS);
+  return PASS;
+}
@@ -0,0 +1,123 @@
+#include "test.h"
+#include "errno.h"
+#include "pthread.h"
+#include "sched.h"
+
+#define PRODUCERS 4
+#define PER_PRODUCER 5000
+
+static void t_latch(bits_t* next_state, const bits_t* input, const bits_t*, size_t, size_t) {
+  next_state[0] = input[0];
+}
+
+typedef struct {
+  ma_port_t* port;
+  uint64_t id;
+} producer_t;
+
+static void* produce(void* arg) {
+  producer_t* p = arg;
+  for (uint64_t i = 1; i <= PER_PRODUCER; ++i) {
+    bits_t v = p->id << 32 | i;
+    while (ma_port_push(p->port, &v, 0) == -1) {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+// Checks that concurrently pushed vectors are each applied once, in order per producer.
+static int concurrent_test(void) {
+  moore_t* a = ma_create_simple(64, 64, t_latch);
+  ASSERT(a);
+  ma_port_t* port = ma_port_open(a, MA_PORT_QUEUED, 64);
+  ASSERT(port);
+
+  pthread_t threads[PRODUCERS];
+  producer_t args[PRODUCERS];
+  for (size_t i = 0; i < PRODUCERS; ++i) {
+    args[i] = (producer_t) {.port = port, .id = i};
+    ASSERT(pthread_create(&threads[i], NULL, produce, &args[i]) == 0);
+  }
+
+  uint64_t last[PRODUCERS] = {0};
+  size_t seen = 0;
+  bits_t prev = 0;
+  const bits_t* y = ma_get_output(a);
+  while (seen < PRODUCERS * PER_PRODUCER) {
+    ASSERT(ma_step(&a, 1) == 0);
+    if (y[0] == prev) {
+      sched_yield();
+      continue;
+    }
+    prev = y[0];
+    uint64_t id = y[0] >> 32, i = y[0] & 0xffffffffu;
+    ASSERT(id < PRODUCERS && i == last[id] + 1);
+    last[id] = i;
+    ++seen;
+  }
+
+  for (size_t i = 0; i < PRODUCERS; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+
+  // Deleting the automaton closes its port.
+  ma_delete(a);
+
+  return PASS;
+}
+
+// Tests input ports: modes, cycle stamps, capacity and argument checks.
+int port_test(void) {
+  bits_t v;
+  moore_t* a = ma_create_simple(64, 64, t_latch);
+  moore_t* b = ma_create_simple(0, 64, t_latch);
+  ASSERT(a && b);
+
+  errno = 0;
+  ASSERT(!ma_port_open(b, MA_PORT_LATEST, 4) && errno == EINVAL);
+  ASSERT(!ma_port_open(a, MA_PORT_LATEST, 0) && errno == EINVAL);
+
+  ma_port_t* p = ma_port_open(a, MA_PORT_LATEST, 3);
+  ASSERT(p);
+  ASSERT(!ma_port_open(a, MA_PORT_QUEUED, 4) && errno == EBUSY);
+
+  // The newest due vector wins; the capacity is rounded up to 4.
+  for (v = 1; v <= 4; ++v) {
+    ASSERT(ma_port_push(p, &v, 0) == 0);
+  }
+  ASSERT(ma_port_push(p, &v, 0) == -1 && errno == EAGAIN);
+  ASSERT(ma_step(&a, 1) == 0);
+  ASSERT(ma_get_output(a)[0] == 4 && ma_cycle(a) == 1);
+
+  // A vector stamped for cycle 3 is applied by the step leaving cycle 3.
+  v = 9;
+  ASSERT(ma_port_push(p, &v, 3) == 0);
+  ASSERT(ma_step(&a, 1) == 0 && ma_step(&a, 1) == 0);
+  ASSERT(ma_get_output(a)[0] == 4);
+  ASSERT(ma_step(&a, 1) == 0);
+  ASSERT(ma_get_output(a)[0] == 9 && ma_cycle(a) == 4);
+  ma_port_close(p);
+
+  // Queued vectors are applied one per step, also by groups.
+  ma_group_t* g = ma_group_create(&a, 1);
+  ASSERT(g);
+  p = ma_port_open(a, MA_PORT_QUEUED, 8);
+  ASSERT(p);
+  for (v = 1; v <= 3; ++v) {
+    ASSERT(ma_port_push(p, &v, 0) == 0);
+  }
+  for (v = 1; v <= 3; ++v) {
+    ASSERT(ma_group_step(g, 1) == 0);
+    ASSERT(ma_get_output(a)[0] == v);
+  }
+  ASSERT(ma_group_step(g, 1) == 0);
+  ASSERT(ma_get_output(a)[0] == 3);
+  ma_port_close(p);
+  ma_group_delete(g);
+
+  ma_delete(a);
+  ma_delete(b);
+
+  return concurrent_test();
+}
@@ -0,0 +1,89 @@
+#include "test.h"
+#include "errno.h"
+
+static void xor_trans(bits_t* next_state, const bits_t* input,
+                      const bits_t* old_state, size_t, size_t) {
+  next_state[0] = (old_state[0] ^ input[0]) & 1;
+}
+
+// Toggles when all inputs are set (same as in n_bit_adder.c).
+static void t_carry(bits_t* next_state, const bits_t* input,
+                    const bits_t* old_state, size_t n, size_t) {
+  bits_t all_set = (1ULL << n) - 1;
+  next_state[0] = (input[0] & all_set) == all_set ? old_state[0] ^ 1 : old_state[0];
+}
+
+// Target: both automata output one.
+static int both_set(const bits_t* const outputs[], size_t num, void*) {
+  return num == 2 && outputs[0][0] == 1 && outputs[1][0] == 1;
+}
+
+// Explores the two bit counter from two_bit_adder.c with a free enable input.
+static int counter_trace(void) {
+  moore_t* a[2];
+  ma_reach_result_t res;
+
+  a[0] = ma_create_simple(1, 1, xor_trans);
+  a[1] = ma_create_simple(1, 1, xor_trans);
+  ASSERT(a[0] != NULL && a[1] != NULL);
+  ASSERT(ma_connect(a[1], 0, a[0], 0, 1) == 0);
+
+  ma_reach_opts_t opts = {.num_threads = 2, .predicate = both_set};
+  ASSERT(ma_reach(a, SIZE(a), &opts, &res) == 0);
+
+  // The shortest path to 11 is 00 -(x = 1)-> 01 -(x = 0)-> 11.
+  ASSERT(res.found);
+  ASSERT(res.state_words == 1);
+  ASSERT(res.trace_len == 3);
+  ASSERT(res.trace_states[0] == 0 && res.trace_states[1] == 1 && res.trace_states[2] == 3);
+  ASSERT(res.trace_inputs[0] == 1 && res.trace_inputs[1] == 0);
+  ma_reach_result_free(&res);
+
+  opts.predicate = NULL;
+  ASSERT(ma_reach(a, SIZE(a), &opts, &res) == 0);
+  ASSERT(!res.found && res.num_states == 4 && res.trace_len == 0);
+  ma_reach_result_free(&res);
+
+  ma_delete(a[0]);
+  ma_delete(a[1]);
+  return PASS;
+}
+
+// Explores an 8 bit counter with a tiny memory budget, forcing the frontier to disk.
+static int counter_spill(void) {
+  size_t n = 8;
+  moore_t* a[n];
+  ma_reach_result_t res;
+
+  for (size_t i = 0; i < n; ++i) {
+    a[i] = ma_create_simple(i < 2 ? 1 : i, 1, t_carry);
+    ASSERT(a[i] != NULL);
+    for (size_t j = 0; j < i; ++j) {
+      ASSERT(ma_connect(a[i], j, a[j], 0, 1) == 0);
+    }
+  }
+
+  ma_reach_opts_t opts = {.num_threads = 4, .memory_budget = sizeof(uint64_t)};
+  ASSERT(ma_reach(a, n, &opts, &res) == 0);
+  ASSERT(res.num_states == 256 && res.depth > 1);
+  ma_reach_result_free(&res);
+
+  opts.max_states = 100;
+  errno = 0;
+  ASSERT(ma_reach(a, n, &opts, &res) == -1 && errno == ENOSPC);
+
+  ASSERT(ma_reach(NULL, n, &opts, &res) == -1 && errno == EINVAL);
+  ASSERT(ma_reach(a, 0, &opts, &res) == -1 && errno == EINVAL);
+
+  for (size_t i = 0; i < n; ++i) {
+    ma_delete(a[i]);
+  }
+  return PASS;
+}
+
+// Tests exhaustive exploration of reachable global states.
+int reach_test(void) {
+  ASSERT(counter_trace() == PASS);
+  ASSERT(counter_spill() == PASS);
+  return PASS;
+}
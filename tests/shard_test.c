@@ -0,0 +1,93 @@
+#include "test.h"
+#include "errno.h"
+#include "unistd.h"
+
+#define RING 6
+
+static void t_mix(bits_t* next_state, const bits_t* input, const bits_t* state, size_t, size_t) {
+  next_state[0] = (state[0] * 3 + input[0] + 1) & 0xff;
+}
+
+// Terminates the process that steps it once the state reaches 4.
+static void t_crash(bits_t* next_state, const bits_t*, const bits_t* state, size_t, size_t) {
+  if (state[0] == 4) {
+    _exit(3);
+  }
+  next_state[0] = state[0] + 1;
+}
+
+static void id_out(bits_t* output, const bits_t* state, size_t, size_t) {
+  output[0] = state[0];
+}
+
+// Builds a ring of automata, each driven by its predecessor.
+static ma_group_t* build(moore_t* a[RING]) {
+  ma_group_t* g = ma_group_new();
+  if (!g) {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < RING; ++i) {
+    bits_t q = i * 7;
+    a[i] = ma_group_get(g, ma_group_add(g, 8, 8, 8, t_mix, id_out, &q));
+    if (!a[i]) {
+      ma_group_delete(g);
+      return NULL;
+    }
+  }
+  for (size_t i = 0; i < RING; ++i) {
+    if (ma_connect(a[i], 0, a[(i + RING - 1) % RING], 0, 8) == -1) {
+      ma_group_delete(g);
+      return NULL;
+    }
+  }
+
+  return g;
+}
+
+// Tests `ma_run_sharded` against the same network stepped in one process.
+int shard_test(void) {
+  moore_t *a[RING], *ref[RING];
+  ma_group_t* g = build(a);
+  ma_group_t* r = build(ref);
+  ASSERT(g && r);
+
+  const size_t shard_of[RING] = {0, 1, 2, 2, 1, 0};
+  errno = 0;
+  ASSERT(ma_run_sharded(g, shard_of, 2, 10) == -1 && errno == EINVAL);
+  ASSERT(ma_run_sharded(g, shard_of, 3, 0) == 0);
+
+  for (size_t k = 1; k < 5; ++k) {
+    ASSERT(ma_run_sharded(g, shard_of, 3, k * 5) == 0);
+    ASSERT(ma_group_step(r, k * 5) == 0);
+    ASSERT(ma_cycle(a[0]) == ma_cycle(ref[0]));
+    for (size_t i = 0; i < RING; ++i) {
+      ASSERT(ma_get_output(a[i])[0] == ma_get_output(ref[i])[0]);
+    }
+  }
+
+  ma_group_delete(r);
+  ma_group_delete(g);
+
+  // A shard that dies aborts the run and leaves the group unchanged.
+  bits_t zero = 0;
+  g = ma_group_new();
+  ASSERT(g);
+  moore_t* c = ma_group_get(g, ma_group_add(g, 0, 8, 8, t_crash, id_out, &zero));
+  moore_t* d = ma_group_get(g, ma_group_add(g, 8, 8, 8, t_mix, id_out, &zero));
+  ASSERT(c && d && ma_connect(d, 0, c, 0, 8) == 0);
+
+  const size_t split[2] = {0, 1};
+  errno = 0;
+  ASSERT(ma_run_sharded(g, split, 2, 10) == -1 && errno == EIO);
+  ASSERT(ma_get_output(c)[0] == 0 && ma_cycle(c) == 0);
+
+  // So does one that is not the first shard, while the first one waits.
+  const size_t last[2] = {1, 0};
+  errno = 0;
+  ASSERT(ma_run_sharded(g, last, 2, 10) == -1 && errno == EIO);
+  ASSERT(ma_get_output(d)[0] == 0 && ma_cycle(d) == 0);
+
+  ma_group_delete(g);
+  return PASS;
+}
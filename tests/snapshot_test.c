@@ -0,0 +1,102 @@
+#include "test.h"
+#include "errno.h"
+#include "stdlib.h"
+
+// Transition function: adds input to the state.
+static void sum_trans(bits_t* next_state, const bits_t* input,
+                      const bits_t* old_state, size_t, size_t) {
+  next_state[0] = old_state[0] + input[0];
+}
+
+// Transition function: mixes the state so that every cycle differs.
+static void mix_trans(bits_t* next_state, const bits_t* input,
+                      const bits_t* old_state, size_t, size_t) {
+  next_state[0] = old_state[0] * 6364136223846793005ULL + input[0] + 1442695040888963407ULL;
+}
+
+// Tests checkpointing with `ma_snapshot`/`ma_restore` and rewinding to past cycles.
+int snapshot_test(void) {
+  size_t cycles = 50;
+  bits_t one = 1, history[cycles + 1][2];
+  moore_t* a[2];
+
+  a[0] = ma_create_simple(64, 64, sum_trans);
+  a[1] = ma_create_simple(64, 64, mix_trans);
+  ASSERT(a[0] != NULL && a[1] != NULL);
+  ASSERT(ma_set_input(a[0], &one) == 0);
+  ASSERT(ma_connect(a[1], 0, a[0], 0, 64) == 0);
+
+  ma_group_t* g = ma_group_create(a, SIZE(a));
+  ASSERT(g != NULL);
+
+  bits_t* snap = malloc(ma_snapshot_size(g));
+  bits_t* mid = malloc(ma_snapshot_size(g));
+  ASSERT(snap != NULL && mid != NULL);
+  ASSERT(ma_snapshot(g, snap) == 0);
+
+  ma_rewind_t* r = ma_rewind_start(g, 8);
+  ASSERT(r != NULL);
+  ASSERT(ma_rewind_start(g, 8) == NULL && errno == EBUSY);
+
+  for (size_t c = 0; c <= cycles; ++c) {
+    history[c][0] = ma_get_output(a[0])[0];
+    history[c][1] = ma_get_output(a[1])[0];
+    if (c == 10) {
+      ASSERT(ma_snapshot(g, mid) == 0);
+    }
+    if (c < cycles) {
+      ASSERT(ma_group_step(g, 1) == 0);
+    }
+  }
+
+  // Rewind to arbitrary cycles, both keyframes and in between.
+  size_t targets[] = {37, 8, 50, 0, 23};
+  for (size_t i = 0; i < SIZE(targets); ++i) {
+    ASSERT(ma_rewind_to(r, targets[i]) == 0);
+    ASSERT(ma_group_cycle(g) == targets[i]);
+    ASSERT(ma_get_output(a[0])[0] == history[targets[i]][0]);
+    ASSERT(ma_get_output(a[1])[0] == history[targets[i]][1]);
+    if (targets[i] == 23) {
+      break;
+    }
+    // Recording goes on after the restored cycle.
+    ASSERT(ma_group_step(g, cycles - targets[i]) == 0);
+    ASSERT(ma_get_output(a[1])[0] == history[cycles][1]);
+  }
+
+  // The future after cycle 23 was dropped by the last rewind.
+  ASSERT(ma_rewind_to(r, 24) == -1 && errno == EINVAL);
+  ASSERT(ma_group_step(g, 2) == 0);
+  ASSERT(ma_rewind_to(r, 24) == 0 && ma_get_output(a[1])[0] == history[24][1]);
+
+  // Restoring a snapshot drops the history from its cycle on.
+  ASSERT(ma_restore(g, mid) == 0 && ma_group_cycle(g) == 10);
+  ASSERT(ma_rewind_to(r, 20) == -1 && errno == EINVAL);
+  ASSERT(ma_group_step(g, 3) == 0);
+  ASSERT(ma_rewind_to(r, 12) == 0 && ma_get_output(a[1])[0] == history[12][1]);
+  ASSERT(ma_rewind_to(r, 5) == 0 && ma_get_output(a[1])[0] == history[5][1]);
+
+  // Without recorded cycles before the restored one the history starts over.
+  ASSERT(ma_group_step(g, 2) == 0 && ma_restore(g, snap) == 0);
+  ASSERT(ma_group_step(g, 2) == 0);
+  ASSERT(ma_rewind_to(r, 6) == -1 && errno == EINVAL);
+  ASSERT(ma_rewind_to(r, 1) == 0 && ma_get_output(a[1])[0] == history[1][1]);
+  ma_rewind_stop(r);
+
+  ASSERT(ma_restore(g, snap) == 0);
+  ASSERT(ma_group_cycle(g) == 0);
+  ASSERT(ma_get_output(a[0])[0] == history[0][0] && ma_get_output(a[1])[0] == history[0][1]);
+  ASSERT(ma_group_step(g, cycles) == 0);
+  ASSERT(ma_get_output(a[1])[0] == history[cycles][1]);
+
+  ASSERT(ma_snapshot(NULL, snap) == -1 && errno == EINVAL);
+  ASSERT(ma_restore(g, NULL) == -1 && errno == EINVAL);
+  ASSERT(ma_rewind_start(g, 0) == NULL && errno == EINVAL);
+
+  free(snap);
+  free(mid);
+  ma_group_delete(g);
+  ma_delete(a[0]);
+  ma_delete(a[1]);
+  return PASS;
+}
@@ -0,0 +1,68 @@
+#include "test.h"
+#include "errno.h"
+#include "stdio.h"
+
+static void xor_trans(bits_t* next_state, const bits_t* input,
+                      const bits_t* old_state, size_t, size_t) {
+  next_state[0] = (old_state[0] ^ input[0]) & 1;
+}
+
+// Tests the performance counters. Without `MA_STATS` they must report `ENOTSUP`.
+int stats_test(void) {
+  bits_t x = 1;
+  moore_t* a[3];
+  ma_stats_t stats;
+  ma_automaton_stats_t as;
+
+  for (size_t i = 0; i < SIZE(a); ++i) {
+    a[i] = ma_create_simple(2, 1, xor_trans);
+    ASSERT(a[i] != NULL);
+  }
+  ASSERT(ma_set_input(a[0], &x) == 0);
+  ASSERT(ma_connect(a[1], 0, a[0], 0, 1) == 0);
+  ASSERT(ma_connect(a[2], 0, a[0], 0, 1) == 0);
+  ASSERT(ma_connect(a[2], 1, a[1], 0, 1) == 0);
+
+  ma_group_t* g = ma_group_create(a, SIZE(a));
+  ASSERT(g != NULL);
+  ASSERT(ma_group_step(g, 10) == 0);
+
+#ifdef MA_STATS
+  ASSERT(ma_stats_get(g, &stats) == 0);
+  ASSERT(stats.steps == 10);
+  ASSERT(stats.connections == 3 && stats.max_fan_out == 2);
+  // Fan-outs 2, 1 and 0 fall into buckets 2, 1 and 0.
+  ASSERT(stats.fan_out_hist[0] == 1 && stats.fan_out_hist[1] == 1 && stats.fan_out_hist[2] == 1);
+
+  ASSERT(ma_stats_automaton(a[2], &as) == 0);
+  ASSERT(as.trans_calls == 10 && as.out_calls == 10 && as.gathered_bits == 20);
+
+  FILE* f = tmpfile();
+  ASSERT(f != NULL);
+  ASSERT(ma_stats_dump_json(g, f) == 0);
+  ASSERT(ftell(f) > 0);
+  fclose(f);
+
+  ASSERT(ma_stats_reset(g) == 0);
+  ASSERT(ma_stats_get(g, &stats) == 0 && stats.steps == 0);
+  ASSERT(ma_stats_automaton(a[2], &as) == 0 && as.trans_calls == 0);
+  ASSERT(ma_stats_get(NULL, &stats) == -1 && errno == EINVAL);
+
+  // Steps answered by the transition cache call neither function.
+  ma_memo_stats_t ms;
+  ASSERT(ma_memo_enable(a[2], 0, 0) == 0 && ma_group_step(g, 20) == 0);
+  ASSERT(ma_memo_stats(a[2], &ms) == 0 && ms.hits > 0);
+  ASSERT(ma_stats_automaton(a[2], &as) == 0);
+  ASSERT(as.trans_calls == ms.misses && as.out_calls == ms.misses);
+#else
+  ASSERT(ma_stats_get(g, &stats) == -1 && errno == ENOTSUP);
+  ASSERT(ma_stats_automaton(a[0], &as) == -1 && errno == ENOTSUP);
+  ASSERT(ma_stats_reset(g) == -1 && errno == ENOTSUP);
+#endif
+
+  ma_group_delete(g);
+  for (size_t i = 0; i < SIZE(a); ++i) {
+    ma_delete(a[i]);
+  }
+  return PASS;
+}
@@ -0,0 +1,125 @@
+#include "test.h"
+#include "errno.h"
+#include "string.h"
+
+// Latches its input: the state and the output are the input of the last step.
+static void t_latch(bits_t* next_state, const bits_t* input, const bits_t*, size_t n, size_t) {
+  memcpy(next_state, input, (n + 63) / 64 * sizeof(bits_t));
+}
+
+static moore_t* latch(size_t bits) {
+  return ma_create_simple(bits, bits, t_latch);
+}
+
+static int check_random(void) {
+  moore_t* a = latch(100);
+  moore_t* b = latch(100);
+  moore_t* c = latch(100);
+  ASSERT(a && b && c);
+
+  // The same spec gives the same sequence, another stream a different one.
+  ma_stim_spec_t spec = {.kind = MA_STIM_RANDOM, .in = 0, .num = 100, .seed = 42};
+  ASSERT(ma_stim_open(a, &spec) && ma_stim_open(b, &spec));
+  spec.stream = 1;
+  ASSERT(ma_stim_open(c, &spec));
+
+  size_t same = 0, ones = 0;
+  for (int i = 0; i < 64; ++i) {
+    ASSERT(ma_step(&a, 1) == 0 && ma_step(&b, 1) == 0 && ma_step(&c, 1) == 0);
+    const bits_t* x = ma_get_output(a);
+    const bits_t* y = ma_get_output(b);
+    const bits_t* z = ma_get_output(c);
+    ASSERT(x[0] == y[0] && (x[1] & 0xfffffffff) == (y[1] & 0xfffffffff));
+    same += x[0] == z[0];
+    ones += __builtin_popcountll(x[0]);
+  }
+  ASSERT(same == 0);
+  ASSERT(ones > 64 * 24 && ones < 64 * 40);
+
+  ma_delete(a);
+  ma_delete(b);
+  ma_delete(c);
+  return PASS;
+}
+
+static int check_counter_lfsr_replay(void) {
+  moore_t* a = latch(64);
+  ASSERT(a);
+
+  ma_stim_spec_t counter = {.kind = MA_STIM_COUNTER, .in = 4, .num = 8, .seed = 3, .param = 2};
+  ma_stim_spec_t lfsr = {.kind = MA_STIM_LFSR, .in = 12, .num = 16, .seed = 1, .param = 0xb400};
+  const bits_t vectors[3] = {0x5, 0xa, 0xf};
+  ma_stim_spec_t replay = {.kind = MA_STIM_REPLAY, .in = 40, .num = 4, .vectors = vectors, .len = 3};
+  ma_stim_t* sc = ma_stim_open(a, &counter);
+  ASSERT(sc && ma_stim_open(a, &lfsr) && ma_stim_open(a, &replay));
+
+  // Bits outside the ranges keep the values set by the caller.
+  bits_t in = 0x3;
+  ASSERT(ma_set_input(a, &in) == 0);
+
+  uint64_t reg = 1;
+  for (uint64_t i = 0; i < 100; ++i) {
+    ASSERT(ma_step(&a, 1) == 0);
+    reg = (reg >> 1) ^ (-(reg & 1) & 0xb400);
+    bits_t x = ma_get_output(a)[0];
+    ASSERT((x & 0xf) == 0x3);
+    ASSERT(((x >> 4) & 0xff) == ((3 + 2 * i) & 0xff));
+    ASSERT(((x >> 12) & 0xffff) == reg);
+    ASSERT(((x >> 40) & 0xf) == vectors[i % 3]);
+  }
+
+  // A closed generator leaves its inputs as they were.
+  bits_t last = ma_get_output(a)[0];
+  ma_stim_close(sc);
+  ASSERT(ma_step(&a, 1) == 0);
+  ASSERT(((ma_get_output(a)[0] >> 4) & 0xff) == ((last >> 4) & 0xff));
+
+  ma_delete(a);
+  return PASS;
+}
+
+static int check_errors(void) {
+  moore_t* a = latch(16);
+  moore_t* b = latch(16);
+  ASSERT(a && b);
+  ASSERT(ma_connect(a, 0, b, 0, 4) == 0);
+
+  ma_stim_spec_t spec = {.kind = MA_STIM_RANDOM, .in = 2, .num = 4};
+  errno = 0;
+  ASSERT(!ma_stim_open(a, &spec) && errno == EBUSY);
+  spec.in = 4;
+  ASSERT(ma_stim_open(a, &spec));
+  spec.in = 6;
+  ASSERT(!ma_stim_open(a, &spec) && errno == EBUSY);
+
+  spec.in = 8;
+  spec.num = 0;
+  ASSERT(!ma_stim_open(a, &spec) && errno == EINVAL);
+  spec.num = 9;
+  ASSERT(!ma_stim_open(a, &spec) && errno == EINVAL);
+  spec.num = 8;
+  spec.kind = MA_STIM_REPLAY;
+  ASSERT(!ma_stim_open(a, &spec) && errno == EINVAL);
+  ASSERT(!ma_stim_open(NULL, &spec) && errno == EINVAL);
+
+  moore_t* w = latch(128);
+  ASSERT(w);
+  ma_stim_spec_t wide = {.kind = MA_STIM_LFSR, .in = 0, .num = 65};
+  ASSERT(!ma_stim_open(w, &wide) && errno == EINVAL);
+  wide.num = 64;
+  ASSERT(ma_stim_open(w, &wide));
+
+  // Deleting the automata closes the generators.
+  ma_delete(a);
+  ma_delete(b);
+  ma_delete(w);
+  return PASS;
+}
+
+// Tests the built-in stimulus generators.
+int stim_test(void) {
+  ASSERT(check_random() == PASS);
+  ASSERT(check_counter_lfsr_replay() == PASS);
+  ASSERT(check_errors() == PASS);
+  return PASS;
+}
@@ -0,0 +1,75 @@
+#include "test.h"
+#include "errno.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "unistd.h"
+
+static void xor_trans(bits_t* next_state, const bits_t* input,
+                      const bits_t* old_state, size_t, size_t) {
+  next_state[0] = (old_state[0] ^ input[0]) & 1;
+}
+
+// Drives the two bit counter from two_bit_adder.c with an enable stream and
+// records both output bits.
+int stream_test(void) {
+  char in_path[] = "/tmp/ma_stream_in_XXXXXX";
+  char out_path[] = "/tmp/ma_stream_out_XXXXXX";
+  size_t cycles = 100;
+  bits_t stimulus[cycles], recorded[2 * cycles];
+  moore_t* a[2];
+
+  int fd = mkstemp(in_path);
+  ASSERT(fd != -1);
+  for (size_t c = 0; c < cycles; ++c) {
+    // The upper bits must be ignored since only one input bit exists.
+    stimulus[c] = (c % 3 == 0 ? 1 : 0) | 0xF0;
+  }
+  ASSERT(write(fd, stimulus, sizeof(stimulus)) == (ssize_t) sizeof(stimulus));
+  close(fd);
+  fd = mkstemp(out_path);
+  ASSERT(fd != -1);
+  close(fd);
+
+  a[0] = ma_create_simple(1, 1, xor_trans);
+  a[1] = ma_create_simple(1, 1, xor_trans);
+  ASSERT(a[0] != NULL && a[1] != NULL);
+  ASSERT(ma_connect(a[1], 0, a[0], 0, 1) == 0);
+
+  ma_group_t* g = ma_group_create(a, SIZE(a));
+  ASSERT(g != NULL);
+
+  ma_stream_map_t in_map = {.path = in_path, .automata = a, .num = 1};
+  ma_stream_map_t out_map = {.path = out_path, .automata = a, .num = 2};
+  ASSERT(ma_run_stream(g, &in_map, &out_map, cycles) == 0);
+  ASSERT(ma_group_cycle(g) == cycles);
+
+  FILE* f = fopen(out_path, "rb");
+  ASSERT(f != NULL);
+  ASSERT(fread(recorded, sizeof(bits_t), 2 * cycles, f) == 2 * cycles);
+  fclose(f);
+
+  // Replay the same stimulus by hand.
+  bits_t zero = 0;
+  ASSERT(ma_set_state(a[0], &zero) == 0 && ma_set_state(a[1], &zero) == 0);
+  for (size_t c = 0; c < cycles; ++c) {
+    ASSERT(ma_set_input(a[0], &stimulus[c]) == 0);
+    ASSERT(ma_step(a, SIZE(a)) == 0);
+    ASSERT(recorded[2 * c] == ma_get_output(a[0])[0]);
+    ASSERT(recorded[2 * c + 1] == ma_get_output(a[1])[0]);
+  }
+
+  // The input file is too short for more cycles.
+  errno = 0;
+  ASSERT(ma_run_stream(g, &in_map, NULL, cycles + 1) == -1 && errno == EINVAL);
+  ASSERT(ma_run_stream(NULL, &in_map, NULL, cycles) == -1 && errno == EINVAL);
+  ASSERT(ma_group_step(g, 3) == 0 && ma_group_cycle(g) == cycles + 3);
+
+  ASSERT(ma_group_create(NULL, 1) == NULL && errno == EINVAL);
+
+  ma_group_delete(g);
+  ma_delete(a[0]);
+  ma_delete(a[1]);
+  unlink(in_path);
+  unlink(out_path);
+  return PASS;
+}
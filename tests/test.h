@@ -36,6 +36,31 @@ int n_bit_adder_test(void);
 int connection_test(void);
 int invalid_data_test(void);
 int memory_test(void);
+int reach_test(void);
+int stream_test(void);
+int trace_test(void);
+int snapshot_test(void);
+int netlist_test(void);
+int stats_test(void);
+int memory_usage_test(void);
+int handle_test(void);
+int connect_many_test(void);
+int port_test(void);
+int view_test(void);
+int clock_test(void);
+int module_test(void);
+int optimize_test(void);
+int shard_test(void);
+int kernel_test(void);
+int clone_test(void);
+int pace_test(void);
+int alloc_test(void);
+int padded_test(void);
+int edit_test(void);
+int async_test(void);
+int equiv_test(void);
+int memo_test(void);
+int stim_test(void);
 
 
 
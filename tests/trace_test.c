@@ -0,0 +1,146 @@
+#include "test.h"
+#include "errno.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "unistd.h"
+
+static void xor_trans(bits_t* next_state, const bits_t* input,
+                      const bits_t* old_state, size_t, size_t) {
+  next_state[0] = (old_state[0] ^ input[0]) & 1;
+}
+
+// Counts the lines of `path` starting with `prefix`.
+static int count_lines(const char* path, const char* prefix) {
+  char line[256];
+  int count = 0;
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f)) {
+    count += strncmp(line, prefix, strlen(prefix)) == 0;
+  }
+  fclose(f);
+  return count;
+}
+
+static void hold_trans(bits_t* next_state, const bits_t*, const bits_t* old_state,
+                       size_t, size_t s) {
+  memcpy(next_state, old_state, (s + 63) / 64 * sizeof(bits_t));
+}
+
+// Traces an automaton whose initial record does not fit in the ring.
+static int check_wide(const char* path) {
+  size_t words = 40000;
+  moore_t* a = ma_create_simple(1, words * 64, hold_trans);
+  bits_t* ones = malloc(words * sizeof(*ones));
+  ASSERT(a && ones);
+  memset(ones, 0xff, words * sizeof(*ones));
+  ASSERT(ma_set_state(a, ones) == 0);
+
+  ma_group_t* g = ma_group_create(&a, 1);
+  ASSERT(g);
+  ma_trace_probe_t probe = {a, MA_TRACE_OUTPUT};
+  ma_trace_t* t = ma_trace_start(g, path, &probe, 1);
+  ASSERT(t);
+  ASSERT(ma_group_step(g, 2) == 0);
+  ASSERT(ma_trace_stop(t) == 0);
+
+  FILE* f = fopen(path, "rb");
+  ASSERT(f != NULL);
+  ASSERT(fseek(f, 0, SEEK_END) == 0);
+  long size = ftell(f);
+  fclose(f);
+  ASSERT(size == (long) (8 + 8 + 16 + (words + 1) * 16));
+
+  ma_group_delete(g);
+  ma_delete(a);
+  free(ones);
+  return PASS;
+}
+
+// Writes a trace header with `num` probes of `bits` bits and checks that it
+// is rejected.
+static int check_bad_bits(const char* path, const char* vcd_path, uint64_t num, uint64_t bits) {
+  const uint64_t desc[2] = {MA_TRACE_OUTPUT, bits};
+  FILE* f = fopen(path, "wb");
+  ASSERT(f != NULL);
+  ASSERT(fwrite("MATRACE1", 1, 8, f) == 8 && fwrite(&num, sizeof(num), 1, f) == 1);
+  for (uint64_t p = 0; p < num; ++p) {
+    ASSERT(fwrite(desc, sizeof(desc), 1, f) == 1);
+  }
+  ASSERT(fclose(f) == 0);
+
+  errno = 0;
+  ASSERT(ma_trace_to_vcd(path, vcd_path) == -1 && errno == EINVAL);
+  return PASS;
+}
+
+// Traces the two bit counter from two_bit_adder.c and converts the trace to VCD.
+int trace_test(void) {
+  char bin_path[] = "/tmp/ma_trace_XXXXXX";
+  char vcd_path[] = "/tmp/ma_trace_vcd_XXXXXX";
+  bits_t x = 1;
+  moore_t* a[2];
+
+  int fd = mkstemp(bin_path);
+  ASSERT(fd != -1);
+  close(fd);
+  fd = mkstemp(vcd_path);
+  ASSERT(fd != -1);
+  close(fd);
+
+  a[0] = ma_create_simple(1, 1, xor_trans);
+  a[1] = ma_create_simple(1, 1, xor_trans);
+  ASSERT(a[0] != NULL && a[1] != NULL);
+  ASSERT(ma_set_input(a[0], &x) == 0);
+  ASSERT(ma_connect(a[1], 0, a[0], 0, 1) == 0);
+
+  ma_group_t* g = ma_group_create(a, SIZE(a));
+  ASSERT(g != NULL);
+
+  ma_trace_probe_t probes[] = {{a[0], MA_TRACE_OUTPUT}, {a[1], MA_TRACE_STATE}};
+  ma_trace_t* t = ma_trace_start(g, bin_path, probes, SIZE(probes));
+  ASSERT(t != NULL);
+  ASSERT(ma_trace_start(g, bin_path, probes, SIZE(probes)) == NULL && errno == EBUSY);
+
+  // The counter runs for 8 cycles and then stops.
+  ASSERT(ma_group_step(g, 8) == 0);
+  ASSERT(ma_disconnect(a[1], 0, 1) == 0);
+  x = 0;
+  ASSERT(ma_set_input(a[0], &x) == 0);
+  ASSERT(ma_set_input(a[1], &x) == 0);
+  ASSERT(ma_group_step(g, 1000) == 0);
+  ASSERT(ma_trace_stop(t) == 0);
+
+  FILE* f = fopen(bin_path, "rb");
+  ASSERT(f != NULL);
+  ASSERT(fseek(f, 0, SEEK_END) == 0);
+  long size = ftell(f);
+  fclose(f);
+
+  // Header, the initial record and at most two words changed in each of
+  // the 8 counting cycles; the idle cycles add nothing.
+  long header = 8 + 8 + 2 * 16;
+  ASSERT(size > header && size <= header + 9 * 3 * 16);
+
+  ASSERT(ma_trace_to_vcd(bin_path, vcd_path) == 0);
+  ASSERT(count_lines(vcd_path, "$var") == 2);
+  ASSERT(count_lines(vcd_path, "#") == 9);
+  ASSERT(count_lines(vcd_path, "#0") == 1);
+
+  ASSERT(ma_trace_to_vcd(vcd_path, bin_path) == -1 && errno == EINVAL);
+  // Bit counts whose words wrap or overflow the index of all words.
+  ASSERT(check_bad_bits(bin_path, vcd_path, 1, UINT64_MAX) == PASS);
+  ASSERT(check_bad_bits(bin_path, vcd_path, 9, UINT64_MAX - 63) == PASS);
+  ASSERT(ma_trace_start(NULL, bin_path, probes, SIZE(probes)) == NULL && errno == EINVAL);
+
+  ma_group_delete(g);
+  ma_delete(a[0]);
+  ma_delete(a[1]);
+  ASSERT(check_wide(bin_path) == PASS);
+  unlink(bin_path);
+  unlink(vcd_path);
+  return PASS;
+}
@@ -0,0 +1,100 @@
+#include "test.h"
+#include "errno.h"
+#include "pthread.h"
+#include "sched.h"
+#include "stdatomic.h"
+
+#define WORDS 8
+#define CYCLES 20000
+
+// Every state word counts the steps.
+static void t_count(bits_t* next_state, const bits_t*, const bits_t* state, size_t, size_t s) {
+  for (size_t i = 0; i < s / 64; ++i) {
+    next_state[i] = state[i] + 1;
+  }
+}
+
+typedef struct {
+  ma_view_t* view;
+  atomic_int done;
+  int torn;
+  atomic_size_t reads;
+} reader_t;
+
+static void* read_view(void* arg) {
+  reader_t* r = arg;
+  bits_t out[2 * WORDS];
+  uint64_t cycle, last = 0;
+
+  while (!atomic_load(&r->done)) {
+    ma_view_read(r->view, out, &cycle);
+    for (size_t i = 0; i < 2 * WORDS; ++i) {
+      // Both automata start from the same state and always hold the cycle.
+      if (out[i] != cycle || cycle < last) {
+        r->torn = 1;
+      }
+    }
+    last = cycle;
+    atomic_fetch_add(&r->reads, 1);
+  }
+
+  return NULL;
+}
+
+// Tests that `ma_view_read` returns whole cycles while the group is stepped.
+int view_test(void) {
+  moore_t* a[3];
+  for (size_t i = 0; i < SIZE(a); ++i) {
+    a[i] = ma_create_simple(0, 64 * WORDS, t_count);
+    ASSERT(a[i]);
+  }
+
+  ma_group_t* g = ma_group_create(a, 2);
+  ASSERT(g);
+
+  errno = 0;
+  ASSERT(!ma_view_create(g, &a[2], 1) && errno == EINVAL);
+  ma_view_t* v = ma_view_create(g, a, 2);
+  ASSERT(v);
+  ASSERT(!ma_view_create(g, a, 1) && errno == EBUSY);
+  ASSERT(ma_view_size(v) == 2 * WORDS * sizeof(bits_t));
+
+  reader_t r = {.view = v};
+  atomic_init(&r.done, 0);
+  atomic_init(&r.reads, 0);
+  pthread_t reader;
+  ASSERT(pthread_create(&reader, NULL, read_view, &r) == 0);
+  while (atomic_load(&r.reads) == 0) {
+    sched_yield();
+  }
+
+  for (size_t c = 0; c < CYCLES; ++c) {
+    ASSERT(ma_group_step(g, 1) == 0);
+  }
+  atomic_store(&r.done, 1);
+  pthread_join(reader, NULL);
+  ASSERT(!r.torn);
+
+  bits_t out[2 * WORDS];
+  uint64_t cycle;
+  ASSERT(ma_view_read(v, out, &cycle) == 0);
+  ASSERT(cycle == CYCLES && out[2 * WORDS - 1] == CYCLES);
+
+  // Restoring a snapshot republishes the view.
+  bits_t snap[1 + 4 * WORDS];
+  ASSERT(ma_snapshot_size(g) == sizeof(snap));
+  ASSERT(ma_snapshot(g, snap) == 0);
+  snap[0] = 7;
+  snap[1 + WORDS] = 7;
+  ASSERT(ma_restore(g, snap) == 0);
+  ASSERT(ma_view_read(v, out, &cycle) == 0);
+  ASSERT(cycle == 7 && out[0] == 7 && out[1] == CYCLES);
+
+  // The view is deleted with the group.
+  ma_group_delete(g);
+  for (size_t i = 0; i < SIZE(a); ++i) {
+    ma_delete(a[i]);
+  }
+
+  return PASS;
+}